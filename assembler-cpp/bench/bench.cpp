@@ -0,0 +1,321 @@
+// Throughput benchmarks for the assembler and disassembler on synthetic workloads.
+//
+//   bench [--lines 1000,100000] [--reps N] [--label-density P] [--branch-range N]
+//         [--seed N] [--json out.json] [--baseline base.json] [--threshold 0.10]
+//
+// Results are JSON (stdout unless --json). With --baseline, every (name, lines) pair whose
+// median is slower than the baseline by more than --threshold is reported as a regression
+// and the exit status is 1, so the target can gate CI. Configure with
+// -DCMAKE_BUILD_TYPE=Release for meaningful numbers.
+#include "synth.h"
+#include "assembler/lexer.h"
+#include "assembler/parser.h"
+#include "assembler/encode.h"
+#include "assembler/symbols.h"
+#include "decoder/cfg.h"
+#include "decoder/decoder.h"
+#include "decoder/formatter.h"
+#include "decoder/disassembler_driver.h"
+#include "common/utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+    std::vector<uint64_t> lines = {1000, 10000, 100000};
+    SynthConfig synth;
+    int reps = 5;
+    std::string jsonPath;
+    std::string baselinePath;
+    double threshold = 0.10;
+};
+
+struct MemStat {
+    uint64_t lines = 0;
+    size_t arenaHighWater = 0, arenaReserved = 0;
+};
+
+struct Result {
+    std::string name;
+    uint64_t lines = 0;
+    uint64_t items = 0;  // work units per repetition (bytes for lex, instructions otherwise)
+    const char* unit = "instr";
+    double min_ns = 0, median_ns = 0, mean_ns = 0, stddev_ns = 0;
+};
+
+// Sink that defeats dead-code elimination of benchmarked results.
+volatile uint64_t g_sink = 0;
+
+// Runs setup+body once to warm up, then reps times, timing only body.
+Result measure(const std::string& name, uint64_t lines, uint64_t items, const char* unit, int reps,
+               const std::function<void()>& setup, const std::function<void()>& body) {
+    std::vector<double> ns;
+    ns.reserve((size_t)reps);
+    for (int r = -1; r < reps; ++r) {
+        if (setup) setup();
+        auto t0 = std::chrono::steady_clock::now();
+        body();
+        auto t1 = std::chrono::steady_clock::now();
+        if (r >= 0) ns.push_back((double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+    }
+    Result res;
+    res.name = name; res.lines = lines; res.items = items; res.unit = unit;
+    std::sort(ns.begin(), ns.end());
+    res.min_ns = ns.front();
+    res.median_ns = ns.size() % 2 ? ns[ns.size() / 2] : 0.5 * (ns[ns.size() / 2 - 1] + ns[ns.size() / 2]);
+    double sum = 0; for (double v : ns) sum += v;
+    res.mean_ns = sum / (double)ns.size();
+    double var = 0; for (double v : ns) var += (v - res.mean_ns) * (v - res.mean_ns);
+    res.stddev_ns = ns.size() > 1 ? std::sqrt(var / (double)(ns.size() - 1)) : 0.0;
+    return res;
+}
+
+// Swallows std::cout while disassembleFile runs so the terminal is not the bottleneck.
+struct NullBuf : std::streambuf {
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+void benchSize(const Options& opt, uint64_t lines, std::vector<Result>& out, std::vector<MemStat>& mem) {
+    SynthConfig cfg = opt.synth;
+    cfg.lines = lines;
+    const std::string src = generateSource(cfg);
+
+    // Stage inputs once; each benchmark times only its own stage.
+    std::vector<Token> toks = Lexer(src).tokenize();
+    Arena arena;
+    Program prog = Parser(toks, arena).parse();
+    mem.push_back({lines, arena.highWater(), arena.bytesReserved()});
+    std::vector<uint8_t> image;
+    {
+        SymbolTable syms;
+        Encoder enc(prog, syms);
+        image = enc.assemble();
+    }
+    std::vector<uint32_t> words(image.size() / 4);
+    for (size_t i = 0; i < words.size(); ++i)
+        words[i] = (uint32_t)image[4*i] | ((uint32_t)image[4*i+1] << 8)
+                 | ((uint32_t)image[4*i+2] << 16) | ((uint32_t)image[4*i+3] << 24);
+    std::vector<Decoded> decoded;
+    decoded.reserve(words.size());
+    for (size_t i = 0; i < words.size(); ++i) decoded.push_back(decodeWord(words[i], (uint32_t)(i * 4)));
+
+    const uint64_t n = prog.instrs.size();
+    const int reps = opt.reps;
+
+    out.push_back(measure("lex", lines, src.size(), "byte", reps, nullptr, [&] {
+        Lexer lx(src);
+        g_sink += lx.tokenize().size();
+    }));
+    Arena scratch;
+    out.push_back(measure("parse", lines, n, "instr", reps, [&] { scratch.reset(); }, [&] {
+        Parser ps(toks, scratch);
+        g_sink += ps.parse().instrs.size();
+    }));
+    out.push_back(measure("encode.layout", lines, n, "instr", reps, nullptr, [&] {
+        SymbolTable syms;
+        Encoder enc(prog, syms);
+        enc.layout();
+    }));
+    out.push_back(measure("encode.layout.rvc", lines, n, "instr", reps, nullptr, [&] {
+        SymbolTable syms;
+        EncoderOptions eo;
+        eo.compress = true;
+        Encoder enc(prog, syms, eo);
+        enc.layout();
+    }));
+    {
+        SymbolTable syms;
+        std::unique_ptr<Encoder> enc;
+        out.push_back(measure("encode.emit", lines, n, "instr", reps, [&] {
+            syms = SymbolTable();
+            enc.reset(new Encoder(prog, syms));
+            enc->layout();
+        }, [&] {
+            g_sink += enc->encode().size();
+        }));
+    }
+    out.push_back(measure("decodeWord", lines, n, "instr", reps, nullptr, [&] {
+        uint64_t acc = 0;
+        for (size_t i = 0; i < words.size(); ++i) acc += decodeWord(words[i], (uint32_t)(i * 4)).operands.size();
+        g_sink += acc;
+    }));
+    out.push_back(measure("decodeInstr", lines, n, "instr", reps, nullptr, [&] {
+        uint64_t acc = 0;
+        DecodedInstr di;
+        for (uint32_t w : words) acc += decodeInstr(w, di) + di.rd;
+        g_sink += acc;
+    }));
+    out.push_back(measure("formatDecoded", lines, n, "instr", reps, nullptr, [&] {
+        uint64_t acc = 0;
+        for (const auto& d : decoded) acc += formatDecoded(d, true, true).size();
+        g_sink += acc;
+    }));
+    {
+        std::vector<DecodedInstr> fields(words.size());
+        for (size_t i = 0; i < words.size(); ++i) decodeInstr(words[i], fields[i]);
+        std::string buf;
+        out.push_back(measure("appendDecoded", lines, n, "instr", reps, nullptr, [&] {
+            uint64_t acc = 0;
+            for (size_t i = 0; i < fields.size(); ++i) {
+                appendDecoded(buf, fields[i], (uint32_t)(i * 4), words[i], true, true);
+                buf += '\n';
+                if (buf.size() >= 64 * 1024) { acc += buf.size(); buf.clear(); }
+            }
+            g_sink += acc + buf.size();
+            buf.clear();
+        }));
+    }
+
+    out.push_back(measure("buildImageCfg", lines, n, "instr", reps, nullptr, [&] {
+        g_sink += buildImageCfg(image.data(), image.size()).blocks();
+    }));
+
+    namespace fs = std::filesystem;
+    fs::path bin = fs::temp_directory_path() / ("rv_bench_" + std::to_string(lines) + ".bin");
+    if (writeBinaryFile(bin.string(), image)) {
+        NullBuf nb;
+        out.push_back(measure("disassembleFile", lines, n, "instr", reps, nullptr, [&] {
+            std::streambuf* old = std::cout.rdbuf(&nb);
+            g_sink += (uint64_t)disassembleFile(bin.string(), true, true);
+            std::cout.rdbuf(old);
+        }));
+        out.push_back(measure("disassembleFile.recursive", lines, n, "instr", reps, nullptr, [&] {
+            std::streambuf* old = std::cout.rdbuf(&nb);
+            g_sink += (uint64_t)disassembleFile(bin.string(), true, true, DisasmMode::Recursive);
+            std::cout.rdbuf(old);
+        }));
+        std::error_code ec;
+        fs::remove(bin, ec);
+    }
+}
+
+std::string toJson(const Options& opt, const std::vector<Result>& rs, const std::vector<MemStat>& mem) {
+    std::ostringstream o;
+    o.precision(12);
+    o << "{\n  \"config\": {\"reps\": " << opt.reps
+      << ", \"label_density\": " << opt.synth.label_density
+      << ", \"branch_range\": " << opt.synth.branch_range
+      << ", \"seed\": " << opt.synth.seed << "},\n  \"results\": [\n";
+    for (size_t i = 0; i < rs.size(); ++i) {
+        const Result& r = rs[i];
+        double perSec = r.median_ns > 0 ? (double)r.items * 1e9 / r.median_ns : 0.0;
+        o << "    {\"name\": \"" << r.name << "\", \"lines\": " << r.lines
+          << ", \"items\": " << r.items << ", \"unit\": \"" << r.unit << "\""
+          << ", \"min_ns\": " << r.min_ns << ", \"median_ns\": " << r.median_ns
+          << ", \"mean_ns\": " << r.mean_ns << ", \"stddev_ns\": " << r.stddev_ns
+          << ", \"per_sec\": " << perSec << "}" << (i + 1 < rs.size() ? "," : "") << "\n";
+    }
+    o << "  ],\n  \"memory\": [\n";
+    for (size_t i = 0; i < mem.size(); ++i) {
+        o << "    {\"lines\": " << mem[i].lines << ", \"arena_high_water\": " << mem[i].arenaHighWater
+          << ", \"arena_reserved\": " << mem[i].arenaReserved << "}" << (i + 1 < mem.size() ? "," : "") << "\n";
+    }
+    o << "  ]\n}\n";
+    return o.str();
+}
+
+// Minimal reader for the format toJson writes: one result object per line.
+bool jsonField(const std::string& obj, const std::string& key, std::string& val) {
+    auto k = obj.find("\"" + key + "\":");
+    if (k == std::string::npos) return false;
+    size_t p = obj.find_first_not_of(' ', k + key.size() + 3);
+    if (p == std::string::npos) return false;
+    if (obj[p] == '"') {
+        size_t e = obj.find('"', p + 1);
+        val = obj.substr(p + 1, e - p - 1);
+    } else {
+        size_t e = obj.find_first_of(",}", p);
+        val = obj.substr(p, e - p);
+    }
+    return true;
+}
+
+int compareBaseline(const Options& opt, const std::vector<Result>& rs) {
+    std::ifstream f(opt.baselinePath);
+    if (!f) { std::cerr << "bench: cannot open baseline " << opt.baselinePath << "\n"; return 2; }
+    int regressions = 0, matched = 0;
+    std::string line;
+    while (std::getline(f, line)) {
+        std::string name, lines, median;
+        if (!jsonField(line, "name", name) || !jsonField(line, "lines", lines) ||
+            !jsonField(line, "median_ns", median)) continue;
+        for (const Result& r : rs) {
+            if (r.name != name || std::to_string(r.lines) != lines) continue;
+            ++matched;
+            double base = std::strtod(median.c_str(), nullptr);
+            double ratio = base > 0 ? r.median_ns / base : 1.0;
+            bool slow = ratio > 1.0 + opt.threshold;
+            if (slow) ++regressions;
+            std::fprintf(stderr, "%-4s %-16s %9llu lines  %6.3fx  (%.0f -> %.0f ns)\n",
+                         slow ? "REG" : "ok", name.c_str(), (unsigned long long)r.lines,
+                         ratio, base, r.median_ns);
+        }
+    }
+    std::fprintf(stderr, "bench: %d compared, %d regression(s) beyond %.0f%%\n",
+                 matched, regressions, opt.threshold * 100.0);
+    return regressions ? 1 : 0;
+}
+
+std::vector<uint64_t> parseList(const std::string& s) {
+    std::vector<uint64_t> v;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) if (!item.empty()) v.push_back(std::stoull(item));
+    return v;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) { std::cerr << "bench: missing value for " << a << "\n"; std::exit(64); }
+            return argv[++i];
+        };
+        if (a == "--lines") opt.lines = parseList(next());
+        else if (a == "--reps") opt.reps = std::max(1, std::stoi(next()));
+        else if (a == "--label-density") opt.synth.label_density = std::stod(next());
+        else if (a == "--branch-range") opt.synth.branch_range = (uint32_t)std::stoul(next());
+        else if (a == "--seed") opt.synth.seed = std::stoull(next());
+        else if (a == "--json") opt.jsonPath = next();
+        else if (a == "--baseline") opt.baselinePath = next();
+        else if (a == "--threshold") opt.threshold = std::stod(next());
+        else {
+            std::cerr << "usage: bench [--lines 1000,100000] [--reps N] [--label-density P] "
+                         "[--branch-range N] [--seed N] [--json out.json] [--baseline base.json] "
+                         "[--threshold 0.10]\n";
+            return 64;
+        }
+    }
+
+    std::vector<Result> results;
+    std::vector<MemStat> mem;
+    for (uint64_t n : opt.lines) {
+        std::cerr << "bench: " << n << " lines\n";
+        benchSize(opt, n, results, mem);
+    }
+
+    std::string json = toJson(opt, results, mem);
+    if (opt.jsonPath.empty()) std::cout << json;
+    else {
+        std::ofstream f(opt.jsonPath);
+        if (!f) { std::cerr << "bench: cannot write " << opt.jsonPath << "\n"; return 2; }
+        f << json;
+    }
+    return opt.baselinePath.empty() ? 0 : compareBaseline(opt, results);
+}
@@ -0,0 +1,112 @@
+#include "synth.h"
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+// splitmix64: tiny, fast and fully specified, so workloads are reproducible everywhere
+struct Rng {
+    uint64_t s;
+    uint64_t next() {
+        uint64_t z = (s += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    uint32_t below(uint32_t n) { return (uint32_t)(next() % n); }
+    int32_t range(int32_t lo, int32_t hi) { return lo + (int32_t)below((uint32_t)(hi - lo + 1)); }
+    bool chance(double p) { return (double)(next() >> 11) * (1.0 / 9007199254740992.0) < p; }
+};
+
+void appendReg(std::string& out, uint32_t r) {
+    out += 'x';
+    out += std::to_string(r);
+}
+
+} // namespace
+
+std::string generateSource(const SynthConfig& cfg) {
+    Rng rng{cfg.seed};
+
+    // Decide label positions up front so branches can target labels on either side.
+    std::vector<uint64_t> labelAt;
+    for (uint64_t i = 0; i < cfg.lines; ++i)
+        if (i == 0 || rng.chance(cfg.label_density)) labelAt.push_back(i);
+
+    // Far targets are fine: the encoder relaxes BEQ/JAL that overshoot their short range.
+    uint64_t range = std::max<uint32_t>(cfg.branch_range, 1);
+
+    std::string out;
+    out.reserve((size_t)cfg.lines * 24);
+    size_t li = 0;
+    for (uint64_t i = 0; i < cfg.lines; ++i) {
+        if (li < labelAt.size() && labelAt[li] == i) {
+            out += 'L';
+            out += std::to_string(li);
+            out += ":\n";
+            ++li;
+        }
+
+        // Pick a label within [i-range, i+range] for control flow; none -> emit arithmetic.
+        auto pickLabel = [&](std::string& name) -> bool {
+            uint64_t lo = i > range ? i - range : 0, hi = i + range;
+            auto first = std::lower_bound(labelAt.begin(), labelAt.end(), lo);
+            auto last  = std::upper_bound(labelAt.begin(), labelAt.end(), hi);
+            if (first == last) return false;
+            size_t k = (size_t)(first - labelAt.begin()) + rng.below((uint32_t)(last - first));
+            name = "L" + std::to_string(k);
+            return true;
+        };
+
+        out += "    ";
+        std::string target;
+        uint32_t kind = rng.below(100);
+        if (kind < 22) {
+            out += rng.below(2) ? "ADD " : "SUB ";
+            appendReg(out, rng.below(32)); out += ", ";
+            appendReg(out, rng.below(32)); out += ", ";
+            appendReg(out, rng.below(32));
+        } else if (kind < 50) {
+            out += "ADDI ";
+            appendReg(out, rng.below(32)); out += ", ";
+            appendReg(out, rng.below(32)); out += ", ";
+            out += std::to_string(rng.range(-2048, 2047));
+        } else if (kind < 62) {
+            out += "LW ";
+            appendReg(out, rng.below(32)); out += ", ";
+            out += std::to_string(rng.range(-2048, 2047)) + "(";
+            appendReg(out, rng.below(32)); out += ")";
+        } else if (kind < 72) {
+            out += "SW ";
+            appendReg(out, rng.below(32)); out += ", ";
+            out += std::to_string(rng.range(-2048, 2047)) + "(";
+            appendReg(out, rng.below(32)); out += ")";
+        } else if (kind < 84 && pickLabel(target)) {
+            out += "BEQ ";
+            appendReg(out, rng.below(32)); out += ", ";
+            appendReg(out, rng.below(32)); out += ", ";
+            out += target;
+        } else if (kind < 90 && pickLabel(target)) {
+            out += "JAL ";
+            appendReg(out, rng.below(32)); out += ", ";
+            out += target;
+        } else if (kind < 93) {
+            out += "JALR ";
+            appendReg(out, rng.below(32)); out += ", ";
+            appendReg(out, rng.below(32)); out += ", ";
+            out += std::to_string(rng.range(-2048, 2047));
+        } else if (kind < 97) {
+            out += "LUI ";
+            appendReg(out, rng.below(32)); out += ", 0x";
+            char buf[8];
+            static const char* hexd = "0123456789abcdef";
+            uint32_t v = rng.below(1u << 20);
+            for (int k = 4; k >= 0; --k) { buf[k] = hexd[v & 0xF]; v >>= 4; }
+            out.append(buf, 5);
+        } else {
+            out += "ADDI x0, x0, 0";
+        }
+        out += '\n';
+    }
+    return out;
+}
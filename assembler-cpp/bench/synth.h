@@ -0,0 +1,16 @@
+// deterministic synthetic RV32I source generator for the benchmark suite
+#pragma once
+#include <cstdint>
+#include <string>
+
+struct SynthConfig {
+    uint64_t lines = 1000;         // instruction lines to emit (label-only lines not counted)
+    double   label_density = 0.05; // probability that an instruction line carries a label
+    uint32_t branch_range = 64;    // max BEQ/JAL distance, in instructions
+    uint64_t seed = 1;
+};
+
+// Same config -> byte-identical source on every platform (own PRNG, no <random> distributions).
+// Every emitted line assembles: registers x0..x31, immediates in range, and BEQ/JAL only
+// target labels within branch_range (far ones are relaxed by the encoder).
+std::string generateSource(const SynthConfig& cfg);
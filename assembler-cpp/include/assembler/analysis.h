@@ -0,0 +1,48 @@
+// register and control-flow facts about source instructions, for passes that run before layout
+#pragma once
+#include "assembler/parser.h"
+#include "common/isa.h"
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// What one instruction reads and writes, read off its operand text.
+struct InstrFacts {
+    InstrTag tag = TAG_INVALID;
+    uint8_t rd = 0, rs1 = 0, rs2 = 0;
+    int32_t imm = 0;             // literal immediate, memory offset or literal branch offset
+    std::string_view target;     // label operand of BEQ/BNE/JAL/LA; empty when the offset is literal
+    uint32_t defs = 0, uses = 0; // register bitmasks, bit r = xr (x0 is never set)
+};
+
+inline uint32_t regBit(uint8_t r) { return r ? 1u << r : 0u; }
+inline bool isBranch(InstrTag t) { return t == TAG_BEQ || t == TAG_BNE; }
+inline bool endsBlock(InstrTag t) { return isBranch(t) || t == TAG_JAL || t == TAG_JALR; }
+// No effect besides writing rd: safe to drop when rd is never read.
+inline bool isPureDef(InstrTag t) {
+    return t == TAG_ADD || t == TAG_SUB || t == TAG_ADDI || t == TAG_LUI || t == TAG_AUIPC;
+}
+
+// False for unknown mnemonics and malformed operands (the encoder reports those).
+bool analyzeInstr(const AsmInstr& ins, InstrFacts& f);
+
+// Instruction index each label binds to (instrs.size() for labels after the last one);
+// same binding and first-definition-wins rule as Encoder::layout().
+std::unordered_map<std::string_view, uint32_t> labelIndex(const Program& prog);
+
+// Basic blocks of prog.instrs and the edges between them. A block starts at instruction 0,
+// at every instruction a label binds to, and after every branch or jump.
+struct Cfg {
+    static constexpr uint32_t kNone = UINT32_MAX;     // no edge
+    static constexpr uint32_t kExit = UINT32_MAX - 1; // leaves the program or goes somewhere unknown
+
+    std::vector<uint32_t> start; // block b is instrs [start[b], start[b+1]); start.back() == instrs.size()
+    std::vector<uint32_t> fall;  // fall-through successor (kNone after JAL/JALR, kExit past the end)
+    std::vector<uint32_t> taken; // branch/JAL target block; kExit for JALR, undefined labels,
+                                 // targets past the end and the `JAL x0, self` halt idiom
+
+    size_t blocks() const { return start.size() - 1; }
+};
+
+Cfg buildCfg(const Program& prog, const std::vector<InstrFacts>& facts);
@@ -0,0 +1,49 @@
+// --layout-profile: profile-guided basic-block ordering of Program::instrs
+#pragma once
+#include "assembler/parser.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Execution counts of a previous run, one per line, '#' starts a comment:
+//   KEY COUNT          times the block at KEY ran
+//   KEY -> KEY COUNT   times control went from the block at the first KEY to the second by a
+//                      taken branch or a jump
+// A KEY is a label or @LINE, the first instruction from that source line. The emulator
+// writes this format (--layout-profile with --map). Counts not given are worked out: a jump
+// or call is taken as often as its block runs, a branch is not taken unless the profile says
+// so, and falling through gets what is left.
+struct LayoutProfile {
+    struct Entry {
+        std::string from, to; // `to` empty for a block count
+        uint64_t count = 0;
+    };
+    std::vector<Entry> entries;
+};
+
+// false with err ("FILE:LINE: ...") on unreadable files or malformed lines.
+bool readLayoutProfile(const std::string& path, LayoutProfile& profile, std::string& err);
+
+struct LayoutStats {
+    size_t blocks = 0, moved = 0;    // blocks, and those no longer after the block before them
+    size_t inverted = 0;             // BEQ <-> BNE so the likelier side falls through
+    size_t jumpsAdded = 0, jumpsRemoved = 0;
+    size_t unknownKeys = 0;          // profile keys naming no label or line
+    uint64_t takenBefore = 0, takenAfter = 0; // taken branches and jumps, by the profile
+    const char* skipped = nullptr;   // why nothing was done, if so
+};
+
+// Reorders the blocks of prog (pseudos expanded, labels bound: labelAt holds each label and
+// the instruction index it binds to, as Encoder::layout() keeps them). Hot edges are chained
+// greedily, heaviest first, so their targets fall through (Pettis-Hansen); the entry block
+// stays first, then chains by their hottest block, then never-run chains in source order.
+// A branch whose taken side now follows is inverted, a fall-through that no longer follows
+// gets a JAL, and a JAL to the block after it is dropped; labels are added where needed
+// (named with '@', so they cannot collide with source labels) and labelAt is updated for the
+// new order. Refuses programs whose behaviour depends on code addresses (AUIPC, literal
+// branch offsets), like -O. Code reached by computed jumps must start at a label of its own.
+LayoutStats layoutBlocks(Program& prog, std::vector<std::pair<std::string_view, uint32_t>>& labelAt,
+                         const LayoutProfile& profile);
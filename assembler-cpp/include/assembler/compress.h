@@ -0,0 +1,12 @@
+// RV32C: 16-bit forms for base-ISA instructions that have one
+#pragma once
+#include "common/isa.h"
+#include <cstdint>
+
+// If di (a decoded 32-bit instruction; PC-relative imm already resolved) has an exactly
+// equivalent RVC encoding, writes it to out and returns true. Only forms whose expansion
+// is an instruction this assembler supports are produced:
+//   ADDI -> C.NOP/C.ADDI/C.LI/C.ADDI16SP/C.ADDI4SPN/C.MV   ADD -> C.MV/C.ADD   SUB -> C.SUB
+//   LW/SW -> C.LW/C.SW/C.LWSP/C.SWSP   LUI -> C.LUI   JAL -> C.J/C.JAL   JALR -> C.JR/C.JALR
+//   BEQ/BNE rs,x0 -> C.BEQZ/C.BNEZ
+bool compressInstr(const DecodedInstr& di, uint16_t& out);
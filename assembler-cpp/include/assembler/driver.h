@@ -1,5 +1,23 @@
 //2 pass orchestration
 #pragma once
+#include "common/arena.h"
 #include <string>
 
 int assembleFile(const std::string& inPath, const std::string& outPath, bool hex);
+
+// Same, allocating the job's front-end/IR from arena, which is reset first. Long-lived
+// callers pass one arena to every job to reuse its memory.
+int assembleFile(const std::string& inPath, const std::string& outPath, bool hex, Arena& arena);
+
+struct AsmOptions {
+    bool hex = false;      // one hex parcel per line instead of a binary image
+    bool compress = false; // RVC: emit 16-bit forms where possible, report the saving on stderr
+    bool optimize = false; // -O: peephole pass before layout, per-rule hit counts on stderr
+    bool schedule = false; // --sched: reorder blocks to hide load-use stalls, estimate on stderr
+    unsigned loadLatency = 2; // --load-latency N: cycles from LW issue to a usable result
+    uint8_t scratch = 6;   // --scratch xN: register far jumps and far branches go through
+    std::string mapPath;   // --map FILE: also write a PC -> source line map (common/linemap.h)
+    std::string layoutProfile; // --layout-profile FILE: order blocks by a profile, estimate on stderr
+};
+
+int assembleFile(const std::string& inPath, const std::string& outPath, const AsmOptions& opts, Arena& arena);
@@ -1,17 +1,88 @@
-// parsed instructions -> encode to 32 bit words and resolve labels in pass 2
+// parsed instructions -> encode to a little-endian image and resolve labels in pass 2
 #pragma once
+#include "assembler/blocklayout.h"
 #include "assembler/parser.h"
+#include "assembler/peephole.h"
+#include "assembler/schedule.h"
 #include "symbols.h"
 #include <vector>
 #include <cstdint>
+#include <string>
+
+// Per-instruction encoding status. Errors are values, not exceptions: a bad operand is
+// diagnosed, recorded, and encoding moves on to the next instruction.
+enum class EncStatus : uint8_t {
+    Ok = 0,
+    OperandCount,
+    ExpectedReg,
+    ExpectedImm,
+    BadMemOperand,
+    ImmOutOfRange,
+    Misaligned,
+    UndefinedSymbol,
+    UnknownMnemonic,
+    ScratchInUse,
+};
+
+const char* encStatusStr(EncStatus st);
+
+struct EncoderOptions {
+    bool compress = false; // emit RVC (16-bit) forms where an exact equivalent exists
+    bool optimize = false; // run the peephole pass on the expanded program before layout
+    bool schedule = false; // then list-schedule each basic block for `latency`
+    LatencyModel latency;
+    uint8_t scratch = 6; // x1..x31 clobbered by far jumps (x6/t1 per the psABI); the program must not use it
+    const LayoutProfile* profile = nullptr; // then order blocks by it, after labels are bound
+};
+
+struct EncodeStats {
+    size_t instrs = 0, compressed = 0;
+    uint32_t bytes = 0;        // image size
+    uint32_t bytesFull = 0;    // image size with every instruction 32-bit
+};
 
 class Encoder {
 public:
-    Encoder(Program& prog, SymbolTable& sym);
-    std::vector<uint32_t> assemble();
+    Encoder(Program& prog, SymbolTable& sym, EncoderOptions opts = {});
+    std::vector<uint8_t> assemble();
+
+    // The two passes of assemble(), exposed so they can be driven (and timed) separately.
+    void layout();                 // pass 1: expand pseudos, assign PCs, bind labels, relax far
+                                   // branches (+ peephole, scheduling, block layout, RVC sizing)
+    std::vector<uint8_t> encode(); // pass 2: encode with resolved labels
+
+    // Diagnostics from the last encode(), one per bad instruction, in source order.
+    const std::vector<std::string>& errors() const;
+    const EncodeStats& stats() const { return stats_; }
+    const PeepholeStats& peepholeStats() const { return peep_; } // filled when opts.optimize
+    const ScheduleStats& scheduleStats() const { return sched_; } // filled when opts.schedule
+    const LayoutStats& layoutStats() const { return layout_; }     // filled when opts.profile
+    // After layout(): PC of each instruction of the (expanded) program, then the end PC.
+    const std::vector<uint32_t>& pcs() const { return pcs_; }
+    const Program& program() const { return prog_; }
 private:
-    uint32_t encodeInstr(const AsmInstr& ins, uint32_t pc);
+    EncStatus encodeInstr(const AsmInstr& ins, uint32_t pc, uint32_t& out);
+    // Relaxed 8- or 12-byte form of a far BEQ/BNE/JAL, or LA; out receives size/4 words.
+    EncStatus encodeLong(const AsmInstr& ins, uint32_t pc, unsigned size, uint32_t out[3]);
+    EncStatus encodeAt(size_t i, unsigned size, uint32_t out[3]); // instruction i as a size-byte form
+    void place();        // pcs_ from sizes_, then rebind labels to the new PCs
+    void relaxPass();    // grow out-of-range BEQ/BNE/JAL into long forms until a fixed point
+    void compressPass(); // shrink instructions (relaxed -> 4 -> 2 bytes) until a fixed point
+    bool compressAt(size_t i, uint16_t& out);
+    bool scratchInUse(); // does any instruction read or write opts_.scratch? (computed once per layout)
+
     Program& prog_;
     SymbolTable& sym_;
+    EncoderOptions opts_;
+    EncodeStats stats_;
+    PeepholeStats peep_{};
+    ScheduleStats sched_{};
+    LayoutStats layout_{};
     std::vector<uint32_t> pcs_;
+    std::vector<uint8_t> sizes_; // 2 (RVC), 4, or 8/12 (relaxed sequence) bytes per instruction
+    // First definition of each label and the instruction index it binds to (size() = end).
+    std::vector<std::pair<std::string_view, uint32_t>> labelAt_;
+    std::vector<std::string> errs_;
+    int8_t scratchUsed_ = -1; // scratchInUse() result; -1 until first asked
+    std::string errDetail_; // offending operand/usage for the diagnostic being built
 };
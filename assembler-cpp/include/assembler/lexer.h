@@ -1,13 +1,15 @@
 //purpose: read raw text → produce tokens (LABEL, MNEMONIC, REGISTER, IMMEDIATE, COMMA, etc.)
 #pragma once
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 enum class TokKind { Ident, Reg, Imm, Comma, Colon, Newline, End, LParen, RParen, Plus, Minus };
 
 struct Token {
     TokKind kind;
-    std::string text;
+    std::string_view text; // view into the source passed to Lexer (must outlive the tokens)
     int64_t value = 0;
     unsigned line = 0;
 };
@@ -0,0 +1,19 @@
+// operand text -> values, shared by the encoder and the passes that run before it
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+// All parsers are non-throwing: malformed text is a diagnostic, not an exception.
+
+// [+-]?(0x<hex>|<dec>) -> out; false on junk, empty digits or overflow.
+bool parseInt(std::string_view s, int64_t& out);
+
+// x0..x31 -> 0..31.
+bool parseRegX(const char* b, const char* e, uint8_t& out);
+bool parseRegX(std::string_view s, uint8_t& out);
+
+// imm(rs1), e.g. 0(x10)  -8(x2)  +0x40(x3); blanks around the parts are allowed.
+bool parseMemOp(std::string_view s, int32_t& off, uint8_t& rs1);
+
+// Case-insensitive mnemonic compare against an upper-case literal ("BEQ").
+bool ieq(std::string_view a, const char* upper);
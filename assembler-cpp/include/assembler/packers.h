@@ -0,0 +1,76 @@
+// RV32I instruction-format packers, shared by the text assembler and rv:: (assembler/rv.h)
+#pragma once
+#include <cstdint>
+
+// Each packs already-validated fields into a 32-bit word. Fields are defensively masked, so
+// a packer called with only an immediate (registers and opcode 0) yields just its bits;
+// range and alignment checks are the caller's.
+namespace rv::pack {
+
+constexpr uint32_t rtype(uint8_t f7, uint8_t rs2, uint8_t rs1, uint8_t f3, uint8_t rd, uint8_t op) {
+    return (((uint32_t)f7  & 0x7Fu) << 25)
+         | (((uint32_t)rs2 & 0x1Fu) << 20)
+         | (((uint32_t)rs1 & 0x1Fu) << 15)
+         | (((uint32_t)f3  & 0x07u) << 12)
+         | (((uint32_t)rd  & 0x1Fu) << 7)
+         |  ((uint32_t)op  & 0x7Fu);
+}
+
+constexpr uint32_t itype(int32_t imm, uint8_t rs1, uint8_t f3, uint8_t rd, uint8_t op) {
+    uint32_t u = (uint32_t)imm;
+    return ((u & 0xFFFu) << 20)
+         | (((uint32_t)rs1 & 0x1Fu) << 15)
+         | (((uint32_t)f3  & 0x07u) << 12)
+         | (((uint32_t)rd  & 0x1Fu) << 7)
+         |  ((uint32_t)op  & 0x7Fu);
+}
+
+constexpr uint32_t stype(int32_t imm, uint8_t rs2, uint8_t rs1, uint8_t f3, uint8_t op) {
+    uint32_t u = (uint32_t)imm;
+    uint32_t i11_5 = (u >> 5) & 0x7Fu;
+    uint32_t i4_0  =  u       & 0x1Fu;
+    return (i11_5 << 25)
+         | (((uint32_t)rs2 & 0x1Fu) << 20)
+         | (((uint32_t)rs1 & 0x1Fu) << 15)
+         | (((uint32_t)f3  & 0x07u) << 12)
+         | (i4_0 << 7)
+         | ((uint32_t)op & 0x7Fu);
+}
+
+constexpr uint32_t btype(int32_t imm, uint8_t rs2, uint8_t rs1, uint8_t f3, uint8_t op) {
+    uint32_t u    = (uint32_t)imm;
+    uint32_t b12  = (u >> 12) & 0x1u;
+    uint32_t b10_5= (u >>  5) & 0x3Fu;
+    uint32_t b4_1 = (u >>  1) & 0x0Fu;
+    uint32_t b11  = (u >> 11) & 0x1u;
+    return (b12 << 31)
+         | (b10_5 << 25)
+         | (((uint32_t)rs2 & 0x1Fu) << 20)
+         | (((uint32_t)rs1 & 0x1Fu) << 15)
+         | (((uint32_t)f3  & 0x07u) << 12)
+         | (b4_1 << 8)
+         | (b11 << 7)
+         | ((uint32_t)op & 0x7Fu);
+}
+
+constexpr uint32_t utype(int32_t imm20, uint8_t rd, uint8_t op) {
+    return (((uint32_t)imm20 & 0xFFFFFu) << 12)
+         | (((uint32_t)rd    & 0x1Fu)    << 7)
+         |  ((uint32_t)op    & 0x7Fu);
+}
+
+constexpr uint32_t jtype(int32_t imm, uint8_t rd, uint8_t op) {
+    uint32_t u     = (uint32_t)imm;
+    uint32_t j20   = (u >> 20) & 0x1u;
+    uint32_t j10_1 = (u >>  1) & 0x3FFu;
+    uint32_t j11   = (u >> 11) & 0x1u;
+    uint32_t j19_12= (u >> 12) & 0xFFu;
+    return (j20 << 31)
+         | (j19_12 << 12)
+         | (j11 << 20)
+         | (j10_1 << 21)
+         | (((uint32_t)rd & 0x1Fu) << 7)
+         | ((uint32_t)op & 0x7Fu);
+}
+
+} // namespace rv::pack
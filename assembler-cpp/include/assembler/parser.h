@@ -1,43 +1,59 @@
 // turn tokens into lightweight AST (abstract syntax tree) / list of instruction lines and label defs
 #pragma once
 #include "assembler/lexer.h"
+#include "common/arena.h"
+#include <initializer_list>
 #include <string>
+#include <string_view>
 #include <vector>
 
+// All strings and operand arrays below live in the Program's arena: the whole IR of one
+// assembly job is released in one step by resetting (or destroying) that arena.
 struct AsmInstr {
-    std::string mnemonic;
-    std::vector<std::string> args;
+    std::string_view mnemonic;
+    ArenaSpan<std::string_view> args;
     unsigned line;
 };
 
 struct LabelDef {
-    std::string name;
+    std::string_view name;
     unsigned line;
 };
 
 struct Program {
-    std::vector<LabelDef> labels;
-    std::vector<AsmInstr> instrs;
+    explicit Program(Arena& a) : labels(a), instrs(a), arena(&a) {}
+    ArenaVector<LabelDef> labels;
+    ArenaVector<AsmInstr> instrs;
+    Arena* arena;
 };
 
+// Builds an instruction whose mnemonic/operands are copied into the arena (for passes
+// that synthesise code).
+AsmInstr makeInstr(Arena& a, std::string_view mnemonic,
+                   std::initializer_list<std::string_view> args, unsigned line);
+
+// One source line while it is being parsed; views into the token stream, reused per line.
 struct Line {
-    std::vector<std::string> labels;
-    std::string mnemonic;
-    std::vector<std::string> operands;
+    std::vector<std::string_view> labels;
+    std::string_view mnemonic;
+    std::vector<std::string_view> operands;
     unsigned line;
 };
 
 class Parser {
 public:
-    explicit Parser(const std::vector<Token>& toks);
+    // toks must outlive the parser; the Program is allocated from arena.
+    Parser(const std::vector<Token>& toks, Arena& arena);
     Program parse();
     const std::vector<std::string>& errors() const;
 private:
     const Token& peek(int k = 0) const;
     bool accept(TokKind k);
     bool expect(TokKind k, const char* msg);
-    Line parseLine();
-    std::vector<Token> toks_;
+    void parseLine(Line& L);
+    std::string_view operandText(size_t first, size_t last);
+    const std::vector<Token>& toks_;
+    Arena& arena_;
     size_t i_ = 0;
     std::vector<std::string> errs_;
 };
@@ -0,0 +1,26 @@
+// -O: semantics-preserving rewrites over Program::instrs, run by Encoder::layout() once pseudos are expanded
+#pragma once
+#include "assembler/parser.h"
+#include <cstddef>
+
+struct PeepholeStats {
+    enum Rule {
+        AddiZero,  // ADDI xN, xN, 0
+        X0Write,   // ADD/SUB/ADDI/LUI/AUIPC whose rd is x0
+        JumpNext,  // JAL x0 / BEQ / BNE whose target is the next instruction
+        AddiFold,  // ADDI xN, xM, a ; ... ; ADDI xN, xN, b  ->  ADDI xN, xM, a+b
+        DeadWrite, // pure write whose result is never read on any path (block liveness)
+        kRules
+    };
+    size_t hits[kRules] = {};
+    size_t before = 0, after = 0; // instruction counts
+    const char* skipped = nullptr; // why nothing was done, if so
+};
+
+const char* peepholeRuleName(int rule);
+
+// Rewrites prog in place until no rule fires. Deleted instructions take their labels with
+// them to the next instruction. Register and memory effects are unchanged on every path;
+// only code addresses move, so the pass refuses programs whose behaviour depends on them
+// (AUIPC, or branch/jump operands given as literal offsets).
+PeepholeStats peephole(Program& prog);
@@ -0,0 +1,29 @@
+// pseudo-instructions: li / la / mv / j / call / tail / ret
+#pragma once
+#include "assembler/encode.h"
+#include "assembler/parser.h"
+#include <string>
+#include <string_view>
+
+// Shortest base sequence for each pseudo:
+//   li rd, v     ADDI rd, x0, v             v fits in 12 signed bits
+//                LUI  rd, v>>12             low 12 bits of v are zero
+//                LUI  rd, hi ; ADDI rd, rd, lo   otherwise (hi rounded so lo carries the sign)
+//   mv rd, rs    ADDI rd, rs, 0
+//   j L          JAL x0, L                  (relaxed like tail when far)
+//   call L       JAL x1, L                  (relaxed to AUIPC x1 + JALR x1 when far)
+//   tail L       JAL x0, L                  (relaxed to AUIPC x6 + JALR x0 when far; x6 is the
+//                                            encoder's scratch register, see EncoderOptions)
+//   ret          JALR x0, x1, 0
+//   la rd, L     depends on layout, so the encoder keeps it: AUIPC rd, hi ; ADDI rd, rd, lo,
+//                PC-relative so the address is right wherever the image is loaded
+bool isPseudo(std::string_view mnemonic);
+
+// Base instructions for one layout-independent pseudo (everything but la with a label), in
+// out[0..n). On bad operands returns the status and sets detail, like Encoder::encodeInstr.
+EncStatus lowerPseudo(Arena& arena, const AsmInstr& ins, AsmInstr out[2], unsigned& n,
+                      std::string& detail);
+
+// Replaces every well-formed layout-independent pseudo in prog. Malformed ones stay as they
+// are; the encoder reports them through lowerPseudo().
+void expandPseudos(Program& prog);
@@ -0,0 +1,229 @@
+// rv: RV32I programs built from C++, header-only and constexpr, with no text round-trip
+#pragma once
+#include "assembler/packers.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// Single instructions are constexpr functions returning the 32-bit word, encoded by the same
+// packers as the text assembler:
+//
+//   constexpr uint32_t w = rv::addi(rv::x5, rv::x0, 3);
+//
+// Programs with labels go through rv::Assembler, which resolves branch and jump targets
+// when finished. With a word count N it lives in a std::array and can run in a constant
+// expression, so a fixed program costs nothing at run time:
+//
+//   constexpr auto kSum = rv::program<5>([](auto& a) {
+//       using namespace rv;
+//       Label loop = a.label();
+//       a.li(x5, 10).li(x6, 0);
+//       a.bind(loop).add(x6, x6, x5).addi(x5, x5, -1).bne(x5, x0, loop);
+//   });
+//
+// rv::Assembler<> (N = 0) grows a std::vector instead, for generators at run time.
+//
+// Immediates are checked like the text assembler checks them. In a constant expression a
+// failed check does not compile; at run time it throws std::out_of_range. Operand order
+// follows the assembly syntax: lw(rd, off, rs1) is `lw rd, off(rs1)`. Branch and jump
+// offsets are in bytes from the instruction; LUI and AUIPC take the 20-bit U field.
+namespace rv {
+
+struct Reg { uint8_t n; };
+
+inline constexpr Reg x0{0},   x1{1},   x2{2},   x3{3},   x4{4},   x5{5},   x6{6},   x7{7},
+                     x8{8},   x9{9},   x10{10}, x11{11}, x12{12}, x13{13}, x14{14}, x15{15},
+                     x16{16}, x17{17}, x18{18}, x19{19}, x20{20}, x21{21}, x22{22}, x23{23},
+                     x24{24}, x25{25}, x26{26}, x27{27}, x28{28}, x29{29}, x30{30}, x31{31};
+
+namespace detail {
+
+constexpr void require(bool ok, const char* what) {
+    if (!ok) throw std::out_of_range(what); // not a constant expression: a compile error there
+}
+constexpr bool fits(int64_t v, int bits) { return v >= -(int64_t{1} << (bits - 1)) && v < (int64_t{1} << (bits - 1)); }
+constexpr Reg reg(Reg r) { require(r.n < 32, "register out of range"); return r; }
+constexpr int32_t imm12(int32_t v) { require(fits(v, 12), "immediate out of range [-2048, 2047]"); return v; }
+constexpr int32_t imm20(int32_t v) {
+    require(v >= -(1 << 19) && v <= 0xFFFFF, "U immediate out of range [-2^19, 2^20-1]");
+    return v;
+}
+constexpr int32_t branchOff(int64_t v) {
+    require((v & 1) == 0, "branch target misaligned");
+    require(fits(v, 13), "branch target out of range [-4096, 4094]");
+    return (int32_t)v;
+}
+constexpr int32_t jumpOff(int64_t v) {
+    require((v & 1) == 0, "jump target misaligned");
+    require(fits(v, 21), "jump target out of range [-2^20, 2^20-2]");
+    return (int32_t)v;
+}
+
+// Storage for N > 0: a std::array and a count, usable in constant expressions.
+template <class T, size_t N>
+struct Buffer {
+    std::array<T, N> v{};
+    size_t n = 0;
+    constexpr void push_back(const T& x) { require(n < N, "program longer than its capacity"); v[n++] = x; }
+    constexpr size_t size() const { return n; }
+    constexpr T& operator[](size_t i) { return v[i]; }
+    constexpr const T& operator[](size_t i) const { return v[i]; }
+};
+
+// N == 0: grows.
+template <class T>
+struct Buffer<T, 0> {
+    std::vector<T> v;
+    void push_back(const T& x) { v.push_back(x); }
+    size_t size() const { return v.size(); }
+    T& operator[](size_t i) { return v[i]; }
+    const T& operator[](size_t i) const { return v[i]; }
+};
+
+} // namespace detail
+
+// --- one instruction ---
+constexpr uint32_t add(Reg rd, Reg rs1, Reg rs2) {
+    return pack::rtype(0x00, detail::reg(rs2).n, detail::reg(rs1).n, 0x0, detail::reg(rd).n, 0x33);
+}
+constexpr uint32_t sub(Reg rd, Reg rs1, Reg rs2) {
+    return pack::rtype(0x20, detail::reg(rs2).n, detail::reg(rs1).n, 0x0, detail::reg(rd).n, 0x33);
+}
+constexpr uint32_t addi(Reg rd, Reg rs1, int32_t imm) {
+    return pack::itype(detail::imm12(imm), detail::reg(rs1).n, 0x0, detail::reg(rd).n, 0x13);
+}
+constexpr uint32_t jalr(Reg rd, Reg rs1, int32_t imm) {
+    return pack::itype(detail::imm12(imm), detail::reg(rs1).n, 0x0, detail::reg(rd).n, 0x67);
+}
+constexpr uint32_t lw(Reg rd, int32_t off, Reg rs1) {
+    return pack::itype(detail::imm12(off), detail::reg(rs1).n, 0x2, detail::reg(rd).n, 0x03);
+}
+constexpr uint32_t sw(Reg rs2, int32_t off, Reg rs1) {
+    return pack::stype(detail::imm12(off), detail::reg(rs2).n, detail::reg(rs1).n, 0x2, 0x23);
+}
+constexpr uint32_t beq(Reg rs1, Reg rs2, int32_t off) {
+    return pack::btype(detail::branchOff(off), detail::reg(rs2).n, detail::reg(rs1).n, 0x0, 0x63);
+}
+constexpr uint32_t bne(Reg rs1, Reg rs2, int32_t off) {
+    return pack::btype(detail::branchOff(off), detail::reg(rs2).n, detail::reg(rs1).n, 0x1, 0x63);
+}
+constexpr uint32_t lui(Reg rd, int32_t imm20) { return pack::utype(detail::imm20(imm20), detail::reg(rd).n, 0x37); }
+constexpr uint32_t auipc(Reg rd, int32_t imm20) { return pack::utype(detail::imm20(imm20), detail::reg(rd).n, 0x17); }
+constexpr uint32_t jal(Reg rd, int32_t off) { return pack::jtype(detail::jumpOff(off), detail::reg(rd).n, 0x6F); }
+
+// --- one-instruction pseudos, lowered as the text assembler lowers them (NOP is ADDI x0, x0, 0) ---
+constexpr uint32_t nop() { return addi(x0, x0, 0); }
+constexpr uint32_t mv(Reg rd, Reg rs) { return addi(rd, rs, 0); }
+constexpr uint32_t j(int32_t off) { return jal(x0, off); }
+constexpr uint32_t ret() { return jalr(x0, x1, 0); }
+
+// A position in an Assembler's program, bound once; branches and jumps may name it before.
+struct Label { uint32_t id = 0; };
+
+template <size_t N = 0>
+class Assembler {
+public:
+    constexpr Assembler() = default;
+
+    constexpr Label label() { labels_.push_back(kUnbound); return Label{(uint32_t)labels_.size() - 1}; }
+    constexpr Label here() { Label l = label(); bind(l); return l; }
+    constexpr Assembler& bind(Label l) {
+        detail::require(l.id < labels_.size() && labels_[l.id] == kUnbound, "label bound twice or not from here");
+        labels_[l.id] = (uint32_t)words_.size();
+        return *this;
+    }
+
+    constexpr size_t size() const { return words_.size(); } // words so far
+    constexpr uint32_t pc() const { return (uint32_t)words_.size() * 4; }
+
+    constexpr Assembler& emit(uint32_t word) { words_.push_back(word); return *this; }
+
+    constexpr Assembler& add(Reg rd, Reg rs1, Reg rs2) { return emit(rv::add(rd, rs1, rs2)); }
+    constexpr Assembler& sub(Reg rd, Reg rs1, Reg rs2) { return emit(rv::sub(rd, rs1, rs2)); }
+    constexpr Assembler& addi(Reg rd, Reg rs1, int32_t imm) { return emit(rv::addi(rd, rs1, imm)); }
+    constexpr Assembler& jalr(Reg rd, Reg rs1, int32_t imm) { return emit(rv::jalr(rd, rs1, imm)); }
+    constexpr Assembler& lw(Reg rd, int32_t off, Reg rs1) { return emit(rv::lw(rd, off, rs1)); }
+    constexpr Assembler& sw(Reg rs2, int32_t off, Reg rs1) { return emit(rv::sw(rs2, off, rs1)); }
+    constexpr Assembler& lui(Reg rd, int32_t imm20) { return emit(rv::lui(rd, imm20)); }
+    constexpr Assembler& auipc(Reg rd, int32_t imm20) { return emit(rv::auipc(rd, imm20)); }
+    constexpr Assembler& beq(Reg rs1, Reg rs2, Label l) { return fixup(rv::beq(rs1, rs2, 0), l, kBranch); }
+    constexpr Assembler& bne(Reg rs1, Reg rs2, Label l) { return fixup(rv::bne(rs1, rs2, 0), l, kBranch); }
+    constexpr Assembler& jal(Reg rd, Label l) { return fixup(rv::jal(rd, 0), l, kJump); }
+
+    constexpr Assembler& nop() { return emit(rv::nop()); }
+    constexpr Assembler& mv(Reg rd, Reg rs) { return emit(rv::mv(rd, rs)); }
+    constexpr Assembler& j(Label l) { return jal(x0, l); }
+    constexpr Assembler& call(Label l) { return jal(x1, l); }
+    constexpr Assembler& ret() { return emit(rv::ret()); }
+    // ADDI, LUI, or LUI+ADDI; the value is taken modulo 2^32.
+    constexpr Assembler& li(Reg rd, int64_t value) {
+        detail::require(value >= INT32_MIN && value <= (int64_t)UINT32_MAX, "LI value out of range");
+        uint32_t u = (uint32_t)value;
+        int32_t s = (int32_t)u;
+        if (s >= -2048 && s <= 2047) return addi(rd, x0, s);
+        uint32_t hi = ((u + 0x800u) >> 12) & 0xFFFFFu; // ADDI sign-extends lo
+        lui(rd, (int32_t)hi);
+        if ((u & 0xFFFu) == 0) return *this;
+        return addi(rd, rd, (int32_t)(u - (hi << 12)));
+    }
+
+    // Resolves label references; every label used must be bound by now. N > 0: the program
+    // must be exactly N words (std::array<uint32_t, N>); N == 0: a std::vector<uint32_t>.
+    constexpr auto finish() {
+        for (size_t k = 0; k < fixups_.size(); ++k) {
+            const Fixup& f = fixups_[k];
+            uint32_t to = labels_[f.label];
+            detail::require(to != kUnbound, "label used but never bound");
+            int64_t off = ((int64_t)to - (int64_t)f.at) * 4;
+            words_[f.at] |= f.kind == kBranch ? pack::btype(detail::branchOff(off), 0, 0, 0, 0)
+                                              : pack::jtype(detail::jumpOff(off), 0, 0);
+        }
+        fixups_ = {};
+        if constexpr (N > 0) {
+            detail::require(words_.size() == N, "program length differs from N");
+            return words_.v;
+        } else {
+            return words_.v;
+        }
+    }
+
+private:
+    static constexpr uint32_t kUnbound = UINT32_MAX;
+    enum Kind : uint8_t { kBranch, kJump };
+    struct Fixup { uint32_t at = 0, label = 0; Kind kind = kBranch; };
+
+    constexpr Assembler& fixup(uint32_t word, Label l, Kind kind) {
+        detail::require(l.id < labels_.size(), "label not from this assembler");
+        fixups_.push_back(Fixup{(uint32_t)words_.size(), l.id, kind});
+        return emit(word);
+    }
+
+    // A fixed program has room for two labels per position (N + 1 of them, counting the
+    // end) and one reference per word.
+    detail::Buffer<uint32_t, N> words_;
+    detail::Buffer<uint32_t, N ? 2 * N + 2 : 0> labels_;
+    detail::Buffer<Fixup, N> fixups_;
+};
+
+// A fixed program of exactly N words: build(a) is called with an Assembler<N>.
+template <size_t N, class F>
+constexpr std::array<uint32_t, N> program(F build) {
+    static_assert(N > 0, "rv::program needs a word count; use rv::Assembler<> to grow");
+    Assembler<N> a;
+    build(a);
+    return a.finish();
+}
+
+// Little-endian image bytes of words (a std::array or std::vector of uint32_t).
+template <class Words>
+std::vector<uint8_t> bytes(const Words& words) {
+    std::vector<uint8_t> out;
+    out.reserve(words.size() * 4);
+    for (uint32_t w : words)
+        for (int k = 0; k < 4; ++k) out.push_back((uint8_t)(w >> (8 * k)));
+    return out;
+}
+
+} // namespace rv
@@ -0,0 +1,27 @@
+// --sched: per-block list scheduling of Program::instrs for in-order pipelines
+#pragma once
+#include "assembler/parser.h"
+#include <cstddef>
+#include <cstdint>
+
+// Cycles from issue until a result can be used by the next instruction (1 = back to back).
+// The default is a classic 5-stage pipe with forwarding: one bubble on load-use, none else.
+struct LatencyModel {
+    unsigned alu = 1;
+    unsigned load = 2;
+};
+
+struct ScheduleStats {
+    size_t blocks = 0, reordered = 0;
+    uint64_t stallsBefore = 0, stallsAfter = 0; // estimated, summed over blocks
+    const char* skipped = nullptr;              // why nothing was done, if so
+};
+
+// Reorders instructions inside each basic block to hide result latencies. Dependences are
+// register RAW/WAR/WAW plus memory order (LW/SW may not pass an SW; SW may not pass an LW).
+// Branches, jumps and AUIPC keep their position, and nothing crosses a label, so layout and
+// every label address are unchanged. A block is only rewritten when its estimate improves.
+// Programs with a literal branch or jump offset are left alone: its target is not a label,
+// so nothing stops the instruction it lands on from moving.
+// Stalls are estimated per block, single issue, with every register ready on block entry.
+ScheduleStats schedule(Program& prog, const LatencyModel& lat = {});
@@ -2,13 +2,16 @@
 #pragma once
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <cstdint>
 
+// Keys are views: defined names must outlive the table (they live in the Program's arena).
 class SymbolTable {
 public:
-    void define(const std::string& name, uint32_t addr);
-    bool isDefined(const std::string& name) const;
-    uint32_t get(const std::string& name) const;
+    void define(std::string_view name, uint32_t addr);
+    bool isDefined(std::string_view name) const;
+    uint32_t get(std::string_view name) const; // throws on undefined names
+    bool lookup(std::string_view name, uint32_t& out) const; // non-throwing get()
 private:
-    std::unordered_map<std::string, uint32_t> map_;
+    std::unordered_map<std::string_view, uint32_t> map_;
 };
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+//
+// Bump allocator for short-lived, per-job data (assembler front-end and IR).
+//
+// Allocation is a pointer bump inside large chunks; nothing is freed individually.
+// reset() releases everything at once but keeps the chunks, so a long-lived process
+// can run job after job without going back to malloc. Only trivially destructible
+// objects belong here: destructors are never run.
+//
+
+class Arena {
+public:
+    explicit Arena(size_t chunkSize = 64 * 1024);
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* alloc(size_t size, size_t align = alignof(std::max_align_t));
+
+    // Uninitialized storage for n objects of T.
+    template<class T> T* allocArray(size_t n) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        return static_cast<T*>(alloc(sizeof(T) * n, alignof(T)));
+    }
+
+    // Copy of s owned by the arena (not NUL-terminated).
+    std::string_view copy(std::string_view s);
+
+    // Forget all allocations; chunks are kept for reuse.
+    void reset();
+
+    size_t bytesUsed() const { return used_; }      // live bytes in the current job
+    size_t highWater() const { return high_; }      // peak bytesUsed() since construction
+    size_t bytesReserved() const { return reserved_; } // chunk memory held from the system
+
+private:
+    struct Chunk { char* base; size_t size; };
+    bool nextChunk(size_t size, size_t align);
+
+    std::vector<Chunk> chunks_;
+    size_t cur_ = 0;      // index of the chunk being bumped
+    char* ptr_ = nullptr; // next free byte in chunks_[cur_]
+    char* end_ = nullptr;
+    size_t chunkSize_;
+    size_t used_ = 0, high_ = 0, reserved_ = 0;
+};
+
+// std-compatible allocator over an Arena; deallocate is a no-op.
+template<class T>
+struct ArenaAllocator {
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    Arena* arena;
+
+    ArenaAllocator(Arena& a) : arena(&a) {}
+    template<class U> ArenaAllocator(const ArenaAllocator<U>& o) : arena(o.arena) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(arena->alloc(sizeof(T) * n, alignof(T))); }
+    void deallocate(T*, size_t) {}
+
+    template<class U> bool operator==(const ArenaAllocator<U>& o) const { return arena == o.arena; }
+    template<class U> bool operator!=(const ArenaAllocator<U>& o) const { return arena != o.arena; }
+};
+
+template<class T> using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// Non-owning view of n contiguous arena-allocated Ts (std::span stand-in for C++17).
+template<class T>
+struct ArenaSpan {
+    T* ptr = nullptr;
+    uint32_t n = 0;
+
+    size_t size() const { return n; }
+    bool empty() const { return n == 0; }
+    T& operator[](size_t i) const { return ptr[i]; }
+    T* begin() const { return ptr; }
+    T* end() const { return ptr + n; }
+};
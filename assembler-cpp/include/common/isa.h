@@ -24,6 +24,7 @@ typedef enum InstrTag {
   TAG_LUI,
   TAG_AUIPC,
   TAG_JAL,
+  TAG_BNE,
 } InstrTag;
 
 typedef enum IsaStatus {
@@ -44,6 +45,10 @@ typedef struct DecodedInstr {
   int32_t imm;
 } DecodedInstr;
 
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
 const char *isa_status_str(enum IsaStatus code);
 
 enum IsaStatus isa_encode_add(uint8_t rd, uint8_t rs1, uint8_t rs2, uint32_t *out_word);
@@ -58,6 +63,8 @@ enum IsaStatus isa_encode_sw(uint8_t rs1, uint8_t rs2, int32_t imm, uint32_t *ou
 
 enum IsaStatus isa_encode_beq(uint8_t rs1, uint8_t rs2, int32_t imm, uint32_t *out_word);
 
+enum IsaStatus isa_encode_bne(uint8_t rs1, uint8_t rs2, int32_t imm, uint32_t *out_word);
+
 enum IsaStatus isa_encode_jal(uint8_t rd, int32_t imm, uint32_t *out_word);
 
 enum IsaStatus isa_encode_jalr(uint8_t rd, uint8_t rs1, int32_t imm, uint32_t *out_word);
@@ -92,4 +99,8 @@ int32_t isa_imm_j(uint32_t word);
 
 uint32_t isa_ffi_version(void);
 
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+
 #endif  /* ISA_H */
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+//
+// PC -> source line map written by the assembler (--map) for tools that run or inspect
+// its images. Stored as runs: each (pc, line) pair covers PCs up to the next pair.
+//
+// File format (little-endian): "RVLM", u32 version, u32 source path length, the path,
+// u32 run count, then per run a LEB128 pc delta and a zigzag LEB128 line delta. Typical
+// straight-line code costs two bytes per source line.
+//
+struct LineMap {
+    std::string source; // .s path as given to the assembler
+    std::vector<std::pair<uint32_t, uint32_t>> runs; // (first pc, line), ascending pc
+
+    // Line of the instruction at pc, 0 if the map does not cover it.
+    uint32_t lineAt(uint32_t pc) const;
+};
+
+bool writeLineMap(const std::string& path, const LineMap& map);
+bool readLineMap(const std::string& path, LineMap& map); // false on I/O or format errors
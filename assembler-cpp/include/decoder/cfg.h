@@ -0,0 +1,63 @@
+#pragma once
+#include "common/isa.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Control-flow graph of a raw image (little-endian 32-bit words mixed with RVC parcels),
+// found by recursive descent from entry points: only bytes some path reaches are decoded,
+// so data between functions is never taken for code.
+//
+// Paths follow fall-through, both sides of BEQ/BNE, JAL targets and JALRs whose target is
+// a constant (rs1 set by the AUIPC or LUI just before them). A JAL or JALR that links
+// (rd != x0) is a call and its path continues after it as well; one that does not ends
+// its path. A path also ends at an encoding that does not decode, at the end of the image
+// and where it runs into code already visited.
+//
+// Blocks start at entries, at targets, after every branch or jump and wherever code
+// resumes after a gap; they are kept in address order. Instructions may overlap (a jump
+// into the second half of a 32-bit word), in which case so may blocks.
+//
+// Building is linear in the image size: bitmaps over the 2-byte parcels and a rank
+// directory for address -> block, no maps or sorting.
+struct ImageCfg {
+    static constexpr uint32_t kNone = UINT32_MAX;     // no edge
+    static constexpr uint32_t kExit = UINT32_MAX - 1; // leaves the image or goes somewhere unknown
+
+    enum : uint8_t { kEntry = 1, kJumpTarget = 2, kCallTarget = 4 }; // flags
+
+    std::vector<uint32_t> start; // byte address of block b's first instruction
+    std::vector<uint32_t> end;   // one past its last instruction
+    std::vector<uint32_t> fall;  // successor in address order: after a non-jump, a branch, or a
+                                 // call (its return point); kNone after a plain jump, kExit when
+                                 // the next bytes are not code
+    std::vector<uint32_t> taken; // branch/jump/call target block; kNone for other instructions,
+                                 // kExit for unknown JALR targets and targets outside the code
+    std::vector<uint8_t> flags;  // how the block is entered: kEntry | kJumpTarget | kCallTarget
+
+    size_t instrs = 0;  // reached instructions
+    size_t invalid = 0; // reached parcels that do not decode (paths stop there)
+
+    // One bit per 2-byte parcel: an instruction starts there / a block starts there.
+    std::vector<uint64_t> codeBits, leaderBits;
+    std::vector<uint32_t> rank; // leaders before each word of leaderBits
+
+    size_t blocks() const { return start.size(); }
+    bool isCode(uint32_t addr) const { return bit(codeBits, addr); }
+    // The block starting at addr, or kNone.
+    uint32_t blockAt(uint32_t addr) const;
+
+private:
+    static bool bit(const std::vector<uint64_t>& v, uint32_t addr) {
+        size_t p = addr >> 1;
+        return (addr & 1) == 0 && (p >> 6) < v.size() && (v[p >> 6] >> (p & 63) & 1);
+    }
+};
+
+// Entry points outside the image or at odd addresses are ignored.
+ImageCfg buildImageCfg(const uint8_t* image, size_t size, const std::vector<uint32_t>& entries = {0});
+
+// The instruction at addr: its length (2 or 4; 0 past the end of the image) and fields.
+// False, with TAG_INVALID, when the bytes there do not decode.
+bool decodeAt(const uint8_t* image, size_t size, uint32_t addr, DecodedInstr& out, unsigned& len,
+              uint32_t& word);
@@ -1,4 +1,5 @@
 #pragma once
+#include "common/isa.h"
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -11,7 +12,20 @@ struct Decoded {
     std::vector<std::string> operands; // already formatted (e.g., "x1", "0(x2)", "0x10")
 };
 
-// Decode one 32-bit RV32I word at 'pc' into a Decoded struct.
+// Field-level decode of one 32-bit RV32I word into the same record the Rust isa crate
+// produces through isa_decode (tag, rd/rs1/rs2, sign-extended imm; unused fields are 0).
+// Never throws or allocates: returns false and sets TAG_INVALID on unknown encodings.
+bool decodeInstr(uint32_t word, DecodedInstr& out);
+
+// RV32C: a parcel whose low two bits are not 0b11 is a 16-bit instruction.
+inline unsigned instrLength(uint16_t lowHalf) { return (lowHalf & 0x3u) == 0x3u ? 4u : 2u; }
+
+// Field-level decode of a 16-bit RVC parcel into its base-ISA expansion
+// (e.g. C.LI x5, 3 -> TAG_ADDI x5, x0, 3). Same contract as decodeInstr.
+bool decodeCompressed(uint16_t half, DecodedInstr& out);
+
+// Decode one 32-bit RV32I word at 'pc' into a Decoded struct. A word whose low bits
+// mark an RVC parcel decodes its low half as a compressed instruction ("C.ADDI", ...).
 // Throws std::runtime_error on unknown/invalid encodings.
 Decoded decodeWord(uint32_t word, uint32_t pc);
 
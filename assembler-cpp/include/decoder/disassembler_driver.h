@@ -7,4 +7,11 @@
 // Options:
 //  - show_pc : prefix each line with the PC (addr)
 //  - show_raw: also show the raw 32-bit word before the mnemonic
-int disassembleFile(const std::string& inPath, bool show_pc = true, bool show_raw = false);
+//  - mode    : Linear decodes every parcel in order; Recursive decodes only the code reached
+//              from address 0 (decoder/cfg.h), prints the rest as .word/.half data, and
+//              prints branch and jump targets as labels: f_XXXXXXXX for the entry and call
+//              targets, L_XXXXXXXX for the others
+enum class DisasmMode { Linear, Recursive };
+
+int disassembleFile(const std::string& inPath, bool show_pc = true, bool show_raw = false,
+                    DisasmMode mode = DisasmMode::Linear);
@@ -6,6 +6,23 @@
 // If show_raw is true, includes the raw word after the PC.
 std::string formatDecoded(const Decoded& d, bool show_pc = true, bool show_raw = false);
 
+// Allocation-free variant: appends the same text (no newline) for a field-decoded
+// instruction to a caller-owned buffer. Reuse one buffer across lines and flush it in
+// large chunks; once it has grown, formatting never touches the heap. A non-null target
+// is printed in place of a BEQ/BNE/JAL target address (a label).
+void appendDecoded(std::string& out, const DecodedInstr& di, uint32_t pc, uint32_t word,
+                   bool show_pc = true, bool show_raw = false, const char* target = nullptr);
+
+// "unknown encoding: opcode=0x33 word=0x..." for a word (or zero-extended RVC parcel) that
+// does not decode; the one wording for decodeWord's exception and the disassembler's warning.
+void appendUnknownEncoding(std::string& out, uint32_t word);
+
+// Table lookups shared by the formatters: "x0".."x31" and "ADD".."JAL" (nullptr if invalid).
+const char* regName(uint8_t r);
+const char* mnemonicName(InstrTag tag);
+
 // Helpers if you ever want to reuse:
 std::string formatHex32(uint32_t v); // "0xXXXXXXXX"
 std::string formatPc(uint32_t pc);   // "XXXXXXXX"
+void appendHex32(std::string& out, uint32_t v); // appends "0xXXXXXXXX"
+void appendPc(std::string& out, uint32_t pc);   // appends "XXXXXXXX"
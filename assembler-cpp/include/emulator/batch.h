@@ -0,0 +1,46 @@
+// --batch: many images in one process, one isolated hart each, on a work-stealing pool
+#pragma once
+#include "emulator/engine.h"
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+struct BatchJob {
+    std::string path;
+    uint64_t budget = 0; // instructions; 0 uses BatchOptions::budget
+};
+
+struct BatchOptions {
+    unsigned threads = 0;        // 0: one per hardware thread
+    uint64_t memSize = 1u << 20; // guest memory per program, at most Engine::kMaxMem
+    uint64_t budget = 100000000; // default per-program instruction budget
+};
+
+struct BatchResult {
+    bool loaded = false; // false: image missing or empty, nothing ran
+    RunResult run;
+    Hart hart;           // registers at the stop
+    double seconds = 0;
+};
+
+struct BatchStats {
+    unsigned threads = 0;
+    uint64_t instrs = 0, steals = 0;
+    double seconds = 0; // wall time of the whole batch
+};
+
+// Runs every job and returns results[i] for jobs[i]. Each program gets its own Engine, so
+// memory and registers are never shared. Jobs are dealt in contiguous runs to per-thread
+// deques; a thread works from the back of its own and, when it runs dry, steals from the
+// front of another's, so a few long programs do not leave the other cores idle.
+std::vector<BatchResult> runBatch(const std::vector<BatchJob>& jobs, const BatchOptions& opts,
+                                  BatchStats* stats = nullptr);
+
+// The batch as one JSON document: totals, a count per stop reason, then one object per
+// program with its stop reason, pc, instruction count and registers x0..x31.
+void writeBatchReport(std::ostream& os, const std::vector<BatchJob>& jobs,
+                      const std::vector<BatchResult>& results, const BatchStats& stats);
+
+// Short machine-readable stop reason ("halted", "budget", ...); "load_error" if !loaded.
+const char* batchStatusName(const BatchResult& r);
@@ -0,0 +1,97 @@
+// --cache: set-associative I/D cache simulation with an optional shared L2, as an Engine observer
+#pragma once
+#include "emulator/engine.h"
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class Replacement : uint8_t { LRU, FIFO, Random };
+// Write-back allocates on a write miss and writes dirty victims to the next level;
+// write-through sends every store to the next level and does not allocate.
+enum class WritePolicy : uint8_t { WriteBack, WriteThrough };
+
+struct CacheConfig {
+    uint32_t size = 16 * 1024; // bytes
+    uint32_t ways = 4;
+    uint32_t line = 32;        // bytes
+    Replacement repl = Replacement::LRU;
+    WritePolicy write = WritePolicy::WriteBack;
+};
+
+// "SIZE:WAYS:LINE[:lru|fifo|random][:wb|wt]", SIZE with an optional K/M suffix ("32K:8:64:wt").
+bool parseCacheConfig(const std::string& spec, CacheConfig& out);
+// Why cfg cannot be simulated (sizes not powers of two, more than 255 ways, ...), or nullptr.
+const char* cacheConfigError(const CacheConfig& cfg);
+std::string describe(const CacheConfig& cfg); // "16K 4-way 32B lru wb"
+
+struct CacheStats {
+    uint64_t reads = 0, writes = 0, readMisses = 0, writeMisses = 0, writebacks = 0;
+    uint64_t accesses() const { return reads + writes; }
+    uint64_t misses() const { return readMisses + writeMisses; }
+    double hitRate() const { return accesses() ? 1.0 - (double)misses() / (double)accesses() : 0.0; }
+};
+
+// One level. State is a fixed set of flat arrays sized at construction (tags, LRU ranks,
+// dirty bits, FIFO pointers), so an access never allocates.
+class Cache {
+public:
+    explicit Cache(const CacheConfig& cfg, Cache* next = nullptr); // cfg must pass cacheConfigError
+    bool access(uint32_t addr, bool write); // true on a hit; misses go on to the next level
+    const CacheStats& stats() const { return st_; }
+    const CacheConfig& config() const { return cfg_; }
+    unsigned lineShift() const { return lineShift_; }
+
+private:
+    static constexpr uint32_t kInvalid = UINT32_MAX; // never a line number (line >= 2 bytes)
+    void touch(uint32_t base, uint32_t way);
+    uint32_t victim(uint32_t set);
+
+    CacheConfig cfg_;
+    Cache* next_;
+    unsigned lineShift_;
+    uint32_t setMask_;
+    std::vector<uint32_t> tags_; // line number per (set, way)
+    std::vector<uint8_t> rank_;  // LRU: 0 = most recently used
+    std::vector<uint8_t> dirty_;
+    std::vector<uint8_t> fifo_;  // per set: next way to replace
+    uint32_t rng_ = 0x9E3779B9u;
+    CacheStats st_;
+};
+
+struct PcMisses {
+    uint64_t fetch = 0, data = 0;
+};
+
+// L1 instruction and data caches, optionally backed by one unified L2.
+class CacheModel : public NullObserver {
+public:
+    CacheModel(uint32_t imageSize, const CacheConfig& icfg, const CacheConfig& dcfg,
+               const CacheConfig* l2cfg = nullptr);
+
+    void memAccess(uint32_t pc, uint32_t addr, bool store) {
+        // A misaligned word may straddle two lines.
+        bool miss = !d_.access(addr, store);
+        if (((addr ^ (addr + 3)) >> d_.lineShift()) && !d_.access(addr + 3, store)) miss = true;
+        if (miss) ++perPc_[pc >> 1].data;
+    }
+    void retire(uint32_t pc, const Op& op) {
+        bool miss = !i_.access(pc, false);
+        if (((pc ^ (pc + op.len - 1)) >> i_.lineShift()) && !i_.access(pc + op.len - 1, false)) miss = true;
+        if (miss) ++perPc_[pc >> 1].fetch;
+    }
+
+    const Cache& icache() const { return i_; }
+    const Cache& dcache() const { return d_; }
+    const Cache* l2() const { return l2_.get(); }
+    const std::vector<PcMisses>& perPc() const { return perPc_; } // indexed by pc/2
+
+    // Hit rates per level and the `top` PCs with the most misses, disassembled.
+    void report(std::ostream& os, const Engine& eng, size_t top) const;
+
+private:
+    std::unique_ptr<Cache> l2_; // before i_/d_, which point at it
+    Cache i_, d_;
+    std::vector<PcMisses> perPc_;
+};
@@ -0,0 +1,71 @@
+// --checkpoint: whole-machine checkpoints on disk, written in the background
+#pragma once
+#include "emulator/engine.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+// File: this header, then `pages` records of CheckpointPage followed by `size` bytes
+// (a raw page if size == kPageSize, otherwise packed; see checkpoint.cpp), then a u32
+// FNV-1a hash of everything before it. Little-endian. RAM pages that are all zero are
+// left out; the program image is not stored separately, its pages are part of RAM.
+struct CheckpointHeader {
+    char magic[4] = {'R', 'V', 'C', 'K'};
+    uint32_t version = 1;
+    uint64_t instret = 0;  // instructions retired before the checkpoint (across resumes)
+    uint64_t memSize = 0;  // bytes of RAM
+    uint32_t imageSize = 0; // Engine::imageSize(): where predecoded code ends
+    uint32_t pages = 0;
+    uint32_t x[32] = {};
+    uint32_t pc = 0;
+    uint32_t reserved = 0;
+};
+static_assert(sizeof(CheckpointHeader) == 168, "checkpoint header layout");
+
+struct CheckpointPage {
+    uint32_t vpn;
+    uint32_t size;
+};
+
+struct CheckpointStats {
+    uint64_t instret = 0;
+    size_t pages = 0, zeroPages = 0; // written / all-zero and left out
+    uint64_t rawBytes = 0, fileBytes = 0;
+    double pauseSeconds = 0; // the caller's: capturing registers and sharing pages
+    double seconds = 0;      // the writer thread's
+};
+
+// Saves checkpoints without stopping the guest for the write: start() copies the hart and
+// takes the RAM pages copy-on-write (GuestMemory::sharePages), then a thread packs them
+// into `path` (through a temporary file renamed over it, so a crash never leaves half a
+// checkpoint). The engine may keep running meanwhile; pages it writes are copied first.
+class CheckpointWriter {
+public:
+    CheckpointWriter() = default;
+    ~CheckpointWriter(); // wait()s
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    // Waits for the previous save first.
+    void start(Engine& eng, uint64_t instret, const std::string& path);
+    // Waits for the save in flight (if any); false if it failed, with error() saying why.
+    bool wait();
+    bool busy() const { return thread_.joinable(); }
+    const CheckpointStats& stats() const { return stats_; } // of the last save, after wait()
+    const std::string& error() const { return err_; }
+
+private:
+    void write(CheckpointHeader hdr, std::vector<GuestMemory::SharedPage> pages, std::string path);
+
+    std::thread thread_;
+    CheckpointStats stats_;
+    std::string err_;
+    bool ok_ = true;
+};
+
+// Writes a checkpoint synchronously.
+bool saveCheckpoint(Engine& eng, uint64_t instret, const std::string& path, std::string& err);
+// A new engine in the saved state (memory, registers, pc), and the instructions retired
+// before it in `instret`; nullptr with `err` set for unreadable, corrupt or newer files.
+std::unique_ptr<Engine> loadCheckpoint(const std::string& path, uint64_t& instret, std::string& err);
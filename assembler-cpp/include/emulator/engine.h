@@ -0,0 +1,231 @@
+// Execution engine: runs assembled RV32I(+C) images on one hart
+#pragma once
+#include "emulator/guest_memory.h"
+#include "common/isa.h"
+#include <cstdint>
+#include <vector>
+
+struct Hart {
+    uint32_t x[32] = {};
+    uint32_t pc = 0;
+};
+
+// Adjacent pairs that run() executes in one step (macro-op fusion). The first instruction
+// writes a register the second one reads:
+//   LUI rd; ADDI _, rd        constant load
+//   AUIPC rd; JALR _, rd      far call or jump
+//   AUIPC rd; LW _, rd        pc-relative load
+//   ADDI rd; BEQ/BNE rd, _    loop tail (either branch operand)
+// Nothing observable changes: hooks fire per instruction, a fault in the second leaves the
+// first retired, a budget can end between them, and a jump to the second runs it alone.
+enum class Fusion : uint8_t { None, LuiAddi, AuipcJalr, AuipcLw, AddiBranch };
+constexpr unsigned kFusionKinds = 5;
+const char* fusionName(Fusion f); // "lui+addi", ...
+
+// One predecoded instruction: the decodeInstr/decodeCompressed record plus what execution
+// and observers need without going back to memory.
+struct Op {
+    Op() : tag(TAG_INVALID) {}
+    InstrTag tag : 8;  // a byte, so that fuse fits in 16 bytes
+    uint8_t rd = 0, rs1 = 0, rs2 = 0;
+    uint8_t len = 4;   // 2 for an RVC parcel
+    Fusion fuse = Fusion::None; // this and the op at pc + len form a pair
+    int32_t imm = 0;
+    uint32_t word = 0; // raw encoding (16-bit parcels in the low half)
+};
+static_assert(sizeof(Op) == 16, "one Op per parcel slot: keep it small");
+
+enum class StopReason : uint8_t {
+    Halted,       // jump to itself (`JAL x0, self` / `BEQ x0, x0, self`)
+    EndOfImage,   // fell through the last instruction
+    PcOutOfImage, // control transfer outside the image
+    Budget,       // instruction budget used up
+    MemFault,     // LW/SW outside guest memory
+    Illegal,      // undecodable instruction
+};
+
+const char* stopReasonStr(StopReason r);
+
+struct RunResult {
+    StopReason reason = StopReason::Budget;
+    uint64_t instrs = 0; // retired by this run() call
+    uint32_t pc = 0;     // of the stopping instruction (the next one for Budget/EndOfImage)
+    uint32_t addr = 0;   // faulting address for MemFault
+};
+
+// Observer hooks, called for each executed instruction in this order: memAccess (LW/SW),
+// control (BEQ/BNE/JAL/JALR), retire. run() is a template over the observer, so an empty
+// hook costs nothing; observers derive from NullObserver and hide what they need.
+struct NullObserver {
+    void memAccess(uint32_t /*pc*/, uint32_t /*addr*/, bool /*store*/) {}
+    void control(uint32_t /*pc*/, const Op& /*op*/, bool /*taken*/, uint32_t /*target*/) {}
+    void retire(uint32_t /*pc*/, const Op& /*op*/) {}
+};
+
+class Engine {
+public:
+    static constexpr uint64_t kMaxMem = 1ull << 32; // the whole 32-bit address space
+
+    // The image is loaded at address 0 into memSize bytes of RAM (at least the image, at most
+    // kMaxMem), whose pages are only allocated when written.
+    explicit Engine(const std::vector<uint8_t>& image, uint64_t memSize = 1u << 20);
+
+    Hart& hart() { return h_; }
+    GuestMemory& memory() { return mem_; }
+    uint32_t imageSize() const { return codeEnd_; }
+    // Predecoded instruction at pc (pc even and below imageSize()).
+    const Op& opAt(uint32_t pc) const { return ops_[pc >> 1]; }
+
+    // Host write into guest memory (loading inputs, patching): like a guest store, code it
+    // overwrites is predecoded again. False if the range is outside memory.
+    bool write(uint32_t addr, const uint8_t* src, size_t n);
+
+    // Saves the hart and memory; restore() returns to that point, copying back only the
+    // memory pages written since (and re-predecoding any of them that hold code).
+    void snapshot();
+    void restore();
+
+    // Fusion is on by default. Off, every instruction is its own step; the results are the
+    // same either way.
+    void setFusion(bool on);
+    // Pairs executed fused (each retires two instructions).
+    uint64_t fusions(Fusion f) const { return fused_[(unsigned)f]; }
+
+    // Executes until a stop condition or `budget` instructions; resumable.
+    template<class Obs> RunResult run(uint64_t budget, Obs& obs);
+    RunResult run(uint64_t budget) { NullObserver o; return run(budget, o); }
+
+private:
+    void predecode(uint32_t from, uint32_t to); // every parcel slot in [from, to)
+    void fuse(uint32_t from, uint32_t to);      // Op::fuse of the slots in [from, to)
+
+    Hart h_, saved_;
+    GuestMemory mem_;
+    uint32_t codeEnd_;
+    std::vector<Op> ops_; // one per 16-bit slot of the image
+    bool fusion_ = true;
+    uint64_t fused_[kFusionKinds] = {};
+};
+
+template<class Obs>
+RunResult Engine::run(uint64_t budget, Obs& obs) {
+    RunResult r;
+    uint32_t* x = h_.x;
+    uint32_t pc = h_.pc;
+    uint64_t n = 0;
+    for (; n < budget; ++n) {
+        if (pc >= codeEnd_) {
+            r.reason = pc == codeEnd_ ? StopReason::EndOfImage : StopReason::PcOutOfImage;
+            break;
+        }
+        const Op& op = ops_[pc >> 1];
+        uint32_t next = pc + op.len;
+        switch (op.tag) {
+        case TAG_ADD:   x[op.rd] = x[op.rs1] + x[op.rs2]; break;
+        case TAG_SUB:   x[op.rd] = x[op.rs1] - x[op.rs2]; break;
+        // Heads of fused pairs continue with the second instruction in the same step unless
+        // the budget ends between them.
+        case TAG_ADDI:
+            x[op.rd] = x[op.rs1] + (uint32_t)op.imm;
+            if (op.fuse != Fusion::None && n + 1 < budget) goto fused;
+            break;
+        case TAG_LUI:
+            x[op.rd] = (uint32_t)op.imm;
+            if (op.fuse != Fusion::None && n + 1 < budget) goto fused;
+            break;
+        case TAG_AUIPC:
+            x[op.rd] = pc + (uint32_t)op.imm;
+            if (op.fuse != Fusion::None && n + 1 < budget) goto fused;
+            break;
+        case TAG_LW: {
+            uint32_t a = x[op.rs1] + (uint32_t)op.imm, v;
+            if (!mem_.load32(a, v)) { r.reason = StopReason::MemFault; r.addr = a; goto stop; }
+            obs.memAccess(pc, a, false);
+            x[op.rd] = v;
+            break;
+        }
+        case TAG_SW: {
+            uint32_t a = x[op.rs1] + (uint32_t)op.imm;
+            if (!mem_.store32(a, x[op.rs2])) { r.reason = StopReason::MemFault; r.addr = a; goto stop; }
+            obs.memAccess(pc, a, true);
+            if (a < codeEnd_) predecode(a > 2 ? a - 2 : 0, a + 4); // self-modifying code
+            break;
+        }
+        case TAG_BEQ: case TAG_BNE: {
+            bool taken = (x[op.rs1] == x[op.rs2]) == (op.tag == TAG_BEQ);
+            uint32_t t = pc + (uint32_t)op.imm;
+            obs.control(pc, op, taken, t);
+            if (taken) next = t;
+            break;
+        }
+        case TAG_JAL: {
+            uint32_t t = pc + (uint32_t)op.imm;
+            obs.control(pc, op, true, t);
+            x[op.rd] = next;
+            next = t;
+            break;
+        }
+        case TAG_JALR: {
+            uint32_t t = (x[op.rs1] + (uint32_t)op.imm) & ~1u;
+            obs.control(pc, op, true, t);
+            x[op.rd] = next;
+            next = t;
+            break;
+        }
+        default:
+            r.reason = StopReason::Illegal;
+            goto stop;
+        }
+        x[0] = 0;
+        obs.retire(pc, op);
+        if (next == pc) { r.reason = StopReason::Halted; ++n; goto stop; }
+        pc = next;
+        continue;
+    fused: {
+        // Hooks and stops are exactly those of running the two one at a time. The head wrote
+        // rd != 0 and cannot fault or transfer control; the budget has room for both.
+        obs.retire(pc, op);
+        ++n;
+        const Op& op2 = ops_[next >> 1];
+        uint32_t pc2 = next;
+        next = pc2 + op2.len;
+        ++fused_[(unsigned)op.fuse];
+        switch (op.fuse) {
+        case Fusion::LuiAddi:
+            x[op2.rd] = x[op2.rs1] + (uint32_t)op2.imm;
+            break;
+        case Fusion::AuipcJalr: {
+            uint32_t t = (x[op2.rs1] + (uint32_t)op2.imm) & ~1u;
+            obs.control(pc2, op2, true, t);
+            x[op2.rd] = next;
+            next = t;
+            break;
+        }
+        case Fusion::AuipcLw: {
+            uint32_t a = x[op2.rs1] + (uint32_t)op2.imm, v;
+            if (!mem_.load32(a, v)) { r.reason = StopReason::MemFault; r.addr = a; pc = pc2; goto stop; }
+            obs.memAccess(pc2, a, false);
+            x[op2.rd] = v;
+            break;
+        }
+        default: { // AddiBranch
+            bool taken = (x[op2.rs1] == x[op2.rs2]) == (op2.tag == TAG_BEQ);
+            uint32_t t = pc2 + (uint32_t)op2.imm;
+            obs.control(pc2, op2, taken, t);
+            if (taken) next = t;
+            break;
+        }
+        }
+        x[0] = 0;
+        obs.retire(pc2, op2);
+        if (next == pc2) { r.reason = StopReason::Halted; ++n; pc = pc2; goto stop; }
+        pc = next;
+    }
+    }
+    if (n == budget) r.reason = StopReason::Budget;
+stop:
+    h_.pc = pc;
+    r.pc = pc;
+    r.instrs = n;
+    return r;
+}
@@ -0,0 +1,92 @@
+// --fuzz: coverage-guided fuzzing of a guest, reset from a snapshot between inputs
+#pragma once
+#include "emulator/engine.h"
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+// Edge coverage of one execution: each control transfer (the pc of a BEQ/BNE/JAL/JALR and
+// where execution went next, taken or not) bumps a saturating 8-bit counter in a hashed
+// map. Only the counters touched are cleared between executions.
+class EdgeCoverage : public NullObserver {
+public:
+    static constexpr unsigned kMapBits = 16;
+
+    EdgeCoverage() : hits_(1u << kMapBits, 0) {}
+
+    void control(uint32_t pc, const Op& op, bool taken, uint32_t target) {
+        uint32_t i = index(pc, taken ? target : pc + op.len);
+        if (hits_[i] == 0) touched_.push_back(i);
+        if (hits_[i] != 255) ++hits_[i];
+    }
+
+    void clear();
+    // Folds this execution into `seen` (one bit per hit-count bucket: 1, 2, 3, 4-7, 8-15,
+    // 16-31, 32-127, 128+ per edge); true if it set a bit that was not there before.
+    bool merge(std::vector<uint8_t>& seen) const;
+
+    static uint32_t index(uint32_t from, uint32_t to) {
+        return (((from >> 1) * 0x9E3779B1u) ^ ((to >> 1) * 0x85EBCA77u)) >> (32 - kMapBits);
+    }
+
+private:
+    std::vector<uint8_t> hits_;
+    std::vector<uint32_t> touched_;
+};
+
+// The guest reads its input from memory: each execution starts from the snapshot with the
+// input written at inputAddr, its address in x10 and its length in x11.
+struct FuzzConfig {
+    uint32_t inputAddr = 0x10000;
+    uint32_t inputLen = 64;
+    uint64_t budget = 100000; // instructions per execution; running out counts as a hang
+    uint32_t entry = 0;       // pc at which the snapshot is taken (boot code runs before)
+    uint64_t seed = 1;
+};
+
+struct FuzzCrash {
+    StopReason reason;
+    uint32_t pc, addr;
+    uint64_t hits = 0;
+    std::vector<uint8_t> input; // the first input that crashed here
+};
+
+struct FuzzStats {
+    uint64_t execs = 0, hangs = 0, instrs = 0;
+    uint64_t dirtyPages = 0; // pages restored, summed over executions
+    size_t edges = 0;        // map entries ever hit
+    double seconds = 0;
+};
+
+// Mutates inputs from a corpus, keeps those that reach new coverage, and records crashes
+// (MemFault, Illegal, pc outside the image) unique by stop reason and pc. Each execution
+// restores the engine's snapshot first, which copies back only the pages the previous
+// execution wrote.
+class Fuzzer {
+public:
+    Fuzzer(Engine& eng, const FuzzConfig& cfg);
+
+    // Runs the boot code up to cfg.entry (at most `budget` instructions) and snapshots
+    // there; false if the guest stops or runs out before reaching it.
+    bool boot(uint64_t budget);
+    void run(uint64_t execs);
+
+    const std::vector<std::vector<uint8_t>>& corpus() const { return corpus_; }
+    const std::vector<FuzzCrash>& crashes() const { return crashes_; }
+    const FuzzStats& stats() const { return stats_; }
+    void report(std::ostream& os) const;
+
+private:
+    RunResult execute(const std::vector<uint8_t>& input);
+    void mutate(std::vector<uint8_t>& in);
+    uint64_t rand() { rng_ ^= rng_ << 13; rng_ ^= rng_ >> 7; rng_ ^= rng_ << 17; return rng_; } // xorshift64
+
+    Engine& eng_;
+    FuzzConfig cfg_;
+    EdgeCoverage cov_;
+    std::vector<uint8_t> seen_;
+    std::vector<std::vector<uint8_t>> corpus_;
+    std::vector<FuzzCrash> crashes_;
+    FuzzStats stats_;
+    uint64_t rng_;
+};
@@ -0,0 +1,160 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// A memory-mapped device. Offsets are relative to the start of its region; returning false
+// faults the access (MemFault).
+class MmioDevice {
+public:
+    virtual ~MmioDevice() = default;
+    virtual bool read32(uint32_t off, uint32_t& v) = 0;
+    virtual bool write32(uint32_t off, uint32_t v) = 0;
+};
+
+//
+// Guest physical memory for the execution engine: a sparse 32-bit little-endian address
+// space of 4 KiB pages. RAM covers [0, size) and is allocated a page at a time on first
+// write; untouched RAM reads as zero. MMIO regions map whole pages to a device. Anything
+// else fails instead of trapping the host.
+//
+// Loads and stores go through direct-mapped software TLBs (one for reads, one for writes)
+// that cache the host address of a page, so a hit is a tag compare and a memcpy. Misses,
+// page-crossing accesses and MMIO take the out-of-line path through the page table.
+//
+// snapshot()/restore() are copy-on-write: a snapshot copies nothing, and only the first
+// write to a page after it (made slow by dropping write TLB entries) saves the page's old
+// contents. restore() copies back just those pages, so its cost follows the pages written,
+// not the memory size. MMIO device state is not part of a snapshot.
+//
+// sharePages() hands out the RAM pages themselves for a reader on another thread (the
+// background checkpoint writer). Until the reader releases a page, the next write to it
+// copies it first, the same way: the reader keeps seeing the contents as of the call. Each
+// page counts its readers; a reader's release and the writing thread's check of the count
+// are a release/acquire pair, so once a page is written in place again, the reader's last
+// look at it happened before.
+//
+class GuestMemory {
+public:
+    static constexpr unsigned kPageBits = 12;
+    static constexpr uint32_t kPageSize = 1u << kPageBits;
+    static constexpr unsigned kTlbEntries = 256;
+
+    // size is rounded up to whole pages; at most 4 GiB.
+    explicit GuestMemory(uint64_t size);
+    GuestMemory(const GuestMemory&) = delete;
+    GuestMemory& operator=(const GuestMemory&) = delete;
+
+    uint64_t size() const { return size_; }
+
+    // Misaligned word accesses are allowed (the base ISA leaves them to the platform).
+    bool load32(uint32_t addr, uint32_t& v) {
+        const TlbEntry& e = rtlb_[(addr >> kPageBits) & (kTlbEntries - 1)];
+        if (e.vpn == addr >> kPageBits && (addr & (kPageSize - 1)) <= kPageSize - 4) {
+            std::memcpy(&v, e.host + (addr & (kPageSize - 1)), 4);
+            return true;
+        }
+        return loadSlow(addr, v);
+    }
+    bool store32(uint32_t addr, uint32_t v) {
+        const TlbEntry& e = wtlb_[(addr >> kPageBits) & (kTlbEntries - 1)];
+        if (e.vpn == addr >> kPageBits && (addr & (kPageSize - 1)) <= kPageSize - 4) {
+            std::memcpy(e.host + (addr & (kPageSize - 1)), &v, 4);
+            return true;
+        }
+        return storeSlow(addr, v);
+    }
+    // Bulk copy-in to RAM (program images); false if [addr, addr+n) is not all RAM.
+    bool write(uint32_t addr, const uint8_t* src, size_t n);
+    // Bulk copy-out of RAM; false if [addr, addr+n) is not all RAM.
+    bool read(uint32_t addr, uint8_t* dst, size_t n) const;
+    // 16-bit parcel for instruction fetch from RAM; 0 (an illegal parcel) anywhere else.
+    uint16_t fetch16(uint32_t addr) const {
+        uint8_t b[2];
+        return read(addr, b, 2) ? (uint16_t)(b[0] | (b[1] << 8)) : 0;
+    }
+
+    // Maps [base, base+size) to dev; both page-aligned and outside RAM and other regions.
+    // The device must outlive the memory.
+    bool mapMmio(uint32_t base, uint32_t size, MmioDevice& dev);
+
+    // Makes the current RAM contents the restore point.
+    void snapshot();
+    // Returns RAM to the last snapshot (no-op without one).
+    void restore();
+    // Page numbers written since the last snapshot or restore.
+    const std::vector<uint32_t>& dirtyPages() const { return dirty_; }
+
+    // A RAM page's bytes and the SharedPages still reading them.
+    struct PageData {
+        std::atomic<uint32_t> readers{0};
+        uint8_t bytes[kPageSize];
+    };
+
+    // A RAM page as of sharePages(), unchanging until release() (or destruction), which may
+    // happen on any thread.
+    class SharedPage {
+    public:
+        SharedPage(uint32_t vpn, std::shared_ptr<PageData> page) : vpn_(vpn), page_(std::move(page)) {}
+        SharedPage(SharedPage&&) noexcept = default;
+        SharedPage& operator=(SharedPage&& o) noexcept {
+            if (this != &o) { release(); vpn_ = o.vpn_; page_ = std::move(o.page_); }
+            return *this;
+        }
+        ~SharedPage() { release(); }
+
+        uint32_t vpn() const { return vpn_; }
+        const uint8_t* data() const { return page_->bytes; }
+        // Done reading: the memory may write the page in place again.
+        void release() {
+            if (!page_) return;
+            page_->readers.fetch_sub(1, std::memory_order_release);
+            page_.reset();
+        }
+
+    private:
+        uint32_t vpn_;
+        std::shared_ptr<PageData> page_;
+    };
+    // Every allocated RAM page, in address order (untouched pages are zero and left out).
+    std::vector<SharedPage> sharePages();
+
+    size_t pagesAllocated() const { return pages_; }
+    uint64_t tlbMisses() const { return misses_; }
+
+private:
+    struct TlbEntry {
+        uint32_t vpn = ~0u; // never a valid page number
+        uint8_t* host = nullptr;
+    };
+    struct Page {
+        std::shared_ptr<PageData> ram;    // RAM once written; see sharePages()
+        MmioDevice* dev = nullptr;        // or an MMIO page
+        uint32_t devBase = 0;             // guest address of the device's region
+        std::unique_ptr<uint8_t[]> saved; // contents at the snapshot while dirty; kept for reuse
+        bool dirty = false;               // written since the snapshot
+        bool savedZero = false;           // did not exist at the snapshot: restores to zero
+    };
+    static constexpr unsigned kDirBits = 10; // 1024 x 1024 pages
+    struct Table { Page pages[1u << kDirBits]; };
+
+    bool loadSlow(uint32_t addr, uint32_t& v);
+    bool storeSlow(uint32_t addr, uint32_t v);
+    Page* page(uint32_t vpn, bool create);
+    const Page* page(uint32_t vpn) const;
+    uint8_t* writablePage(uint32_t vpn); // allocates and tracks dirtiness; nullptr outside RAM
+    void unshare(uint32_t vpn, Page& p);  // a private copy of a page a reader still holds
+    bool isRam(uint32_t vpn) const { return (uint64_t)vpn << kPageBits < size_; }
+
+    TlbEntry rtlb_[kTlbEntries];
+    TlbEntry wtlb_[kTlbEntries];
+    uint64_t size_;
+    std::vector<std::unique_ptr<Table>> dir_;
+    std::vector<uint32_t> dirty_;
+    bool tracking_ = false; // a snapshot exists
+    size_t pages_ = 0;
+    uint64_t misses_ = 0;
+};
@@ -0,0 +1,54 @@
+// --lanes: one program on 8 harts at once, register files in SIMD lanes
+#pragma once
+#include "emulator/engine.h"
+#include <cstdint>
+#include <vector>
+
+// Runs the same image on kLanes harts that differ only in their starting state, e.g. fuzz
+// inputs. Registers are kept structure-of-arrays (x[r] is one vector of kLanes values), and
+// every step executes one instruction for all lanes that are at the same pc: ALU ops are
+// single vector operations, LW is a gather, and lanes whose BEQ/BNE/JALR outcome differs
+// are split off and wait (masked out) until the running group reaches their pc again. The
+// group always runs the lowest pc, so lanes that leave a loop early rejoin the others at
+// its exit.
+//
+// Each lane has its own memSize bytes of memory, with the image loaded at 0. The predecoded
+// code is shared, so the image is read-only here: a store into it faults (MemFault) instead
+// of modifying code as it would on Engine. Otherwise a lane stops exactly as Engine::run
+// would stop on its own, with the same RunResult.
+class LockstepEngine {
+public:
+    static constexpr unsigned kLanes = 8;
+    static constexpr uint32_t kMaxMem = 1u << 28; // per lane: lane offsets must fit a gather index
+
+    LockstepEngine(const std::vector<uint8_t>& image, uint32_t memSize = 1u << 16);
+
+    uint32_t& reg(unsigned lane, unsigned r) { return x_[r][lane]; }
+    uint32_t& pc(unsigned lane) { return pc_[lane]; }
+    uint8_t* laneMemory(unsigned lane) { return &mem_[(size_t)lane * memSize_]; }
+    Hart hart(unsigned lane) const;
+    void setHart(unsigned lane, const Hart& h);
+
+    // Runs every lane until it stops or has retired `budget` instructions. Not resumable:
+    // lanes stopped by the budget keep their state but stay stopped.
+    void run(uint64_t budget);
+    const RunResult& result(unsigned lane) const { return res_[lane]; }
+    uint64_t steps() const { return steps_; } // instructions issued for a whole group
+
+    // The AVX2 kernel is used when the CPU has it; false forces the portable kernel, which
+    // runs the same vector code on the baseline instruction set.
+    bool avx2() const { return avx2_; }
+    void setAvx2(bool on);
+
+private:
+    friend struct LockstepKernel;
+
+    alignas(32) uint32_t x_[32][kLanes] = {};
+    uint32_t pc_[kLanes] = {};
+    RunResult res_[kLanes];
+    uint64_t steps_ = 0;
+    uint32_t memSize_, codeEnd_;
+    std::vector<uint8_t> mem_; // lane l at l * memSize_
+    std::vector<Op> ops_;      // one per 16-bit slot of the image, as in Engine
+    bool avx2_;
+};
@@ -0,0 +1,69 @@
+// --bp: branch prediction simulation (direction predictors, BTB, return-address stack)
+#pragma once
+#include "emulator/engine.h"
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Conditional-branch direction predictor. predict() is always followed by update() for the
+// same branch before the next predict().
+class DirectionPredictor {
+public:
+    virtual ~DirectionPredictor() = default;
+    virtual bool predict(uint32_t pc, uint32_t target) = 0;
+    virtual void update(uint32_t pc, bool taken) = 0;
+    virtual std::string name() const = 0;
+};
+
+// "static" (backward taken, forward not taken), "bimodal", "gshare" or "tage"; `bits` is
+// log2 of the main table size. nullptr for an unknown kind.
+std::unique_ptr<DirectionPredictor> makePredictor(const std::string& kind, unsigned bits = 12);
+
+struct BranchConfig {
+    uint32_t btbEntries = 512; // direct-mapped, power of two
+    uint32_t rasDepth = 16;
+};
+
+struct PcBranch {
+    uint64_t count = 0, taken = 0;
+    std::vector<uint64_t> misses; // per predictor
+};
+
+// Every control transfer goes through the same front end: conditional branches ask each
+// direction predictor, taken transfers need the right target from the BTB, and returns
+// (JALR x0, x1/x5) from the RAS, which calls (JAL/JALR with rd x1/x5) push. A prediction
+// misses when the next fetch address would be wrong. Several direction predictors can run
+// side by side over the same BTB/RAS to compare them on one execution.
+class BranchModel : public NullObserver {
+public:
+    BranchModel(uint32_t imageSize, std::vector<std::unique_ptr<DirectionPredictor>> preds,
+                BranchConfig cfg = {});
+
+    void control(uint32_t pc, const Op& op, bool taken, uint32_t target);
+
+    struct Totals {
+        uint64_t branches = 0, taken = 0, jumps = 0, returns = 0, indirect = 0;
+        uint64_t btbMisses = 0, rasMisses = 0; // wrong or missing target for taken transfers
+    };
+    const Totals& totals() const { return tot_; }
+    uint64_t mispredicts(size_t p) const { return miss_[p]; } // all kinds, predictor p
+    const std::vector<PcBranch>& perPc() const { return perPc_; } // indexed by pc/2
+
+    // Accuracy per predictor, then for each predictor the `top` branch PCs by its
+    // mispredictions, disassembled.
+    void report(std::ostream& os, const Engine& eng, size_t top) const;
+
+private:
+    bool btbHit(uint32_t pc, uint32_t target) const;
+
+    std::vector<std::unique_ptr<DirectionPredictor>> preds_;
+    BranchConfig cfg_;
+    std::vector<uint32_t> btbTag_, btbTarget_;
+    std::vector<uint32_t> ras_;
+    uint32_t rasTop_ = 0, rasCount_ = 0;
+    Totals tot_;
+    std::vector<uint64_t> miss_, dirMiss_;
+    std::vector<PcBranch> perPc_;
+};
@@ -0,0 +1,46 @@
+// --profile: exact per-PC execution counts, reported as hot basic blocks with source lines
+#pragma once
+#include "emulator/engine.h"
+#include "common/linemap.h"
+#include <algorithm>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+// Counts flow into each PC instead of every retirement: a control transfer adds one entry
+// to wherever execution continues (target or fall-through). Every other instruction
+// executes as often as the one before it, so exact per-PC counts follow from one pass over
+// the image afterwards, and the hot loop pays only on branches and jumps.
+class ProfileModel : public NullObserver {
+public:
+    explicit ProfileModel(uint32_t imageSize) : entries_((imageSize >> 1) + 2, 0), taken_(entries_.size(), 0) {}
+
+    // Brackets each Engine::run: flow starts at the hart's pc and stops at r.pc.
+    void begin(uint32_t pc) { ++entries_[slot(pc)]; }
+    void end(const RunResult& r) { --entries_[slot(r.pc)]; } // r.pc was entered, not executed
+
+    void control(uint32_t pc, const Op& op, bool taken, uint32_t target) {
+        ++entries_[slot(taken ? target : pc + op.len)];
+        if (taken) ++taken_[slot(pc)];
+    }
+
+    // Executions per instruction, indexed by pc/2, for instructions on the linear sweep.
+    std::vector<uint64_t> counts(const Engine& eng) const;
+
+    // The `top` basic blocks by instructions executed, as disassembly listings with a count
+    // column and, when map is given, the source line each instruction came from. Blocks are
+    // cut at branch targets, after control transfers and wherever the count changes.
+    void report(std::ostream& os, const Engine& eng, const LineMap* map, size_t top) const;
+
+    // The counts by source line, for the assembler's --layout-profile: "@LINE COUNT" for the
+    // first instruction of each executed line, "@LINE -> @LINE COUNT" for taken BEQ/BNE/JAL
+    // (JALR targets vary, so they are left out). False if the stream fails.
+    bool writeLayoutProfile(std::ostream& os, const Engine& eng, const LineMap& map) const;
+
+private:
+    // Flow leaving the image is parked in the last slot.
+    size_t slot(uint32_t pc) const { return std::min<size_t>(pc >> 1, entries_.size() - 1); }
+
+    std::vector<int64_t> entries_;
+    std::vector<uint64_t> taken_; // per control transfer
+};
@@ -0,0 +1,63 @@
+// --sample: sampled timing: fast-forward functionally, time a few representative intervals
+#pragma once
+#include "emulator/engine.h"
+#include "emulator/timing.h"
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+struct SampleConfig {
+    uint64_t interval = 1000000; // instructions per interval
+    uint64_t warmup = 100000;    // run through the timing model, unmeasured, before a sample
+    unsigned maxK = 10;          // most clusters tried
+    unsigned perCluster = 3;     // intervals timed per cluster (its representative first)
+    uint64_t seed = 1;
+    TimingConfig timing;
+};
+
+// Basic-block vector of one interval, randomly projected to kDims dimensions (the
+// projection of a vector normalized to the interval's instruction count).
+constexpr unsigned kBbvDims = 15;
+struct Bbv {
+    double v[kBbvDims] = {};
+};
+
+struct SampleCluster {
+    std::vector<size_t> members;     // interval indices, in order
+    size_t representative = 0;       // the member closest to the centroid
+    std::vector<size_t> sampled;     // timed members (representative first)
+    std::vector<double> sampleCpi;   // CPI of each of those
+    double weight = 0;               // share of the program's instructions
+    double cpi = 0;                  // mean over the sampled intervals
+};
+
+struct SampleResult {
+    RunResult stop;          // of the functional run (instrs: the whole program)
+    size_t intervals = 0;
+    std::vector<Bbv> bbvs;   // one per interval
+    std::vector<uint32_t> assignment; // cluster of each interval
+    std::vector<SampleCluster> clusters;
+    uint64_t detailInstrs = 0, warmupInstrs = 0;
+    double cpi = 0;          // extrapolated
+    double cpiError = -1;    // 95% half-width; negative when no cluster had two samples
+    double profileSeconds = 0, clusterSeconds = 0, detailSeconds = 0;
+};
+
+// k-means over the vectors for k = 1..maxK (k-means++ seeding, a few restarts each),
+// scored by the Bayesian information criterion; returns the cluster of each vector for
+// the smallest k that scores within 90% of the best k's range, as SimPoint does.
+std::vector<uint32_t> clusterBbvs(const std::vector<Bbv>& bbvs, unsigned maxK, uint64_t seed);
+
+// Runs the engine's program (up to budget instructions) in three passes:
+//   1. functionally, collecting a BBV per interval;
+//   2. clustering the BBVs and choosing each cluster's representative and samples;
+//   3. from the engine's starting point again (Engine::snapshot/restore), functionally up
+//      to each sampled interval in order, then through a PipelineModel for the warm-up
+//      and the measured interval.
+// The CPI is the instruction-weighted mean of the clusters' CPIs; its error bound comes
+// from the spread of each cluster's samples (stratified sampling, with the finite
+// population correction, so a fully timed cluster contributes none).
+// Returns the engine to where it started (the snapshot taken there replaces any other).
+SampleResult runSampled(Engine& eng, uint64_t budget, const SampleConfig& cfg);
+
+void writeSampleReport(std::ostream& os, const SampleResult& r, const SampleConfig& cfg);
@@ -0,0 +1,89 @@
+// --timing: cycle-approximate 5-stage in-order pipeline model, as an Engine observer
+#pragma once
+#include "emulator/engine.h"
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+// IF ID EX MEM WB with full forwarding. Latencies count cycles from EX until a dependent
+// instruction may enter EX (1 = back to back). Penalties are the bubbles after a taken
+// control transfer: fetch assumes fall-through, so a taken branch is flushed when it
+// resolves in EX, a JAL redirects from ID.
+struct TimingConfig {
+    unsigned aluLatency = 1;
+    unsigned loadLatency = 2;    // one load-use bubble
+    unsigned branchPenalty = 2;  // taken BEQ/BNE
+    unsigned jalPenalty = 1;
+    unsigned jalrPenalty = 2;
+};
+
+struct PcTiming {
+    uint64_t count = 0;
+    uint64_t dataStalls = 0;    // this instruction waited for an operand
+    uint64_t controlStalls = 0; // bubbles after this instruction redirected fetch
+};
+
+class PipelineModel : public NullObserver {
+public:
+    explicit PipelineModel(uint32_t imageSize, TimingConfig cfg = {});
+
+    void control(uint32_t pc, const Op& op, bool taken, uint32_t /*target*/) {
+        if (!taken) return;
+        unsigned p = op.tag == TAG_JAL ? cfg_.jalPenalty
+                   : op.tag == TAG_JALR ? cfg_.jalrPenalty : cfg_.branchPenalty;
+        penalty_ = p;
+        perPc_[pc >> 1].controlStalls += p;
+        controlStalls_ += p;
+    }
+
+    void retire(uint32_t pc, const Op& op) {
+        uint64_t slot = next_;
+        uint64_t issue = slot;
+        bool fromLoad = false;
+        auto use = [&](uint8_t r) {
+            if (ready_[r] > issue) { issue = ready_[r]; fromLoad = loadDef_[r]; }
+        };
+        switch (op.tag) {
+        case TAG_ADD: case TAG_SUB: case TAG_SW: case TAG_BEQ: case TAG_BNE:
+            use(op.rs1); use(op.rs2); break;
+        case TAG_ADDI: case TAG_JALR: case TAG_LW:
+            use(op.rs1); break;
+        default: break;
+        }
+        uint64_t stall = issue - slot;
+        (fromLoad ? loadUseStalls_ : otherDataStalls_) += stall;
+        PcTiming& t = perPc_[pc >> 1];
+        ++t.count;
+        t.dataStalls += stall;
+        if (op.rd && op.tag != TAG_SW && op.tag != TAG_BEQ && op.tag != TAG_BNE) {
+            bool load = op.tag == TAG_LW;
+            ready_[op.rd] = issue + (load ? cfg_.loadLatency : cfg_.aluLatency);
+            loadDef_[op.rd] = load;
+        }
+        next_ = issue + 1 + penalty_;
+        penalty_ = 0;
+        ++instrs_;
+    }
+
+    uint64_t instrs() const { return instrs_; }
+    // Until the last instruction leaves WB: 4 cycles of fill/drain around the EX slots
+    // (a halting jump's own redirect bubbles are counted too).
+    uint64_t cycles() const { return instrs_ ? next_ + 4 : 0; }
+    double cpi() const { return instrs_ ? (double)cycles() / (double)instrs_ : 0.0; }
+    uint64_t loadUseStalls() const { return loadUseStalls_; }
+    uint64_t otherDataStalls() const { return otherDataStalls_; }
+    uint64_t controlStalls() const { return controlStalls_; }
+    const std::vector<PcTiming>& perPc() const { return perPc_; } // indexed by pc/2
+
+    // Totals, stall breakdown, and the `top` PCs with the most stall cycles, disassembled.
+    void report(std::ostream& os, const Engine& eng, size_t top) const;
+
+private:
+    TimingConfig cfg_;
+    uint64_t ready_[32] = {}; // first EX slot at which each register can be consumed
+    bool loadDef_[32] = {};   // ...and whether an LW produced it
+    uint64_t next_ = 0;       // earliest EX slot for the next instruction
+    unsigned penalty_ = 0;    // bubbles after the instruction being retired (taken transfer)
+    uint64_t instrs_ = 0, loadUseStalls_ = 0, otherDataStalls_ = 0, controlStalls_ = 0;
+    std::vector<PcTiming> perPc_;
+};
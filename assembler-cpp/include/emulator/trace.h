@@ -0,0 +1,91 @@
+// --trace: fixed-size binary execution records through a lock-free ring to a file
+#pragma once
+#include "emulator/engine.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One retired instruction. Fixed size, little-endian, no padding: consecutive records
+// differ in few bytes, which general-purpose compressors exploit well.
+struct TraceRecord {
+    uint32_t pc;
+    uint32_t word;  // raw encoding (RVC parcels in the low half)
+    uint32_t value; // rd after execution; the stored value for SW
+    uint32_t addr;  // effective address of LW/SW, 0 otherwise
+};
+static_assert(sizeof(TraceRecord) == 16, "trace records are 16 bytes on disk");
+
+// File: "RVTR", u32 version, u32 record size, then records until EOF.
+struct TraceHeader {
+    char magic[4] = {'R', 'V', 'T', 'R'};
+    uint32_t version = 1;
+    uint32_t recordSize = sizeof(TraceRecord);
+};
+
+// Observer that appends a TraceRecord per retired instruction to a single-producer /
+// single-consumer ring; a background thread drains it to disk. The hot path is a 16-byte
+// store and an index bump: the producer publishes its position every kPublish records and
+// only re-reads the consumer's position when its cached view of the ring is full, so there
+// are no atomics or locks per instruction. A full ring blocks the producer (no drops).
+class TraceWriter : public NullObserver {
+public:
+    // Traces the hart's registers; ringRecords is rounded up to a power of two.
+    TraceWriter(const Hart& hart, const std::string& path, size_t ringRecords = 1u << 16);
+    ~TraceWriter(); // flush()es
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    bool ok() const { return file_ != nullptr; }
+
+    void memAccess(uint32_t, uint32_t addr, bool) { addr_ = addr; }
+    void retire(uint32_t pc, const Op& op) {
+        if (head_ - tailSeen_ == ring_.size()) waitForSpace();
+        TraceRecord& r = ring_[head_ & mask_];
+        bool mem = op.tag == TAG_LW || op.tag == TAG_SW;
+        r.pc = pc;
+        r.word = op.word;
+        r.value = hart_.x[op.tag == TAG_SW ? op.rs2 : op.rd];
+        r.addr = mem ? addr_ : 0;
+        if ((++head_ & (kPublish - 1)) == 0) published_.store(head_, std::memory_order_release);
+    }
+
+    // Writes everything traced so far and stops the drain thread. Trace nothing after this.
+    void flush();
+    uint64_t records() const { return head_; }
+
+private:
+    static constexpr uint64_t kPublish = 256;
+    void waitForSpace();
+    void drain();
+
+    const Hart& hart_;
+    std::FILE* file_ = nullptr;
+    std::vector<TraceRecord> ring_;
+    uint64_t mask_;
+    uint64_t head_ = 0;     // producer: next record to fill
+    uint64_t tailSeen_ = 0; // producer's last view of consumed_
+    uint32_t addr_ = 0;
+    alignas(64) std::atomic<uint64_t> published_{0}; // records visible to the drain thread
+    alignas(64) std::atomic<uint64_t> consumed_{0};  // records written to the file
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+// Offline side: reads a trace file in blocks.
+class TraceReader {
+public:
+    explicit TraceReader(const std::string& path); // check ok()
+    ~TraceReader();
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    bool ok() const { return file_ != nullptr; }
+    // Up to max records into out; 0 at the end of the trace.
+    size_t read(TraceRecord* out, size_t max);
+
+private:
+    std::FILE* file_ = nullptr;
+};
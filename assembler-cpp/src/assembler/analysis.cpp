@@ -0,0 +1,109 @@
+#include "assembler/analysis.h"
+#include "assembler/operands.h"
+#include <algorithm>
+
+bool analyzeInstr(const AsmInstr& ins, InstrFacts& f){
+  f = InstrFacts{};
+  const auto& a = ins.args;
+  auto regs = [&](size_t n, uint8_t* r){
+    for (size_t k = 0; k < n; ++k) if (!parseRegX(a[k], r[k])) return false;
+    return true;
+  };
+  auto targetOrImm = [&](std::string_view s){
+    int64_t v;
+    if (parseInt(s, v)) f.imm = (int32_t)v; else f.target = s;
+  };
+  std::string_view m = ins.mnemonic;
+  uint8_t r[3];
+  if (ieq(m, "ADD") || ieq(m, "SUB")){
+    if (a.size() != 3 || !regs(3, r)) return false;
+    f.tag = ieq(m, "ADD") ? TAG_ADD : TAG_SUB;
+    f.rd = r[0]; f.rs1 = r[1]; f.rs2 = r[2];
+  } else if (ieq(m, "ADDI") || ieq(m, "JALR")){
+    int64_t v;
+    if (a.size() != 3 || !regs(2, r) || !parseInt(a[2], v)) return false;
+    f.tag = ieq(m, "ADDI") ? TAG_ADDI : TAG_JALR;
+    f.rd = r[0]; f.rs1 = r[1]; f.imm = (int32_t)v;
+  } else if (ieq(m, "LW") || ieq(m, "SW")){
+    if (a.size() != 2 || !regs(1, r) || !parseMemOp(a[1], f.imm, f.rs1)) return false;
+    if (ieq(m, "LW")) { f.tag = TAG_LW; f.rd = r[0]; }
+    else              { f.tag = TAG_SW; f.rs2 = r[0]; }
+  } else if (ieq(m, "BEQ") || ieq(m, "BNE")){
+    if (a.size() != 3 || !regs(2, r)) return false;
+    f.tag = ieq(m, "BEQ") ? TAG_BEQ : TAG_BNE;
+    f.rs1 = r[0]; f.rs2 = r[1];
+    targetOrImm(a[2]);
+  } else if (ieq(m, "LUI") || ieq(m, "AUIPC")){
+    int64_t v;
+    if (a.size() != 2 || !regs(1, r) || !parseInt(a[1], v)) return false;
+    f.tag = ieq(m, "LUI") ? TAG_LUI : TAG_AUIPC;
+    f.rd = r[0]; f.imm = (int32_t)v;
+  } else if (ieq(m, "JAL")){
+    if (a.size() != 2 || !regs(1, r)) return false;
+    f.tag = TAG_JAL; f.rd = r[0];
+    targetOrImm(a[1]);
+  } else if (ieq(m, "LA")){
+    // Address of a label: to the passes here just a constant definition of rd.
+    if (a.size() != 2 || !regs(1, r)) return false;
+    f.tag = TAG_LUI; f.rd = r[0];
+    targetOrImm(a[1]);
+  } else {
+    return false;
+  }
+  f.defs = regBit(f.rd);
+  switch (f.tag){
+    case TAG_ADD: case TAG_SUB: case TAG_SW: case TAG_BEQ: case TAG_BNE:
+      f.uses = regBit(f.rs1) | regBit(f.rs2); break;
+    case TAG_ADDI: case TAG_JALR: case TAG_LW:
+      f.uses = regBit(f.rs1); break;
+    default: break;
+  }
+  return true;
+}
+
+std::unordered_map<std::string_view, uint32_t> labelIndex(const Program& prog){
+  std::vector<LabelDef> labels(prog.labels.begin(), prog.labels.end());
+  std::stable_sort(labels.begin(), labels.end(),
+                   [](const LabelDef& a, const LabelDef& b){ return a.line < b.line; });
+  std::unordered_map<std::string_view, uint32_t> at;
+  at.reserve(labels.size());
+  size_t li = 0;
+  for (uint32_t i = 0; i < prog.instrs.size(); ++i)
+    for (; li < labels.size() && labels[li].line <= prog.instrs[i].line; ++li)
+      at.emplace(labels[li].name, i);
+  for (; li < labels.size(); ++li) at.emplace(labels[li].name, (uint32_t)prog.instrs.size());
+  return at;
+}
+
+Cfg buildCfg(const Program& prog, const std::vector<InstrFacts>& facts){
+  const uint32_t n = (uint32_t)prog.instrs.size();
+  auto labels = labelIndex(prog);
+
+  std::vector<uint8_t> leader(n + 1, 0);
+  leader[0] = 1;
+  for (const auto& l : labels) leader[l.second] = 1;
+  for (uint32_t i = 0; i < n; ++i) if (endsBlock(facts[i].tag)) leader[i + 1] = 1;
+
+  Cfg g;
+  std::vector<uint32_t> blockOf(n + 1, Cfg::kExit);
+  for (uint32_t i = 0; i < n; ++i){
+    if (leader[i]) g.start.push_back(i);
+    blockOf[i] = (uint32_t)g.start.size() - 1;
+  }
+  g.start.push_back(n);
+
+  const size_t nb = g.blocks();
+  g.fall.assign(nb, Cfg::kNone);
+  g.taken.assign(nb, Cfg::kNone);
+  for (size_t b = 0; b < nb; ++b){
+    uint32_t last = g.start[b + 1] - 1;
+    const InstrFacts& f = facts[last];
+    if (f.tag != TAG_JAL && f.tag != TAG_JALR) g.fall[b] = blockOf[last + 1];
+    if (f.tag == TAG_JALR) { g.taken[b] = Cfg::kExit; continue; }
+    if (!isBranch(f.tag) && f.tag != TAG_JAL) continue;
+    auto it = f.target.empty() ? labels.end() : labels.find(f.target);
+    if (it == labels.end() || (f.tag == TAG_JAL && it->second == last)) g.taken[b] = Cfg::kExit;
+    else g.taken[b] = blockOf[it->second];
+  }
+  return g;
+}
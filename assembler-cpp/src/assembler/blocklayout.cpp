@@ -0,0 +1,246 @@
+#include "assembler/blocklayout.h"
+#include "assembler/analysis.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <unordered_map>
+
+bool readLayoutProfile(const std::string& path, LayoutProfile& profile, std::string& err){
+  std::ifstream f(path);
+  if (!f) { err = "cannot read " + path; return false; }
+  profile.entries.clear();
+  std::string text, word;
+  for (unsigned line = 1; std::getline(f, text); ++line){
+    size_t hash = text.find('#');
+    if (hash != std::string::npos) text.resize(hash);
+    std::istringstream in(text);
+    std::vector<std::string> w;
+    while (in >> word) w.push_back(word);
+    if (w.empty()) continue;
+    LayoutProfile::Entry e;
+    if (w.size() == 2) { e.from = w[0]; }
+    else if (w.size() == 4 && w[1] == "->") { e.from = w[0]; e.to = w[2]; }
+    else { err = path + ":" + std::to_string(line) + ": expected KEY COUNT or KEY -> KEY COUNT"; return false; }
+    const std::string& c = w.back();
+    char* end = nullptr;
+    e.count = std::strtoull(c.c_str(), &end, 10);
+    if (!std::isdigit((unsigned char)c[0]) || *end) {
+      err = path + ":" + std::to_string(line) + ": bad count " + c;
+      return false;
+    }
+    profile.entries.push_back(std::move(e));
+  }
+  return true;
+}
+
+namespace {
+
+// How a block ends, for layout: which successors it has and which one may fall through.
+enum class Exit : uint8_t {
+  Plain,  // falls into the next block
+  Branch, // BEQ/BNE: taken or falls through
+  Jump,   // JAL x0: taken only
+  Call,   // JAL/JALR with a link register: taken, and returns to the next block
+  Other,  // JALR x0 (return, computed jump): nowhere known
+};
+
+} // namespace
+
+LayoutStats layoutBlocks(Program& prog, std::vector<std::pair<std::string_view, uint32_t>>& labelAt,
+                         const LayoutProfile& profile){
+  LayoutStats st;
+  const uint32_t n = (uint32_t)prog.instrs.size();
+  std::vector<InstrFacts> facts(n);
+  for (uint32_t i = 0; i < n; ++i){
+    if (!analyzeInstr(prog.instrs[i], facts[i])) { st.skipped = "unrecognised instruction"; return st; }
+    const InstrFacts& f = facts[i];
+    if (f.tag == TAG_AUIPC || ((isBranch(f.tag) || f.tag == TAG_JAL) && f.target.empty())){
+      st.skipped = "position-dependent code (AUIPC or literal branch offset)";
+      return st;
+    }
+  }
+  if (n == 0) return st;
+
+  const Cfg g = buildCfg(prog, facts);
+  const uint32_t nb = (uint32_t)g.blocks(), kEnd = nb; // kEnd: falling off the end of the program
+  const uint32_t kNone = Cfg::kNone;
+  st.blocks = nb;
+  std::vector<uint32_t> blockOf(n);
+  for (uint32_t b = 0; b < nb; ++b)
+    for (uint32_t i = g.start[b]; i < g.start[b + 1]; ++i) blockOf[i] = b;
+
+  // Successors: taken is a block or kNone; fall is a block, kEnd or kNone.
+  std::vector<Exit> exit(nb);
+  std::vector<uint32_t> taken(nb, kNone), fall(nb, kNone);
+  for (uint32_t b = 0; b < nb; ++b){
+    const InstrFacts& f = facts[g.start[b + 1] - 1];
+    if (isBranch(f.tag)) exit[b] = Exit::Branch;
+    else if ((f.tag == TAG_JAL || f.tag == TAG_JALR) && f.rd) exit[b] = Exit::Call;
+    else if (f.tag == TAG_JAL) exit[b] = Exit::Jump;
+    else if (f.tag == TAG_JALR) exit[b] = Exit::Other;
+    else exit[b] = Exit::Plain;
+    if (exit[b] != Exit::Jump && exit[b] != Exit::Other) fall[b] = b + 1; // b + 1 == kEnd past the last
+    if (g.taken[b] < nb && f.tag != TAG_JALR) taken[b] = g.taken[b];
+  }
+
+  // Profile keys -> blocks.
+  std::unordered_map<std::string_view, uint32_t> byLabel;
+  for (const auto& l : labelAt) if (l.second < n) byLabel.emplace(l.first, blockOf[l.second]);
+  std::unordered_map<unsigned, uint32_t> byLine;
+  for (uint32_t i = 0; i < n; ++i) byLine.emplace(prog.instrs[i].line, blockOf[i]);
+  auto resolve = [&](const std::string& key, uint32_t& b){
+    auto parsed = [&](unsigned& line){
+      char* end = nullptr;
+      line = (unsigned)std::strtoul(key.c_str() + 1, &end, 10);
+      return key.size() > 1 && !*end;
+    };
+    unsigned line;
+    if (key[0] == '@' && parsed(line)){
+      auto it = byLine.find(line);
+      if (it != byLine.end()) { b = it->second; return true; }
+    } else {
+      auto it = byLabel.find(key);
+      if (it != byLabel.end()) { b = it->second; return true; }
+    }
+    ++st.unknownKeys;
+    return false;
+  };
+  std::vector<uint64_t> count(nb, 0), wTaken(nb, 0), wFall(nb, 0);
+  std::vector<uint8_t> takenGiven(nb, 0), fallGiven(nb, 0);
+  for (const LayoutProfile::Entry& e : profile.entries){
+    uint32_t from, to;
+    if (!resolve(e.from, from)) continue;
+    if (e.to.empty()) { count[from] = std::max(count[from], e.count); continue; }
+    if (!resolve(e.to, to)) continue;
+    // A relaxed far branch reports its skip over the long jump as taken; it is the fall edge.
+    if (to == taken[from]) { wTaken[from] += e.count; takenGiven[from] = 1; }
+    else if (to == fall[from]) { wFall[from] += e.count; fallGiven[from] = 1; }
+  }
+  for (uint32_t b = 0; b < nb; ++b){
+    if (!takenGiven[b] && (exit[b] == Exit::Jump || exit[b] == Exit::Call)) wTaken[b] = count[b];
+    if (!fallGiven[b] && fall[b] != kNone)
+      wFall[b] = exit[b] == Exit::Branch ? count[b] - std::min(count[b], wTaken[b]) : count[b];
+  }
+
+  // Taken transfers of a layout: branches whose fall-through side does not follow them,
+  // jumps that are kept or added.
+  auto takenCost = [&](const std::vector<uint32_t>& order){
+    uint64_t sum = 0;
+    for (uint32_t k = 0; k < nb; ++k){
+      const uint32_t b = order[k], next = k + 1 < nb ? order[k + 1] : kEnd;
+      switch (exit[b]){
+        case Exit::Branch:
+          sum += fall[b] == next ? wTaken[b] : taken[b] == next ? wFall[b] : wTaken[b] + wFall[b];
+          break;
+        case Exit::Jump: sum += taken[b] == next ? 0 : wTaken[b]; break;
+        case Exit::Call: sum += wTaken[b] + (fall[b] == next ? 0 : wFall[b]); break;
+        case Exit::Plain: sum += fall[b] == next ? 0 : wFall[b]; break;
+        case Exit::Other: break;
+      }
+    }
+    return sum;
+  };
+  std::vector<uint32_t> order(nb);
+  std::iota(order.begin(), order.end(), 0u);
+  st.takenBefore = st.takenAfter = takenCost(order);
+
+  // Chains: link edges heaviest first while both ends are free and no cycle forms. Untaken
+  // fall edges are linked too (last), so code without counts keeps its source order.
+  struct Edge { uint64_t w; uint32_t from, to; bool fall; };
+  std::vector<Edge> edges;
+  for (uint32_t b = 0; b < nb; ++b){
+    if (fall[b] < nb) edges.push_back({wFall[b], b, fall[b], true});
+    if (taken[b] != kNone && taken[b] != b && wTaken[b]) edges.push_back({wTaken[b], b, taken[b], false});
+  }
+  std::stable_sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b){
+    return a.w != b.w ? a.w > b.w : a.fall > b.fall;
+  });
+  std::vector<uint32_t> next(nb, kNone), prev(nb, kNone), head(nb);
+  std::iota(head.begin(), head.end(), 0u);
+  auto find = [&](uint32_t b){
+    while (head[b] != b) b = head[b] = head[head[b]];
+    return b;
+  };
+  for (const Edge& e : edges){
+    if (next[e.from] != kNone || prev[e.to] != kNone || e.to == 0 || find(e.from) == find(e.to)) continue;
+    next[e.from] = e.to;
+    prev[e.to] = e.from;
+    head[find(e.to)] = find(e.from);
+  }
+
+  // Chain order: the entry's, then hot chains by their hottest block, then cold ones.
+  struct Chain { uint32_t first; uint64_t heat; };
+  std::vector<Chain> chains;
+  for (uint32_t b = 0; b < nb; ++b){
+    if (prev[b] != kNone) continue;
+    uint64_t heat = 0;
+    for (uint32_t c = b; c != kNone; c = next[c]) heat = std::max(heat, count[c]);
+    chains.push_back({b, heat});
+  }
+  std::stable_sort(chains.begin() + 1, chains.end(), [](const Chain& a, const Chain& b){
+    return a.heat > b.heat;
+  });
+  order.clear();
+  for (const Chain& c : chains)
+    for (uint32_t b = c.first; b != kNone; b = next[b]) order.push_back(b);
+  st.takenAfter = takenCost(order);
+  if (st.takenAfter >= st.takenBefore) { st.takenAfter = st.takenBefore; return st; } // keep the source order
+
+  // Emit. Labels for blocks that are now jumped to but had none are added as we go.
+  Arena& arena = *prog.arena;
+  std::vector<std::string_view> nameAt(n + 1);
+  for (const auto& l : labelAt) if (nameAt[l.second].empty()) nameAt[l.second] = l.first;
+  auto labelOf = [&](uint32_t b){
+    uint32_t i = b == kEnd ? n : g.start[b];
+    if (nameAt[i].empty()){
+      nameAt[i] = arena.copy("@" + std::to_string(i));
+      labelAt.emplace_back(nameAt[i], i);
+    }
+    return nameAt[i];
+  };
+  ArenaVector<AsmInstr> out(arena);
+  out.reserve(n + nb / 4 + 4);
+  std::vector<uint32_t> newIndex(n + 1);
+  for (uint32_t k = 0; k < nb; ++k){
+    const uint32_t b = order[k], next = k + 1 < nb ? order[k + 1] : kEnd;
+    if (k && order[k - 1] != b - 1) ++st.moved;
+    const uint32_t last = g.start[b + 1] - 1;
+    for (uint32_t i = g.start[b]; i <= last; ++i){ newIndex[i] = (uint32_t)out.size(); if (i < last) out.push_back(prog.instrs[i]); }
+    const AsmInstr& ins = prog.instrs[last];
+    auto jumpTo = [&](uint32_t s){
+      out.push_back(makeInstr(arena, "JAL", {"x0", labelOf(s)}, ins.line));
+      ++st.jumpsAdded;
+    };
+    switch (exit[b]){
+      case Exit::Branch:
+        if (fall[b] == next) out.push_back(ins);
+        else if (taken[b] == next){
+          out.push_back(makeInstr(arena, facts[last].tag == TAG_BEQ ? "BNE" : "BEQ",
+                                  {ins.args[0], ins.args[1], labelOf(fall[b])}, ins.line));
+          ++st.inverted;
+        } else {
+          out.push_back(ins);
+          jumpTo(fall[b]);
+        }
+        break;
+      case Exit::Jump:
+        if (taken[b] == next) ++st.jumpsRemoved; // its labels now bind to the next block
+        else out.push_back(ins);
+        break;
+      case Exit::Plain: case Exit::Call:
+        out.push_back(ins);
+        if (fall[b] != next) jumpTo(fall[b]);
+        break;
+      case Exit::Other:
+        out.push_back(ins);
+        break;
+    }
+  }
+  newIndex[n] = (uint32_t)out.size();
+  for (auto& l : labelAt) l.second = newIndex[l.second];
+  prog.instrs = std::move(out);
+  return st;
+}
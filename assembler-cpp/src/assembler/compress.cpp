@@ -0,0 +1,120 @@
+#include "assembler/compress.h"
+
+// --- operand predicates ---
+static bool isPrime(uint8_t r) { return r >= 8 && r <= 15; } // x8..x15: 3-bit register fields
+static bool fitsS(int32_t v, int bits) { return v >= -(1 << (bits - 1)) && v < (1 << (bits - 1)); }
+static uint32_t b(uint32_t v, int n) { return (v >> n) & 1u; }
+
+// --- 16-bit packers, one per RVC format (field layouts from the C extension spec) ---
+static uint16_t ci(uint32_t f3, uint8_t rd, int32_t imm6, uint32_t op) {      // C.ADDI/C.LI/C.LUI
+  uint32_t u = (uint32_t)imm6;
+  return (uint16_t)((f3 << 13) | (b(u, 5) << 12) | ((uint32_t)rd << 7) | ((u & 0x1F) << 2) | op);
+}
+static uint16_t cr(uint32_t f4, uint8_t rd, uint8_t rs2) {                    // C.MV/C.ADD/C.JR/C.JALR
+  return (uint16_t)((f4 << 12) | ((uint32_t)rd << 7) | ((uint32_t)rs2 << 2) | 0x2u);
+}
+static uint16_t clsw(uint32_t f3, uint8_t rs1, uint8_t r, uint32_t off) {     // C.LW/C.SW: uimm[6:2]
+  return (uint16_t)((f3 << 13) | (((off >> 3) & 7u) << 10) | ((uint32_t)(rs1 - 8) << 7)
+                  | (b(off, 2) << 6) | (b(off, 6) << 5) | ((uint32_t)(r - 8) << 2));
+}
+static uint16_t cj(uint32_t f3, int32_t off) {                                // C.J/C.JAL
+  uint32_t u = (uint32_t)off;
+  return (uint16_t)((f3 << 13) | (b(u, 11) << 12) | (b(u, 4) << 11) | (((u >> 8) & 3u) << 9)
+                  | (b(u, 10) << 8) | (b(u, 6) << 7) | (b(u, 7) << 6) | (((u >> 1) & 7u) << 3)
+                  | (b(u, 5) << 2) | 0x1u);
+}
+static uint16_t cb(uint32_t f3, uint8_t rs1, int32_t off) {                   // C.BEQZ/C.BNEZ
+  uint32_t u = (uint32_t)off;
+  return (uint16_t)((f3 << 13) | (b(u, 8) << 12) | (((u >> 3) & 3u) << 10) | ((uint32_t)(rs1 - 8) << 7)
+                  | (((u >> 6) & 3u) << 5) | (((u >> 1) & 3u) << 3) | (b(u, 5) << 2) | 0x1u);
+}
+
+bool compressInstr(const DecodedInstr& di, uint16_t& out) {
+  const uint8_t rd = di.rd, rs1 = di.rs1, rs2 = di.rs2;
+  const int32_t imm = di.imm;
+  switch (di.tag) {
+  case TAG_ADDI:
+    if (rd == 0 && rs1 == 0 && imm == 0) { out = 0x0001; return true; }           // C.NOP
+    if (rd == 0) return false;
+    if (rd == rs1 && imm != 0 && fitsS(imm, 6)) { out = ci(0, rd, imm, 1); return true; } // C.ADDI
+    if (rs1 == 0 && fitsS(imm, 6)) { out = ci(2, rd, imm, 1); return true; }              // C.LI
+    if (rd == 2 && rs1 == 2 && imm != 0 && (imm & 0xF) == 0 && fitsS(imm, 10)) {          // C.ADDI16SP
+      uint32_t u = (uint32_t)imm;
+      out = (uint16_t)((3u << 13) | (b(u, 9) << 12) | (2u << 7) | (b(u, 4) << 6) | (b(u, 6) << 5)
+                     | (((u >> 7) & 3u) << 3) | (b(u, 5) << 2) | 0x1u);
+      return true;
+    }
+    if (isPrime(rd) && rs1 == 2 && imm > 0 && imm <= 1020 && (imm & 3) == 0) {          // C.ADDI4SPN
+      uint32_t u = (uint32_t)imm;
+      out = (uint16_t)((((u >> 4) & 3u) << 11) | (((u >> 6) & 0xFu) << 7) | (b(u, 2) << 6)
+                     | (b(u, 3) << 5) | ((uint32_t)(rd - 8) << 2));
+      return true;
+    }
+    if (rs1 != 0 && imm == 0) { out = cr(0x8, rd, rs1); return true; }                 // C.MV
+    return false;
+
+  case TAG_ADD:
+    if (rd == 0) return false;
+    if (rs1 == 0 && rs2 != 0) { out = cr(0x8, rd, rs2); return true; }                 // C.MV
+    if (rs2 == 0 && rs1 != 0) { out = cr(0x8, rd, rs1); return true; }                 // C.MV
+    if (rd == rs1 && rs2 != 0) { out = cr(0x9, rd, rs2); return true; }                 // C.ADD
+    if (rd == rs2 && rs1 != 0) { out = cr(0x9, rd, rs1); return true; }                 // C.ADD
+    return false;
+
+  case TAG_SUB:                                                                          // C.SUB
+    if (isPrime(rd) && rd == rs1 && isPrime(rs2)) {
+      out = (uint16_t)((4u << 13) | (3u << 10) | ((uint32_t)(rd - 8) << 7) | ((uint32_t)(rs2 - 8) << 2) | 0x1u);
+      return true;
+    }
+    return false;
+
+  case TAG_LW:
+    if (imm < 0 || (imm & 3) != 0) return false;
+    if (rs1 == 2 && rd != 0 && imm <= 252) {                                             // C.LWSP
+      uint32_t u = (uint32_t)imm;
+      out = (uint16_t)((2u << 13) | (b(u, 5) << 12) | ((uint32_t)rd << 7) | (((u >> 2) & 7u) << 4)
+                     | (((u >> 6) & 3u) << 2) | 0x2u);
+      return true;
+    }
+    if (isPrime(rd) && isPrime(rs1) && imm <= 124) { out = clsw(2, rs1, rd, (uint32_t)imm); return true; } // C.LW
+    return false;
+
+  case TAG_SW:
+    if (imm < 0 || (imm & 3) != 0) return false;
+    if (rs1 == 2 && imm <= 252) {                                                        // C.SWSP
+      uint32_t u = (uint32_t)imm;
+      out = (uint16_t)((6u << 13) | (((u >> 2) & 0xFu) << 9) | (((u >> 6) & 3u) << 7)
+                     | ((uint32_t)rs2 << 2) | 0x2u);
+      return true;
+    }
+    if (isPrime(rs2) && isPrime(rs1) && imm <= 124) { out = clsw(6, rs1, rs2, (uint32_t)imm); return true; } // C.SW
+    return false;
+
+  case TAG_LUI: {                                                                        // C.LUI
+    int32_t hi = imm >> 12;
+    if (rd == 0 || rd == 2 || hi == 0 || !fitsS(hi, 6)) return false;
+    out = ci(3, rd, hi, 1);
+    return true;
+  }
+
+  case TAG_JAL:                                                                          // C.J / C.JAL
+    if ((rd != 0 && rd != 1) || (imm & 1) || !fitsS(imm, 12)) return false;
+    out = cj(rd == 0 ? 5 : 1, imm);
+    return true;
+
+  case TAG_JALR:                                                                         // C.JR / C.JALR
+    if (imm != 0 || rs1 == 0 || (rd != 0 && rd != 1)) return false;
+    out = cr(rd == 0 ? 0x8 : 0x9, rs1, 0);
+    return true;
+
+  case TAG_BEQ: case TAG_BNE: {                                                         // C.BEQZ / C.BNEZ
+    uint8_t r = rs2 == 0 ? rs1 : (rs1 == 0 ? rs2 : 0);
+    if (!isPrime(r) || (imm & 1) || !fitsS(imm, 9)) return false;
+    out = cb(di.tag == TAG_BEQ ? 6 : 7, r, imm);
+    return true;
+  }
+
+  default:
+    return false;
+  }
+}
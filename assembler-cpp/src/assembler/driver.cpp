@@ -3,40 +3,118 @@
 #include "assembler/parser.h"
 #include "assembler/encode.h"
 #include "assembler/symbols.h"
+#include "decoder/decoder.h"
+#include "common/linemap.h"
 #include "common/utils.h"
 #include <iostream>
 #include <fstream>
 #include <iomanip>
 
 int assembleFile(const std::string& inPath, const std::string& outPath, bool hex) {
+  Arena arena;
+  return assembleFile(inPath, outPath, hex, arena);
+}
+
+int assembleFile(const std::string& inPath, const std::string& outPath, bool hex, Arena& arena) {
+  AsmOptions opts;
+  opts.hex = hex;
+  return assembleFile(inPath, outPath, opts, arena);
+}
+
+int assembleFile(const std::string& inPath, const std::string& outPath, const AsmOptions& opts, Arena& arena) {
+  arena.reset(); // the previous job's IR is dropped in one step; its chunks are reused
   auto src = readFileToString(inPath);
   if (src.empty()) { std::cerr << "Empty or unreadable input.\n"; return 1; }
 
-  Lexer lx(src); lx.tokenize();
-  Parser ps(lx.tokenize());
+  std::vector<Token> toks;
+  {
+    Lexer lx(src);
+    toks = lx.tokenize();
+  }
+  Parser ps(toks, arena);
   Program prog = ps.parse();
-  if (!ps.errors().empty()){
-    for (auto& e: ps.errors()) std::cerr << e << "\n";
-    return 2;
+  for (auto& e: ps.errors()) std::cerr << e << "\n";
+
+  LayoutProfile profile;
+  if (!opts.layoutProfile.empty()) {
+    std::string err;
+    if (!readLayoutProfile(opts.layoutProfile, profile, err)) { std::cerr << "--layout-profile: " << err << "\n"; return 1; }
   }
 
+  // Encode even after parse errors so one run reports every diagnostic.
   SymbolTable syms;
-  Encoder enc(prog, syms);
-  std::vector<uint32_t> words;
-  try {
-    words = enc.assemble();
-  } catch (const std::exception& ex){
-    std::cerr << "assemble error: " << ex.what() << "\n";
+  EncoderOptions eo;
+  eo.compress = opts.compress;
+  eo.optimize = opts.optimize && ps.errors().empty();
+  eo.schedule = opts.schedule && ps.errors().empty();
+  eo.latency.load = opts.loadLatency;
+  eo.scratch = opts.scratch;
+  if (!opts.layoutProfile.empty() && ps.errors().empty()) eo.profile = &profile;
+  Encoder enc(prog, syms, eo);
+  std::vector<uint8_t> image = enc.assemble();
+  if (eo.optimize) {
+    const PeepholeStats& st = enc.peepholeStats();
+    if (st.skipped) {
+      std::cerr << "peephole: skipped: " << st.skipped << "\n";
+    } else {
+      std::cerr << "peephole:";
+      for (int r = 0; r < PeepholeStats::kRules; ++r)
+        std::cerr << (r ? ", " : " ") << peepholeRuleName(r) << " " << st.hits[r];
+      std::cerr << "; " << st.before << " -> " << st.after << " instructions\n";
+    }
+  }
+  if (eo.schedule) {
+    const ScheduleStats& st = enc.scheduleStats();
+    if (st.skipped) std::cerr << "sched: skipped: " << st.skipped << "\n";
+    else std::cerr << "sched: " << st.reordered << "/" << st.blocks << " blocks reordered, est. stalls "
+                   << st.stallsBefore << " -> " << st.stallsAfter << " (load latency "
+                   << eo.latency.load << ")\n";
+  }
+  if (eo.profile) {
+    const LayoutStats& st = enc.layoutStats();
+    if (st.skipped) std::cerr << "layout: skipped: " << st.skipped << "\n";
+    else std::cerr << "layout: " << st.moved << "/" << st.blocks << " blocks moved, " << st.inverted
+                   << " branches inverted, jumps +" << st.jumpsAdded << " -" << st.jumpsRemoved
+                   << ", est. taken transfers " << st.takenBefore << " -> " << st.takenAfter
+                   << (st.unknownKeys ? ", " + std::to_string(st.unknownKeys) + " unknown profile keys" : std::string())
+                   << "\n";
+  }
+  for (auto& e: enc.errors()) std::cerr << e << "\n";
+  if (!ps.errors().empty()) return 2;
+  if (!enc.errors().empty()){
+    std::cerr << enc.errors().size() << " error(s); no output written\n";
     return 3;
   }
+  if (opts.compress) {
+    const EncodeStats& st = enc.stats();
+    double pct = st.bytesFull ? 100.0 * (st.bytesFull - st.bytes) / st.bytesFull : 0.0;
+    std::cerr << "rvc: " << st.compressed << "/" << st.instrs << " instructions compressed, "
+              << st.bytesFull << " -> " << st.bytes << " bytes (-"
+              << std::fixed << std::setprecision(1) << pct << "%)\n";
+  }
+
+  if (!opts.mapPath.empty()) {
+    LineMap map;
+    map.source = inPath;
+    const Program& p = enc.program();
+    for (size_t i = 0; i < p.instrs.size(); ++i)
+      if (map.runs.empty() || map.runs.back().second != p.instrs[i].line)
+        map.runs.emplace_back(enc.pcs()[i], p.instrs[i].line);
+    if (!writeLineMap(opts.mapPath, map)) return 4;
+  }
 
-  if (!hex) {
-    if (!writeBinaryWords(outPath, words)) return 4;
+  if (!opts.hex) {
+    if (!writeBinaryFile(outPath, image)) return 4;
   } else {
     std::ofstream f(outPath);
     if (!f) { std::cerr << "open fail: " << outPath << "\n"; return 4; }
-    for (uint32_t w : words) {
-      f << std::hex << std::setw(8) << std::setfill('0') << w << "\n";
+    // One instruction per line: 8 hex digits for a 32-bit word, 4 for an RVC parcel.
+    for (size_t i = 0; i + 1 < image.size(); ) {
+      uint32_t w = (uint32_t)image[i] | ((uint32_t)image[i+1] << 8);
+      unsigned len = instrLength((uint16_t)w);
+      if (len == 4) w |= ((uint32_t)image[i+2] << 16) | ((uint32_t)image[i+3] << 24);
+      f << std::hex << std::setw(len * 2) << std::setfill('0') << w << "\n";
+      i += len;
     }
   }
   return 0;
@@ -1,254 +1,385 @@
 #include "assembler/encode.h"
+#include "assembler/analysis.h"
+#include "assembler/compress.h"
+#include "assembler/packers.h"
+#include "assembler/operands.h"
+#include "assembler/pseudo.h"
+#include "decoder/decoder.h"
 #include "common/utils.h"
 #include <cstdint>
-#include <stdexcept>
-#include <regex>
 #include <algorithm>  // sort
 
-// --- tiny helpers (defensively masked) ---
-static uint32_t rtype(uint8_t f7, uint8_t rs2, uint8_t rs1, uint8_t f3, uint8_t rd, uint8_t op){
-  return (((uint32_t)f7  & 0x7Fu) << 25)
-       | (((uint32_t)rs2 & 0x1Fu) << 20)
-       | (((uint32_t)rs1 & 0x1Fu) << 15)
-       | (((uint32_t)f3  & 0x07u) << 12)
-       | (((uint32_t)rd  & 0x1Fu) << 7)
-       |  ((uint32_t)op  & 0x7Fu);
-}
-static uint32_t itype(int32_t imm, uint8_t rs1, uint8_t f3, uint8_t rd, uint8_t op){
-  uint32_t u = (uint32_t)imm;
-  return ((u & 0xFFFu) << 20)
-       | (((uint32_t)rs1 & 0x1Fu) << 15)
-       | (((uint32_t)f3  & 0x07u) << 12)
-       | (((uint32_t)rd  & 0x1Fu) << 7)
-       |  ((uint32_t)op  & 0x7Fu);
-}
-static uint32_t stype(int32_t imm, uint8_t rs2, uint8_t rs1, uint8_t f3, uint8_t op){
-  uint32_t u = (uint32_t)imm;
-  uint32_t i11_5 = (u >> 5) & 0x7Fu;
-  uint32_t i4_0  =  u       & 0x1Fu;
-  return (i11_5 << 25)
-       | (((uint32_t)rs2 & 0x1Fu) << 20)
-       | (((uint32_t)rs1 & 0x1Fu) << 15)
-       | (((uint32_t)f3  & 0x07u) << 12)
-       | (i4_0 << 7)
-       | ((uint32_t)op & 0x7Fu);
-}
-static uint32_t btype(int32_t imm, uint8_t rs2, uint8_t rs1, uint8_t f3, uint8_t op){
-  uint32_t u    = (uint32_t)imm;
-  uint32_t b12  = (u >> 12) & 0x1u;
-  uint32_t b10_5= (u >>  5) & 0x3Fu;
-  uint32_t b4_1 = (u >>  1) & 0x0Fu;
-  uint32_t b11  = (u >> 11) & 0x1u;
-  return (b12 << 31)
-       | (b10_5 << 25)
-       | (((uint32_t)rs2 & 0x1Fu) << 20)
-       | (((uint32_t)rs1 & 0x1Fu) << 15)
-       | (((uint32_t)f3  & 0x07u) << 12)
-       | (b4_1 << 8)
-       | (b11 << 7)
-       | ((uint32_t)op & 0x7Fu);
-}
-static uint32_t utype(int32_t imm20, uint8_t rd, uint8_t op){
-  return (((uint32_t)imm20 & 0xFFFFFu) << 12)
-       | (((uint32_t)rd    & 0x1Fu)    << 7)
-       |  ((uint32_t)op    & 0x7Fu);
-}
-static uint32_t jtype(int32_t imm, uint8_t rd, uint8_t op){
-  uint32_t u     = (uint32_t)imm;
-  uint32_t j20   = (u >> 20) & 0x1u;
-  uint32_t j10_1 = (u >>  1) & 0x3FFu;
-  uint32_t j11   = (u >> 11) & 0x1u;
-  uint32_t j19_12= (u >> 12) & 0xFFu;
-  return (j20 << 31)
-       | (j19_12 << 12)
-       | (j11 << 20)
-       | (j10_1 << 21)
-       | (((uint32_t)rd & 0x1Fu) << 7)
-       | ((uint32_t)op & 0x7Fu);
-}
+using namespace rv::pack; // rtype/itype/stype/btype/utype/jtype
 
-// --- parsing helpers ---
-static bool isNumber(const std::string& s){
-  if (s.empty()) return false;
-  size_t i = 0;
-  if (s[i] == '+' || s[i] == '-') ++i;
-  if (i + 2 <= s.size() && s[i] == '0' && (s[i+1]=='x' || s[i+1]=='X')) {
-    for (size_t j = i + 2; j < s.size(); ++j)
-      if (!std::isxdigit((unsigned char)s[j])) return false;
-    return true;
-  }
-  for (; i < s.size(); ++i)
-    if (!std::isdigit((unsigned char)s[i])) return false;
-  return true;
-}
-static int64_t parseInt(const std::string& s){
-  // std::stoll handles +/- sign; choose base by prefix (ignoring sign)
-  size_t i = (s.size() && (s[0]=='+' || s[0]=='-')) ? 1 : 0;
-  int base = (i + 2 <= s.size() && s[i]=='0' && (s[i+1]=='x' || s[i+1]=='X')) ? 16 : 10;
-  return std::stoll(s, nullptr, base);
-}
-static bool parseRegX(const std::string& s, uint8_t& out){
-  if (s.size() < 2 || s[0] != 'x') return false;
-  for (size_t i = 1; i < s.size(); ++i)
-    if (!std::isdigit((unsigned char)s[i])) return false;
-  long v = std::stol(s.substr(1));
-  if (v < 0 || v > 31) return false;
-  out = (uint8_t)v; return true;
-}
-static bool parseMemOp(const std::string& s, int32_t& off, uint8_t& rs1){
-  // forms: imm(rs1)  e.g., 0(x10)  -8(x2)  +0x40(x3)
-  std::regex re(R"(^\s*([+-]?(?:0x[0-9a-fA-F]+|\d+))\s*\(\s*x(\d+)\s*\)\s*$)");
-  std::smatch m; if(!std::regex_match(s, m, re)) return false;
-  off = (int32_t)parseInt(m[1].str());
-  long r = std::stol(m[2].str());
-  if (r < 0 || r > 31) return false;
-  rs1 = (uint8_t)r; return true;
+const char* encStatusStr(EncStatus st){
+  switch (st){
+    case EncStatus::Ok:              return "ok";
+    case EncStatus::OperandCount:    return "operand count mismatch";
+    case EncStatus::ExpectedReg:     return "expected register";
+    case EncStatus::ExpectedImm:     return "expected immediate";
+    case EncStatus::BadMemOperand:   return "expected off(rs1)";
+    case EncStatus::ImmOutOfRange:   return "immediate out of range";
+    case EncStatus::Misaligned:      return "target misaligned";
+    case EncStatus::UndefinedSymbol: return "undefined symbol";
+    case EncStatus::UnknownMnemonic: return "unknown mnemonic";
+    case EncStatus::ScratchInUse:    return "far jump would clobber a register in use";
+  }
+  return "unknown";
 }
 
 // --- encoder orchestration ---
-Encoder::Encoder(Program& p, SymbolTable& s):prog_(p),sym_(s){}
+Encoder::Encoder(Program& p, SymbolTable& s, EncoderOptions o):prog_(p),sym_(s),opts_(o){}
 
-std::vector<uint32_t> Encoder::assemble() {
-  // --- Pass 1: assign PCs and define labels (labels on label-only lines bind to next instr PC) ---
-  pcs_.clear();
-  pcs_.reserve(prog_.instrs.size());
+std::vector<uint8_t> Encoder::assemble() {
+  layout();
+  return encode();
+}
 
-  // Sort labels by source line; we’ll consume them as we reach each instruction line.
-  std::vector<LabelDef> labels = prog_.labels;
-  std::sort(labels.begin(), labels.end(),
-            [](const LabelDef& a, const LabelDef& b){ return a.line < b.line; });
+void Encoder::layout() {
+  // Pseudos become base instructions first so every later pass (and -O) sees real code.
+  expandPseudos(prog_);
+  if (opts_.optimize) peep_ = peephole(prog_);
+  if (opts_.schedule) sched_ = schedule(prog_, opts_.latency);
+
+  // --- Pass 1: bind labels to instruction indices (labels on label-only lines bind to the next instr) ---
+  labelAt_.clear();
+
+  // Labels by source line; we’ll consume them as we reach each instruction line.
+  // The parser emits them in order, so only passes that reorder code pay for the sort.
+  auto byLine = [](const LabelDef& a, const LabelDef& b){ return a.line < b.line; };
+  std::vector<LabelDef> sorted;
+  const LabelDef* labels = prog_.labels.data();
+  size_t labelCount = prog_.labels.size();
+  if (!std::is_sorted(prog_.labels.begin(), prog_.labels.end(), byLine)) {
+    sorted.assign(prog_.labels.begin(), prog_.labels.end());
+    std::stable_sort(sorted.begin(), sorted.end(), byLine);
+    labels = sorted.data();
+  }
 
-  uint32_t pc = 0;
   size_t li = 0; // label index
+  auto bind = [&](uint32_t idx){
+    // First definition wins; later duplicates are ignored as before.
+    if (!sym_.isDefined(labels[li].name)) {
+      sym_.define(labels[li].name, 0);
+      labelAt_.emplace_back(labels[li].name, idx);
+    }
+    ++li;
+  };
+  for (uint32_t i = 0; i < prog_.instrs.size(); ++i){
+    while (li < labelCount && labels[li].line <= prog_.instrs[i].line) bind(i);
+  }
+  // Any remaining labels (at EOF or after the last instruction) bind to the final pc.
+  while (li < labelCount) bind((uint32_t)prog_.instrs.size());
+
+  // Blocks move after binding: labels follow their instructions through labelAt_, and the
+  // relaxation below re-checks every branch range in the new order.
+  if (opts_.profile) layout_ = layoutBlocks(prog_, labelAt_, *opts_.profile);
+
+  // LA is always AUIPC+ADDI; everything else starts as one word.
+  sizes_.resize(prog_.instrs.size());
+  for (size_t i = 0; i < sizes_.size(); ++i)
+    sizes_[i] = ieq(prog_.instrs[i].mnemonic, "LA") && prog_.instrs[i].args.size() == 2 ? 8 : 4;
+  scratchUsed_ = -1;
+  place();
+  relaxPass();
+  if (opts_.compress) compressPass();
+}
 
-  for (const auto& ins : prog_.instrs){
-    // Define any labels whose line is <= this instruction's line and not yet defined.
-    while (li < labels.size() && labels[li].line <= ins.line) {
-      if (!sym_.isDefined(labels[li].name))
-        sym_.define(labels[li].name, pc);
-      ++li;
+void Encoder::place() {
+  pcs_.resize(sizes_.size() + 1);
+  uint32_t pc = 0;
+  for (size_t i = 0; i < sizes_.size(); ++i){ pcs_[i] = pc; pc += sizes_[i]; }
+  pcs_[sizes_.size()] = pc;
+  for (auto& l : labelAt_) sym_.define(l.first, pcs_[l.second]);
+}
+
+EncStatus Encoder::encodeAt(size_t i, unsigned size, uint32_t out[3]) {
+  return size == 4 ? encodeInstr(prog_.instrs[i], pcs_[i], out[0])
+                   : encodeLong(prog_.instrs[i], pcs_[i], size, out);
+}
+
+void Encoder::relaxPass() {
+  // Every branch starts in its short form and only grows, one word at a time (JAL: 4 -> 8,
+  // BEQ/BNE: 4 -> 8 -> 12). Growing can only push other targets further away, so sizes
+  // increase monotonically and the first fixed point is the smallest layout: near branches
+  // keep their single word. Only symbolic targets are relaxed; an out-of-range literal
+  // offset stays an error.
+  std::vector<uint32_t> cand;
+  for (size_t i = 0; i < prog_.instrs.size(); ++i){
+    const AsmInstr& ins = prog_.instrs[i];
+    int64_t x;
+    if ((ieq(ins.mnemonic, "BEQ") || ieq(ins.mnemonic, "BNE") || ieq(ins.mnemonic, "JAL"))
+        && !ins.args.empty() && !parseInt(ins.args[ins.args.size() - 1], x))
+      cand.push_back((uint32_t)i);
+  }
+  bool changed = true;
+  while (changed){
+    changed = false;
+    size_t keep = 0;
+    for (uint32_t i : cand){
+      uint32_t w[3];
+      const std::string_view m = prog_.instrs[i].mnemonic;
+      unsigned maxSize = ieq(m, "JAL") ? 8 : 12;
+      if (encodeAt(i, sizes_[i], w) == EncStatus::ImmOutOfRange) { sizes_[i] += 4; changed = true; }
+      if (sizes_[i] < maxSize) cand[keep++] = i;
     }
-    pcs_.push_back(pc);
-    pc += 4; // RV32I fixed 4-byte instructions
+    cand.resize(keep);
+    if (changed) place();
   }
+}
 
-  // Any remaining labels (at EOF or after the last instruction) bind to final pc.
-  while (li < labels.size()) {
-    if (!sym_.isDefined(labels[li].name))
-      sym_.define(labels[li].name, pc);
-    ++li;
+// RVC form of instruction i at its current PC, if it has one.
+bool Encoder::compressAt(size_t i, uint16_t& out) {
+  uint32_t w; DecodedInstr di;
+  return encodeInstr(prog_.instrs[i], pcs_[i], w) == EncStatus::Ok
+      && decodeInstr(w, di) && compressInstr(di, out);
+}
+
+void Encoder::compressPass() {
+  // Only branches depend on layout (LA too, but it has no shorter PC-relative form and keeps
+  // its two words). Everything else is compressed once, up front; branches are retried as
+  // the code around them shrinks. Sizes only ever shrink (relaxed sequences
+  // back toward one word, words to RVC parcels), so every span between two PCs only gets
+  // shorter: a form that fits once keeps fitting, and the loop reaches a fixed point.
+  std::vector<uint32_t> pending;
+  uint16_t c;
+  for (size_t i = 0; i < prog_.instrs.size(); ++i){
+    uint32_t w; DecodedInstr di;
+    if (sizes_[i] > 4) {
+      if (!ieq(prog_.instrs[i].mnemonic, "LA")) pending.push_back((uint32_t)i);
+      continue;
+    }
+    if (encodeInstr(prog_.instrs[i], pcs_[i], w) != EncStatus::Ok || !decodeInstr(w, di)) continue;
+    if (di.tag == TAG_BEQ || di.tag == TAG_BNE || di.tag == TAG_JAL) pending.push_back((uint32_t)i);
+    else if (compressInstr(di, c)) sizes_[i] = 2;
+  }
+  bool changed = true;
+  while (changed){
+    place();
+    changed = false;
+    size_t keep = 0;
+    for (uint32_t i : pending){
+      uint32_t w[3];
+      if (sizes_[i] > 4) {
+        if (encodeAt(i, sizes_[i] - 4u, w) == EncStatus::Ok) { sizes_[i] -= 4; changed = true; }
+        pending[keep++] = i;
+      } else if (compressAt(i, c)) {
+        sizes_[i] = 2; changed = true;
+      } else {
+        pending[keep++] = i;
+      }
+    }
+    pending.resize(keep);
   }
+}
 
+std::vector<uint8_t> Encoder::encode() {
   // --- Pass 2: encode ---
-  std::vector<uint32_t> out;
-  out.reserve(prog_.instrs.size());
+  // A bad instruction is recorded and encoded as 0 so later PCs stay put; encoding carries on
+  // and every diagnostic is available from errors() after a single run.
+  errs_.clear();
+  stats_ = EncodeStats{};
+  stats_.instrs = prog_.instrs.size();
+  std::vector<uint8_t> out;
+  out.reserve(pcs_.empty() ? 0 : pcs_.back());
   for (size_t i = 0; i < prog_.instrs.size(); ++i){
-    uint32_t w = encodeInstr(prog_.instrs[i], pcs_[i]);
-    out.push_back(w);
+    const AsmInstr& ins = prog_.instrs[i];
+    unsigned size = sizes_[i];
+    uint32_t w[3] = {0, 0, 0};
+    EncStatus st = encodeAt(i, size == 2 ? 4 : size, w);
+    if (st != EncStatus::Ok){
+      std::string msg = "encode error (line " + std::to_string(ins.line) + "): ";
+      msg.append(ins.mnemonic);
+      msg += ": "; msg += encStatusStr(st);
+      if (!errDetail_.empty()) msg += " (" + errDetail_ + ")";
+      errs_.push_back(std::move(msg));
+      w[0] = w[1] = w[2] = 0;
+    }
+    if (size == 2) {
+      // layout() only shrinks an instruction whose RVC form fits at its final PC.
+      uint16_t c = 0;
+      compressAt(i, c);
+      out.push_back((uint8_t)c); out.push_back((uint8_t)(c >> 8));
+      ++stats_.compressed;
+    } else {
+      for (unsigned j = 0; j < size / 4; ++j)
+        for (int k = 0; k < 4; ++k) out.push_back((uint8_t)(w[j] >> (8 * k)));
+    }
   }
+  stats_.bytes = (uint32_t)out.size();
+  stats_.bytesFull = (uint32_t)(4 * prog_.instrs.size());
   return out;
 }
 
-uint32_t Encoder::encodeInstr(const AsmInstr& ins, uint32_t pc){
-  auto M = ins.mnemonic;
+const std::vector<std::string>& Encoder::errors() const {
+  return errs_;
+}
+
+// Long forms for symbolic BEQ/BNE/JAL whose target is out of reach of the short one, and LA,
+// which always takes its long form so the image runs wherever it is loaded:
+//   JAL rd, L        8: AUIPC s, hi ; JALR rd, s, lo              s = rd, or x6 when rd is x0
+//   LA rd, L         8: AUIPC rd, hi ; ADDI rd, rd, lo
+//   BEQ a, b, L      8: BNE a, b, +8  ; JAL x0, L                 (BNE: BEQ around the jump)
+//                   12: BNE a, b, +12 ; AUIPC x6, hi ; JALR x0, x6, lo
+// AUIPC+JALR reaches +-2 GiB. x6 (t1) is the scratch register the RISC-V psABI sets aside
+// for far tail jumps (opts_.scratch picks another); it is clobbered only on the path that takes
+// the jump, but that is enough to corrupt a live value, so the two forms that need it are
+// refused when any instruction in the program reads or writes the scratch register.
+EncStatus Encoder::encodeLong(const AsmInstr& ins, uint32_t pc, unsigned size, uint32_t out[3]){
+  errDetail_.clear();
+  bool la = ieq(ins.mnemonic, "LA");
+  bool jal = la || ieq(ins.mnemonic, "JAL");
+  if (ins.args.size() != (jal ? 2u : 3u)) { errDetail_ = jal ? "rd, label" : "rs1, rs2, label"; return EncStatus::OperandCount; }
+  std::string_view label = ins.args[ins.args.size() - 1];
+  uint32_t target;
+  if (!sym_.lookup(label, target)) { errDetail_.assign(label); return EncStatus::UndefinedSymbol; }
+  if (la) {
+    uint8_t rd;
+    if (!parseRegX(ins.args[0], rd)) { errDetail_.assign(ins.args[0]); return EncStatus::ExpectedReg; }
+    uint32_t off = target - pc, hi = (off + 0x800u) >> 12;
+    out[0] = utype((int32_t)hi, rd, 0x17);
+    out[1] = itype((int32_t)(off - (hi << 12)), rd, 0x0, rd, 0x13);
+    return EncStatus::Ok;
+  }
+  if ((target & 0x1) != 0) { errDetail_.assign(label); return EncStatus::Misaligned; }
+  auto farJump = [](uint32_t off, uint8_t rd, uint8_t s, uint32_t* o){
+    uint32_t hi = (off + 0x800u) >> 12; // rounded so lo fits in 12 signed bits
+    o[0] = utype((int32_t)hi, s, 0x17);
+    o[1] = itype((int32_t)(off - (hi << 12)), s, 0x0, rd, 0x67);
+  };
+  auto noScratch = [&]{
+    errDetail_ = "x" + std::to_string(opts_.scratch) + " is used by the program; pick a free one with --scratch";
+    return EncStatus::ScratchInUse;
+  };
+  if (jal){
+    uint8_t rd;
+    if (!parseRegX(ins.args[0], rd)) { errDetail_.assign(ins.args[0]); return EncStatus::ExpectedReg; }
+    if (!rd && scratchInUse()) return noScratch();
+    farJump(target - pc, rd, rd ? rd : opts_.scratch, out);
+    return EncStatus::Ok;
+  }
+  uint8_t rs1, rs2;
+  if (!parseRegX(ins.args[0], rs1)) { errDetail_.assign(ins.args[0]); return EncStatus::ExpectedReg; }
+  if (!parseRegX(ins.args[1], rs2)) { errDetail_.assign(ins.args[1]); return EncStatus::ExpectedReg; }
+  out[0] = btype((int32_t)size, rs2, rs1, ieq(ins.mnemonic, "BEQ") ? 0x1 : 0x0, 0x63); // inverted sense
+  int32_t v = (int32_t)(target - (pc + 4));
+  if (size == 12) {
+    if (scratchInUse()) return noScratch();
+    farJump((uint32_t)v, 0, opts_.scratch, out + 1);
+    return EncStatus::Ok;
+  }
+  if (v < -(1<<20) || v > (1<<20)-2) { errDetail_ = std::to_string(v); return EncStatus::ImmOutOfRange; }
+  out[1] = jtype(v, 0, 0x6F);
+  return EncStatus::Ok;
+}
+
+bool Encoder::scratchInUse() {
+  if (scratchUsed_ < 0) {
+    const uint32_t bit = regBit(opts_.scratch);
+    InstrFacts f;
+    scratchUsed_ = 0;
+    for (const AsmInstr& ins : prog_.instrs)
+      if (analyzeInstr(ins, f) && ((f.defs | f.uses) & bit)) { scratchUsed_ = 1; break; }
+  }
+  return scratchUsed_ != 0;
+}
+
+EncStatus Encoder::encodeInstr(const AsmInstr& ins, uint32_t pc, uint32_t& out){
+  std::string M(ins.mnemonic);
   // Upper-case normalize (ASCII-safe)
   for (auto& c : M) c = (char)std::toupper((unsigned char)c);
+  errDetail_.clear();
 
-  auto arg = [&](int k)->std::string {
-    if ((size_t)k >= ins.args.size()) throw std::runtime_error("operand count mismatch for "+M);
-    return ins.args[(size_t)k];
+  // helpers: on failure remember the offending text for the diagnostic and return false
+  auto fail = [&](std::string_view why){ errDetail_.assign(why); return false; };
+  auto count = [&](size_t n, const char* usage){
+    return ins.args.size() == n || fail(usage);
   };
-
-  // helpers to get reg / imm / sym-or-imm
-  auto wantReg = [&](const std::string& s)->uint8_t{
-    uint8_t r; if(!parseRegX(s,r)) throw std::runtime_error("expected register, got '"+s+"'");
-    return r;
+  auto reg = [&](size_t k, uint8_t& r){
+    return parseRegX(ins.args[k], r) || fail(ins.args[k]);
   };
-  auto wantImm = [&](const std::string& s)->int32_t{
-    if(!isNumber(s)) throw std::runtime_error("expected immediate, got '"+s+"'");
-    long long v = parseInt(s);
-    return (int32_t)v;
+  auto imm = [&](size_t k, int32_t& v){
+    int64_t x; if (!parseInt(ins.args[k], x)) return fail(ins.args[k]);
+    v = (int32_t)x; return true;
   };
-  auto resolveSymOrImm = [&](const std::string& s, uint32_t atPc, bool pcRel=false)->int32_t{
-    if (isNumber(s)) return (int32_t)parseInt(s);
-    if (!sym_.isDefined(s)) throw std::runtime_error("undefined symbol: "+s);
-    int64_t target = sym_.get(s);
-    if (!pcRel) return (int32_t)target;
-    int64_t delta = (int64_t)target - (int64_t)atPc;
-    return (int32_t)delta;
+  auto inRange = [&](int32_t v, int32_t lo, int32_t hi){
+    return (v >= lo && v <= hi) || fail(std::to_string(v));
+  };
+  auto resolveSymOrImm = [&](size_t k, uint32_t atPc, bool pcRel, int32_t& v)->EncStatus{
+    std::string_view s = ins.args[k];
+    int64_t x;
+    if (parseInt(s, x)) { v = (int32_t)x; return EncStatus::Ok; }
+    uint32_t target;
+    if (!sym_.lookup(s, target)) { fail(s); return EncStatus::UndefinedSymbol; }
+    v = pcRel ? (int32_t)((int64_t)target - (int64_t)atPc) : (int32_t)target;
+    return EncStatus::Ok;
   };
 
   // --- Encoding per mnemonic ---
-  if (M=="ADD"){
-    if (ins.args.size()!=3) throw std::runtime_error("ADD rd, rs1, rs2");
-    uint8_t rd=wantReg(arg(0)), rs1=wantReg(arg(1)), rs2=wantReg(arg(2));
-    return rtype(0x00, rs2, rs1, 0x0, rd, 0x33);
-  }
-  if (M=="SUB"){
-    if (ins.args.size()!=3) throw std::runtime_error("SUB rd, rs1, rs2");
-    uint8_t rd=wantReg(arg(0)), rs1=wantReg(arg(1)), rs2=wantReg(arg(2));
-    return rtype(0x20, rs2, rs1, 0x0, rd, 0x33);
-  }
-  if (M=="ADDI"){
-    if (ins.args.size()!=3) throw std::runtime_error("ADDI rd, rs1, imm");
-    uint8_t rd=wantReg(arg(0)), rs1=wantReg(arg(1)); int32_t imm=wantImm(arg(2));
-    if (imm < -2048 || imm > 2047) throw std::runtime_error("ADDI imm out of range");
-    return itype(imm, rs1, 0x0, rd, 0x13);
-  }
-  if (M=="LW"){
-    if (ins.args.size()!=2) throw std::runtime_error("LW rd, off(rs1)");
-    uint8_t rd = wantReg(arg(0));
-    int32_t off; uint8_t rs1;
-    if (!parseMemOp(arg(1), off, rs1)) throw std::runtime_error("LW expects off(rs1)");
-    if (off < -2048 || off > 2047) throw std::runtime_error("LW offset out of range");
-    return itype(off, rs1, 0x2, rd, 0x03);
-  }
-  if (M=="SW"){
-    if (ins.args.size()!=2) throw std::runtime_error("SW rs2, off(rs1)");
-    uint8_t rs2 = wantReg(arg(0));
-    int32_t off; uint8_t rs1;
-    if (!parseMemOp(arg(1), off, rs1)) throw std::runtime_error("SW expects off(rs1)");
-    if (off < -2048 || off > 2047) throw std::runtime_error("SW offset out of range");
-    return stype(off, rs2, rs1, 0x2, 0x23);
-  }
-  if (M=="BEQ"){
-    if (ins.args.size()!=3) throw std::runtime_error("BEQ rs1, rs2, label");
-    uint8_t rs1=wantReg(arg(0)), rs2=wantReg(arg(1));
-    int32_t imm = resolveSymOrImm(arg(2), pc, /*pcRel*/true);
+  if (M=="ADD" || M=="SUB"){
+    if (!count(3, "rd, rs1, rs2")) return EncStatus::OperandCount;
+    uint8_t rd, rs1, rs2;
+    if (!reg(0, rd) || !reg(1, rs1) || !reg(2, rs2)) return EncStatus::ExpectedReg;
+    out = rtype(M=="SUB" ? 0x20 : 0x00, rs2, rs1, 0x0, rd, 0x33);
+    return EncStatus::Ok;
+  }
+  if (M=="ADDI" || M=="JALR"){
+    if (!count(3, "rd, rs1, imm")) return EncStatus::OperandCount;
+    uint8_t rd, rs1; int32_t v;
+    if (!reg(0, rd) || !reg(1, rs1)) return EncStatus::ExpectedReg;
+    if (!imm(2, v)) return EncStatus::ExpectedImm;
+    if (!inRange(v, -2048, 2047)) return EncStatus::ImmOutOfRange;
+    out = itype(v, rs1, 0x0, rd, M=="ADDI" ? 0x13 : 0x67);
+    return EncStatus::Ok;
+  }
+  if (M=="LW" || M=="SW"){
+    if (!count(2, M=="LW" ? "rd, off(rs1)" : "rs2, off(rs1)")) return EncStatus::OperandCount;
+    uint8_t r; int32_t off; uint8_t rs1;
+    if (!reg(0, r)) return EncStatus::ExpectedReg;
+    if (!parseMemOp(ins.args[1], off, rs1)) { fail(ins.args[1]); return EncStatus::BadMemOperand; }
+    if (!inRange(off, -2048, 2047)) return EncStatus::ImmOutOfRange;
+    out = M=="LW" ? itype(off, rs1, 0x2, r, 0x03) : stype(off, r, rs1, 0x2, 0x23);
+    return EncStatus::Ok;
+  }
+  if (M=="BEQ" || M=="BNE"){
+    if (!count(3, "rs1, rs2, label")) return EncStatus::OperandCount;
+    uint8_t rs1, rs2; int32_t v;
+    if (!reg(0, rs1) || !reg(1, rs2)) return EncStatus::ExpectedReg;
+    EncStatus st = resolveSymOrImm(2, pc, /*pcRel*/true, v);
+    if (st != EncStatus::Ok) return st;
     // branch immediate is relative to pc; must be even; byte range in [-4096, +4094]
-    if ((imm & 0x1) != 0) throw std::runtime_error("BEQ target misaligned");
-    if (imm < -(1<<12) || imm > ((1<<12)-2)) throw std::runtime_error("BEQ out of range");
-    return btype(imm, rs2, rs1, 0x0, 0x63);
-  }
-  if (M == "LUI") {
-    if (ins.args.size() != 2) throw std::runtime_error("LUI rd, imm20");
-    uint8_t rd = wantReg(arg(0));
-    int64_t v = parseInt(arg(1));
-    // Use lower 20 bits as immediate field directly.
-    int32_t imm20 = (int32_t)(v & 0xFFFFF);
-    return utype(imm20, rd, 0x37);
-  }
-  if (M=="AUIPC"){
-    if (ins.args.size()!=2) throw std::runtime_error("AUIPC rd, imm20");
-    uint8_t rd=wantReg(arg(0)); int64_t v=parseInt(arg(1));
-    int32_t imm20 = (int32_t)((uint32_t)v >> 12);
-    return utype(imm20, rd, 0x17);
+    if ((v & 0x1) != 0) { fail(ins.args[2]); return EncStatus::Misaligned; }
+    if (!inRange(v, -(1<<12), (1<<12)-2)) return EncStatus::ImmOutOfRange;
+    out = btype(v, rs2, rs1, M=="BEQ" ? 0x0 : 0x1, 0x63);
+    return EncStatus::Ok;
+  }
+  if (M=="LUI" || M=="AUIPC"){
+    if (!count(2, "rd, imm20")) return EncStatus::OperandCount;
+    uint8_t rd; int64_t v;
+    if (!reg(0, rd)) return EncStatus::ExpectedReg;
+    if (!parseInt(ins.args[1], v)) { fail(ins.args[1]); return EncStatus::ExpectedImm; }
+    // LUI: lower 20 bits go into the U field directly; AUIPC: value is the byte offset (v>>12).
+    int32_t imm20 = M=="LUI" ? (int32_t)(v & 0xFFFFF) : (int32_t)((uint32_t)v >> 12);
+    out = utype(imm20, rd, M=="LUI" ? 0x37 : 0x17);
+    return EncStatus::Ok;
   }
   if (M=="JAL"){
-    if (ins.args.size()!=2) throw std::runtime_error("JAL rd, label");
-    uint8_t rd=wantReg(arg(0));
-    int32_t imm = resolveSymOrImm(arg(1), pc, /*pcRel*/true);
+    if (!count(2, "rd, label")) return EncStatus::OperandCount;
+    uint8_t rd; int32_t v;
+    if (!reg(0, rd)) return EncStatus::ExpectedReg;
+    EncStatus st = resolveSymOrImm(1, pc, /*pcRel*/true, v);
+    if (st != EncStatus::Ok) return st;
     // JAL immediate is relative to pc; must be even; byte range in [-(1<<20), (1<<20)-2]
-    if ((imm & 0x1) != 0) throw std::runtime_error("JAL target misaligned");
-    if (imm < -(1<<20) || imm > ((1<<20)-2)) throw std::runtime_error("JAL out of range");
-    return jtype(imm, rd, 0x6F);
+    if ((v & 0x1) != 0) { fail(ins.args[1]); return EncStatus::Misaligned; }
+    if (!inRange(v, -(1<<20), (1<<20)-2)) return EncStatus::ImmOutOfRange;
+    out = jtype(v, rd, 0x6F);
+    return EncStatus::Ok;
   }
-  if (M=="JALR"){
-    if (ins.args.size()!=3) throw std::runtime_error("JALR rd, rs1, imm");
-    uint8_t rd=wantReg(arg(0)), rs1=wantReg(arg(1)); int32_t imm=wantImm(arg(2));
-    if (imm < -2048 || imm > 2047) throw std::runtime_error("JALR imm out of range");
-    return itype(imm, rs1, 0x0, rd, 0x67);
+  if (isPseudo(M)){
+    // Only malformed pseudos survive expandPseudos(); report why.
+    AsmInstr seq[2]; unsigned n;
+    return lowerPseudo(*prog_.arena, ins, seq, n, errDetail_);
   }
 
-  throw std::runtime_error("unknown mnemonic: "+M);
+  return EncStatus::UnknownMnemonic;
 }
@@ -1,5 +1,6 @@
 #include "assembler/lexer.h"
 #include <cctype>
+#include <charconv>
 
 static bool isIdentStart(char c){ return std::isalpha((unsigned char)c) || c=='_' || c=='.'; }
 static bool isIdentCont (char c){ return std::isalnum((unsigned char)c) || c=='_' || c=='.'; }
@@ -32,27 +33,34 @@ std::vector<Token> Lexer::tokenize() {
 
     // number: dec or 0x...
     if (std::isdigit((unsigned char)c)) {
-      std::string s; while(std::isxdigit((unsigned char)peek()) || (s=="0" && (peek()=='x'||peek()=='X'))) s.push_back(get());
+      size_t b = pos_;
+      while(std::isxdigit((unsigned char)peek()) || (pos_-b==1 && src_[b]=='0' && (peek()=='x'||peek()=='X'))) get();
+      std::string_view s(src_.data()+b, pos_-b);
+      // from_chars never throws; malformed/overflowing text keeps v=0 and the encoder,
+      // which re-parses operand text, reports it against the right line.
       int64_t v = 0;
-      if (s.size()>2 && s[0]=='0' && (s[1]=='x'||s[1]=='X')) v = (int64_t)std::stoll(s, nullptr, 16);
-      else v = (int64_t)std::stoll(s, nullptr, 10);
+      if (s.size()>2 && s[0]=='0' && (s[1]=='x'||s[1]=='X')) std::from_chars(s.data()+2, s.data()+s.size(), v, 16);
+      else std::from_chars(s.data(), s.data()+s.size(), v, 10);
       toks_.push_back({TokKind::Imm, s, v, l});
       continue;
     }
 
     // register xN
     if (c=='x' && pos_+1<src_.size() && std::isdigit((unsigned char)src_[pos_+1])) {
-      std::string s; s.push_back(get());
-      while(std::isdigit((unsigned char)peek())) s.push_back(get());
-      int64_t idx = std::stoll(s.substr(1));
+      size_t b = pos_; get();
+      while(std::isdigit((unsigned char)peek())) get();
+      std::string_view s(src_.data()+b, pos_-b);
+      int64_t idx = 0;
+      std::from_chars(s.data()+1, s.data()+s.size(), idx, 10);
       toks_.push_back({TokKind::Reg, s, idx, l});
       continue;
     }
 
     // identifier / mnemonic / directive
     if (isIdentStart(c)) {
-      std::string s; s.push_back(get());
-      while(isIdentCont(peek())) s.push_back(get());
+      size_t b = pos_; get();
+      while(isIdentCont(peek())) get();
+      std::string_view s(src_.data()+b, pos_-b);
       toks_.push_back({TokKind::Ident, s, 0, l});
       continue;
     }
@@ -61,5 +69,5 @@ std::vector<Token> Lexer::tokenize() {
     get();
   }
   toks_.push_back({TokKind::End, "", 0, line_});
-  return toks_;
+  return std::move(toks_);
 }
@@ -1,19 +1,48 @@
-// CLI: assembler in.s -o out.bin --hex
+// CLI: assembler in.s -o out.bin --hex [-O] [--sched] [--load-latency N] [--scratch xN] [--rvc] [--map FILE]
+//      [--layout-profile FILE] [--stats]
 #include "assembler/driver.h"
+#include "assembler/operands.h"
 #include <iostream>
 #include <string>
 
 int main(int argc, char** argv){
   if (argc < 4){
-    std::cerr << "usage: assembler in.s -o out.bin [--hex]\n";
+    std::cerr << "usage: assembler in.s -o out.bin [--hex] [-O] [--sched] [--load-latency N] [--scratch xN] [--rvc] [--map FILE] [--layout-profile FILE] [--stats]\n";
     return 64;
   }
-  std::string inFile = argv[1], outFile; bool hex=false;
+  std::string inFile = argv[1], outFile; bool stats=false;
+  AsmOptions opts;
   for (int i=2;i<argc;i++){
     std::string a = argv[i];
     if (a=="-o" && i+1<argc) outFile = argv[++i];
-    else if (a=="--hex") hex = true;
+    else if (a=="--hex") opts.hex = true;
+    else if (a=="--rvc") opts.compress = true;
+    else if (a=="-O") opts.optimize = true;
+    else if (a=="--sched") opts.schedule = true;
+    else if (a=="--load-latency" && i+1<argc) {
+      int64_t v;
+      if (!parseInt(argv[++i], v) || v < 1 || v > 64) {
+        std::cerr << "--load-latency: expected cycles 1..64, got '" << argv[i] << "'\n";
+        return 64;
+      }
+      opts.loadLatency = (unsigned)v;
+    }
+    else if (a=="--scratch" && i+1<argc) {
+      if (!parseRegX(argv[++i], opts.scratch) || opts.scratch == 0) {
+        std::cerr << "--scratch: expected a register x1..x31, got '" << argv[i] << "'\n";
+        return 64;
+      }
+    }
+    else if (a=="--map" && i+1<argc) opts.mapPath = argv[++i];
+    else if (a=="--layout-profile" && i+1<argc) opts.layoutProfile = argv[++i];
+    else if (a=="--stats") stats = true;
   }
   if (outFile.empty()){ std::cerr << "missing -o <outfile>\n"; return 64; }
-  return assembleFile(inFile, outFile, hex);
+  Arena arena;
+  int rc = assembleFile(inFile, outFile, opts, arena);
+  if (stats) {
+    std::cerr << "arena: high-water " << arena.highWater() << " bytes, reserved "
+              << arena.bytesReserved() << " bytes\n";
+  }
+  return rc;
 }
@@ -0,0 +1,52 @@
+#include "assembler/operands.h"
+#include <cctype>
+#include <charconv>
+#include <climits>
+
+bool parseInt(std::string_view s, int64_t& out){
+  size_t i = 0; bool neg = false;
+  if (i < s.size() && (s[i] == '+' || s[i] == '-')) neg = (s[i++] == '-');
+  int base = 10;
+  if (i + 2 < s.size() && s[i] == '0' && (s[i+1]=='x' || s[i+1]=='X')) { base = 16; i += 2; }
+  if (i >= s.size()) return false;
+  uint64_t v = 0;
+  const char* end = s.data() + s.size();
+  auto r = std::from_chars(s.data() + i, end, v, base);
+  if (r.ec != std::errc() || r.ptr != end) return false;
+  if (v > (uint64_t)INT64_MAX + (neg ? 1u : 0u)) return false;
+  out = neg ? (int64_t)(0 - v) : (int64_t)v;
+  return true;
+}
+bool parseRegX(const char* b, const char* e, uint8_t& out){
+  if (e - b < 2 || *b != 'x') return false;
+  unsigned v = 0;
+  auto r = std::from_chars(b + 1, e, v, 10);
+  if (r.ec != std::errc() || r.ptr != e || v > 31) return false;
+  out = (uint8_t)v; return true;
+}
+bool parseRegX(std::string_view s, uint8_t& out){
+  return parseRegX(s.data(), s.data() + s.size(), out);
+}
+bool parseMemOp(std::string_view s, int32_t& off, uint8_t& rs1){
+  auto sp = [](char c){ return c==' ' || c=='\t'; };
+  size_t b = 0, e = s.size();
+  while (b < e && sp(s[b])) ++b;
+  while (e > b && sp(s[e-1])) --e;
+  size_t lp = s.find('(', b);
+  if (lp == std::string_view::npos || lp >= e || e - b < 4 || s[e-1] != ')') return false;
+  size_t ie = lp; while (ie > b && sp(s[ie-1])) --ie;
+  int64_t v;
+  if (!parseInt(s.substr(b, ie - b), v)) return false;
+  size_t rb = lp + 1, re = e - 1;
+  while (rb < re && sp(s[rb])) ++rb;
+  while (re > rb && sp(s[re-1])) --re;
+  if (!parseRegX(s.data() + rb, s.data() + re, rs1)) return false;
+  off = (int32_t)v; return true;
+}
+
+bool ieq(std::string_view a, const char* upper){
+  size_t i = 0;
+  for (; i < a.size() && upper[i]; ++i)
+    if (std::toupper((unsigned char)a[i]) != upper[i]) return false;
+  return i == a.size() && !upper[i];
+}
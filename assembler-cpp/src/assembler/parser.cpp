@@ -1,7 +1,15 @@
 #include "assembler/parser.h"
-#include <stdexcept>
+#include <cstring>
 
-Parser::Parser(const std::vector<Token>& t):toks_(t){}
+Parser::Parser(const std::vector<Token>& t, Arena& a):toks_(t),arena_(a){}
+
+AsmInstr makeInstr(Arena& a, std::string_view mnemonic,
+                   std::initializer_list<std::string_view> args, unsigned line){
+  AsmInstr ins{a.copy(mnemonic), {}, line};
+  ins.args.ptr = a.allocArray<std::string_view>(args.size());
+  for (auto s : args) ins.args.ptr[ins.args.n++] = a.copy(s);
+  return ins;
+}
 
 const Token& Parser::peek(int k) const {
   size_t j = i_ + (size_t)k;
@@ -16,18 +24,44 @@ bool Parser::expect(TokKind k, const char* msg){
 }
 
 Program Parser::parse(){
-  Program P;
+  Program P(arena_);
+  // One instruction per line at most: size the arrays once instead of growing them.
+  size_t lines = 1;
+  for (const auto& t : toks_) lines += (t.kind==TokKind::Newline);
+  P.instrs.reserve(lines);
+
+  Line L;
   while (peek().kind != TokKind::End){
-    auto L = parseLine();
-    if (!L.labels.empty()) for (auto& nm: L.labels) P.labels.push_back({nm, L.line});
-    if (!L.mnemonic.empty()) P.instrs.push_back({L.mnemonic, L.operands, L.line});
+    parseLine(L);
+    for (auto nm: L.labels) P.labels.push_back({arena_.copy(nm), L.line});
+    if (!L.mnemonic.empty()){
+      AsmInstr ins{arena_.copy(L.mnemonic), {}, L.line};
+      ins.args.ptr = arena_.allocArray<std::string_view>(L.operands.size());
+      for (auto op : L.operands) ins.args.ptr[ins.args.n++] = op;
+      P.instrs.push_back(ins);
+    }
     while (accept(TokKind::Newline)) {}
   }
   return P;
 }
 
-Line Parser::parseLine(){
-  Line L; L.line = peek().line;
+// Concatenated text of toks_[first, last), copied into the arena.
+std::string_view Parser::operandText(size_t first, size_t last){
+  size_t n = 0;
+  for (size_t j = first; j < last; ++j) n += toks_[j].text.size();
+  if (n == 0) return {};
+  char* p = static_cast<char*>(arena_.alloc(n, 1));
+  size_t o = 0;
+  for (size_t j = first; j < last; ++j){
+    std::memcpy(p + o, toks_[j].text.data(), toks_[j].text.size());
+    o += toks_[j].text.size();
+  }
+  return {p, n};
+}
+
+void Parser::parseLine(Line& L){
+  L.labels.clear(); L.operands.clear(); L.mnemonic = {};
+  L.line = peek().line;
   // labels prefix: ident ':'
   while (peek().kind==TokKind::Ident && peek(1).kind==TokKind::Colon){
     L.labels.push_back(peek().text);
@@ -41,26 +75,22 @@ Line Parser::parseLine(){
     while (true){
       if (peek().kind==TokKind::Newline || peek().kind==TokKind::End) break;
       // capture a token sequence until comma/newline
-      std::string op;
       // allow patterns like 12(x5) or -8(x2)
+      size_t first = i_;
       int par = 0;
       while (true) {
         auto k = peek().kind;
         if (k==TokKind::Comma && par==0) break;
         if (k==TokKind::Newline || k==TokKind::End) break;
-        op += peek().text;
         if (k==TokKind::LParen) par++;
         if (k==TokKind::RParen && par>0) par--;
         i_++;
       }
-      // trim spaces
-      while(!op.empty() && (op.back()==' '||op.back()=='\t')) op.pop_back();
-      while(!op.empty() && (op.front()==' '||op.front()=='\t')) op.erase(op.begin());
+      auto op = operandText(first, i_);
       if(!op.empty()) L.operands.push_back(op);
       accept(TokKind::Comma);
     }
   }
-  return L;
 }
 
 const std::vector<std::string>& Parser::errors() const {
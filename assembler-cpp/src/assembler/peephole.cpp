@@ -0,0 +1,147 @@
+#include "assembler/peephole.h"
+#include "assembler/analysis.h"
+#include <string>
+
+const char* peepholeRuleName(int rule){
+  switch (rule){
+    case PeepholeStats::AddiZero:  return "addi-zero";
+    case PeepholeStats::X0Write:   return "x0-write";
+    case PeepholeStats::JumpNext:  return "jump-next";
+    case PeepholeStats::AddiFold:  return "addi-fold";
+    case PeepholeStats::DeadWrite: return "dead-write";
+  }
+  return "?";
+}
+
+namespace {
+
+constexpr uint32_t kAllRegs = ~1u;    // x1..x31
+constexpr int kFoldWindow = 64;       // how far back addi-fold looks for the first ADDI
+
+struct Round {
+  Program& prog;
+  std::vector<InstrFacts>& facts;
+  std::vector<uint8_t> dead;
+  PeepholeStats& st;
+  size_t changes = 0;
+
+  void kill(uint32_t i, PeepholeStats::Rule r){ dead[i] = 1; ++st.hits[r]; ++changes; }
+
+  void local(){
+    for (uint32_t i = 0; i < facts.size(); ++i){
+      const InstrFacts& f = facts[i];
+      if (f.tag == TAG_ADDI && f.rd != 0 && f.rd == f.rs1 && f.imm == 0) kill(i, PeepholeStats::AddiZero);
+      else if (f.rd == 0 && isPureDef(f.tag)) kill(i, PeepholeStats::X0Write);
+    }
+  }
+
+  void jumpNext(){
+    auto labels = labelIndex(prog);
+    for (uint32_t i = 0; i < facts.size(); ++i){
+      const InstrFacts& f = facts[i];
+      if (dead[i] || f.target.empty() || !(isBranch(f.tag) || (f.tag == TAG_JAL && f.rd == 0))) continue;
+      auto it = labels.find(f.target);
+      if (it == labels.end() || it->second <= i) continue;
+      // Taken or not, control reaches the same instruction once everything between is gone.
+      uint32_t k = i + 1;
+      while (k < it->second && dead[k]) ++k;
+      if (k == it->second) kill(i, PeepholeStats::JumpNext);
+    }
+  }
+
+  void fold(const Cfg& g){
+    for (size_t b = 0; b < g.blocks(); ++b){
+      for (uint32_t j = g.start[b]; j < g.start[b + 1]; ++j){
+        InstrFacts& f = facts[j];
+        if (dead[j] || f.tag != TAG_ADDI || f.rd == 0 || f.rd != f.rs1) continue;
+        const uint32_t n = regBit(f.rd);
+        uint32_t written = 0; // registers written strictly between the two ADDIs
+        int steps = 0;
+        for (uint32_t p = j; p-- > g.start[b] && steps < kFoldWindow; ++steps){
+          if (dead[p]) continue;
+          const InstrFacts& g0 = facts[p];
+          if (g0.defs & n){
+            int32_t sum = g0.imm + f.imm;
+            if (g0.tag == TAG_ADDI && !(written & regBit(g0.rs1)) && sum >= -2048 && sum <= 2047){
+              AsmInstr& ins = prog.instrs[j];
+              std::string imm = std::to_string(sum);
+              ins = makeInstr(*prog.arena, ins.mnemonic, {ins.args[0], prog.instrs[p].args[1], imm}, ins.line);
+              f.rs1 = g0.rs1; f.imm = sum; f.uses = regBit(f.rs1);
+              kill(p, PeepholeStats::AddiFold);
+            }
+            break;
+          }
+          if (g0.uses & n) break; // the intermediate value of xN is observed
+          written |= g0.defs;
+        }
+      }
+    }
+  }
+
+  void deadWrites(const Cfg& g){
+    // Backward liveness to a fixed point; anything that leaves the program keeps all live.
+    const size_t nb = g.blocks();
+    std::vector<uint32_t> liveIn(nb, 0), liveOut(nb, 0);
+    auto succIn = [&](uint32_t s) -> uint32_t {
+      if (s == Cfg::kNone) return 0;
+      if (s == Cfg::kExit) return kAllRegs;
+      return liveIn[s];
+    };
+    bool changed = true;
+    while (changed){
+      changed = false;
+      for (size_t b = nb; b-- > 0;){
+        uint32_t live = succIn(g.fall[b]) | succIn(g.taken[b]);
+        liveOut[b] = live;
+        for (uint32_t i = g.start[b + 1]; i-- > g.start[b];)
+          if (!dead[i]) live = (live & ~facts[i].defs) | facts[i].uses;
+        if (live != liveIn[b]) { liveIn[b] = live; changed = true; }
+      }
+    }
+    for (size_t b = 0; b < nb; ++b){
+      uint32_t live = liveOut[b];
+      for (uint32_t i = g.start[b + 1]; i-- > g.start[b];){
+        if (dead[i]) continue;
+        const InstrFacts& f = facts[i];
+        if (isPureDef(f.tag) && !(live & f.defs)) { kill(i, PeepholeStats::DeadWrite); continue; }
+        live = (live & ~f.defs) | f.uses;
+      }
+    }
+  }
+
+  void compact(){
+    size_t keep = 0;
+    for (size_t i = 0; i < prog.instrs.size(); ++i)
+      if (!dead[i]) prog.instrs[keep++] = prog.instrs[i];
+    prog.instrs.resize(keep);
+  }
+};
+
+} // namespace
+
+PeepholeStats peephole(Program& prog){
+  PeepholeStats st;
+  st.before = st.after = prog.instrs.size();
+  std::vector<InstrFacts> facts;
+  for (;;){
+    facts.resize(prog.instrs.size());
+    for (size_t i = 0; i < facts.size(); ++i){
+      if (!analyzeInstr(prog.instrs[i], facts[i])) { st.skipped = "unrecognised instruction"; return st; }
+      const InstrFacts& f = facts[i];
+      if (f.tag == TAG_AUIPC || ((isBranch(f.tag) || f.tag == TAG_JAL) && f.target.empty())) {
+        st.skipped = "position-dependent code (AUIPC or literal branch offset)";
+        return st;
+      }
+    }
+    Round r{prog, facts, std::vector<uint8_t>(facts.size(), 0), st};
+    r.local();
+    r.jumpNext();
+    Cfg g = buildCfg(prog, facts);
+    r.fold(g);
+    r.deadWrites(g);
+    if (!r.changes) break;
+    r.compact();
+  }
+  st.after = prog.instrs.size();
+  return st;
+}
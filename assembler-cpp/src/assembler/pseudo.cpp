@@ -0,0 +1,93 @@
+#include "assembler/pseudo.h"
+#include "assembler/operands.h"
+
+bool isPseudo(std::string_view m){
+  return ieq(m, "LI") || ieq(m, "LA") || ieq(m, "MV") || ieq(m, "J")
+      || ieq(m, "CALL") || ieq(m, "TAIL") || ieq(m, "RET");
+}
+
+EncStatus lowerPseudo(Arena& arena, const AsmInstr& ins, AsmInstr out[2], unsigned& n,
+                      std::string& detail){
+  const auto& a = ins.args;
+  const std::string_view m = ins.mnemonic;
+  const unsigned line = ins.line;
+  n = 0;
+  detail.clear();
+  auto count = [&](size_t k, const char* usage){
+    if (a.size() == k) return true;
+    detail = usage; return false;
+  };
+  auto reg = [&](size_t k){
+    uint8_t r;
+    if (parseRegX(a[k], r)) return true;
+    detail.assign(a[k]); return false;
+  };
+  auto emit = [&](const char* mnem, std::initializer_list<std::string_view> args){
+    out[n++] = makeInstr(arena, mnem, args, line);
+  };
+
+  if (ieq(m, "LI") || ieq(m, "LA")){
+    if (!count(2, "rd, imm")) return EncStatus::OperandCount;
+    if (!reg(0)) return EncStatus::ExpectedReg;
+    int64_t v;
+    if (!parseInt(a[1], v)) { detail.assign(a[1]); return EncStatus::ExpectedImm; }
+    if (v < INT32_MIN || v > (int64_t)UINT32_MAX) { detail.assign(a[1]); return EncStatus::ImmOutOfRange; }
+    uint32_t u = (uint32_t)v;
+    int32_t s = (int32_t)u;
+    if (s >= -2048 && s <= 2047) {
+      emit("ADDI", {a[0], "x0", std::to_string(s)});
+    } else if ((u & 0xFFFu) == 0) {
+      emit("LUI", {a[0], std::to_string(u >> 12)});
+    } else {
+      // ADDI sign-extends lo, so round hi up whenever lo's bit 11 is set.
+      uint32_t hi = ((u + 0x800u) >> 12) & 0xFFFFFu;
+      int32_t lo = (int32_t)(u - (hi << 12));
+      emit("LUI", {a[0], std::to_string(hi)});
+      emit("ADDI", {a[0], a[0], std::to_string(lo)});
+    }
+    return EncStatus::Ok;
+  }
+  if (ieq(m, "MV")){
+    if (!count(2, "rd, rs")) return EncStatus::OperandCount;
+    if (!reg(0) || !reg(1)) return EncStatus::ExpectedReg;
+    emit("ADDI", {a[0], a[1], "0"});
+    return EncStatus::Ok;
+  }
+  if (ieq(m, "J") || ieq(m, "CALL") || ieq(m, "TAIL")){
+    if (!count(1, "label")) return EncStatus::OperandCount;
+    emit("JAL", {ieq(m, "CALL") ? "x1" : "x0", a[0]});
+    return EncStatus::Ok;
+  }
+  if (ieq(m, "RET")){
+    if (!count(0, "no operands")) return EncStatus::OperandCount;
+    emit("JALR", {"x0", "x1", "0"});
+    return EncStatus::Ok;
+  }
+  return EncStatus::UnknownMnemonic;
+}
+
+void expandPseudos(Program& prog){
+  auto lowerable = [](const AsmInstr& ins){
+    int64_t v;
+    return isPseudo(ins.mnemonic)
+        && !(ieq(ins.mnemonic, "LA") && (ins.args.size() != 2 || !parseInt(ins.args[1], v)));
+  };
+  size_t first = 0;
+  while (first < prog.instrs.size() && !lowerable(prog.instrs[first])) ++first;
+  if (first == prog.instrs.size()) return; // nothing to do: no copy
+
+  ArenaVector<AsmInstr> out(*prog.arena);
+  out.reserve(prog.instrs.size() + 16);
+  out.insert(out.end(), prog.instrs.begin(), prog.instrs.begin() + (std::ptrdiff_t)first);
+  std::string detail;
+  for (size_t i = first; i < prog.instrs.size(); ++i){
+    const AsmInstr& ins = prog.instrs[i];
+    AsmInstr seq[2];
+    unsigned n = 0;
+    if (lowerable(ins) && lowerPseudo(*prog.arena, ins, seq, n, detail) == EncStatus::Ok)
+      out.insert(out.end(), seq, seq + n);
+    else
+      out.push_back(ins);
+  }
+  prog.instrs = std::move(out);
+}
@@ -0,0 +1,157 @@
+#include "assembler/schedule.h"
+#include "assembler/analysis.h"
+#include <algorithm>
+#include <queue>
+
+namespace {
+
+unsigned latencyOf(const InstrFacts& f, const LatencyModel& lat){
+  return f.tag == TAG_LW ? lat.load : lat.alu;
+}
+
+// Keeps its slot: anything before it stays before, anything after stays after.
+bool pinned(const InstrFacts& f){ return endsBlock(f.tag) || f.tag == TAG_AUIPC; }
+
+// Stall cycles of facts[order[0..n)] issued in order, one per cycle.
+uint64_t stalls(const std::vector<InstrFacts>& facts, const uint32_t* order, size_t n,
+                const LatencyModel& lat){
+  uint64_t ready[32] = {}, t = 0, stall = 0;
+  for (size_t k = 0; k < n; ++k){
+    const InstrFacts& f = facts[order[k]];
+    uint64_t issue = t;
+    for (uint32_t u = f.uses; u; u &= u - 1) issue = std::max(issue, ready[__builtin_ctz(u)]);
+    stall += issue - t;
+    if (f.rd) ready[f.rd] = issue + latencyOf(f, lat);
+    t = issue + 1;
+  }
+  return stall;
+}
+
+struct Edge { uint32_t to; unsigned lat; };
+
+// List schedule of region [s, e) (its last instruction may be pinned); writes the new order.
+class Region {
+public:
+  Region(const std::vector<InstrFacts>& facts, const LatencyModel& lat) : facts_(facts), lat_(lat) {}
+
+  void run(uint32_t s, uint32_t e, std::vector<uint32_t>& order){
+    const uint32_t m = e - s;
+    succ_.assign(m, {});
+    npred_.assign(m, 0);
+    build(s, e);
+
+    // Priority: longest latency-weighted path to the end of the region.
+    height_.assign(m, 0);
+    for (uint32_t i = m; i-- > 0;)
+      for (const Edge& x : succ_[i]) height_[i] = std::max(height_[i], height_[x.to] + x.lat);
+
+    earliest_.assign(m, 0);
+    auto byTime = [&](uint32_t a, uint32_t b){ return earliest_[a] != earliest_[b] ? earliest_[a] > earliest_[b] : a > b; };
+    auto byPrio = [&](uint32_t a, uint32_t b){ return height_[a] != height_[b] ? height_[a] < height_[b] : a > b; };
+    std::priority_queue<uint32_t, std::vector<uint32_t>, decltype(byTime)> waiting(byTime);
+    std::priority_queue<uint32_t, std::vector<uint32_t>, decltype(byPrio)> avail(byPrio);
+    for (uint32_t i = 0; i < m; ++i) if (!npred_[i]) waiting.push(i);
+    uint64_t cycle = 0;
+    while (!waiting.empty() || !avail.empty()){
+      if (avail.empty()) cycle = std::max(cycle, earliest_[waiting.top()]);
+      while (!waiting.empty() && earliest_[waiting.top()] <= cycle) { avail.push(waiting.top()); waiting.pop(); }
+      uint32_t i = avail.top(); avail.pop();
+      order.push_back(s + i);
+      for (const Edge& x : succ_[i]){
+        earliest_[x.to] = std::max(earliest_[x.to], cycle + x.lat);
+        if (!--npred_[x.to]) waiting.push(x.to);
+      }
+      ++cycle;
+    }
+  }
+
+private:
+  void edge(uint32_t from, uint32_t to, unsigned lat){ succ_[from].push_back({to, lat}); ++npred_[to]; }
+
+  void build(uint32_t s, uint32_t e){
+    constexpr uint32_t kNone = UINT32_MAX;
+    uint32_t lastDef[32];
+    std::fill(lastDef, lastDef + 32, kNone);
+    std::vector<uint32_t> readers[32]; // since the last write of each register
+    uint32_t lastStore = kNone;
+    std::vector<uint32_t> loads;       // since the last store
+    for (uint32_t i = 0; i < e - s; ++i){
+      const InstrFacts& f = facts_[s + i];
+      if (pinned(f)) { for (uint32_t j = 0; j < i; ++j) edge(j, i, 1); } // stays last
+      for (uint32_t u = f.uses; u; u &= u - 1){
+        int r = __builtin_ctz(u);
+        if (lastDef[r] != kNone) edge(lastDef[r], i, latencyOf(facts_[s + lastDef[r]], lat_));
+        readers[r].push_back(i);
+      }
+      for (uint32_t d = f.defs; d; d &= d - 1){
+        int r = __builtin_ctz(d);
+        if (lastDef[r] != kNone) edge(lastDef[r], i, 1);
+        for (uint32_t j : readers[r]) if (j != i) edge(j, i, 1);
+        readers[r].clear();
+        lastDef[r] = i;
+      }
+      if (f.tag == TAG_LW){
+        if (lastStore != kNone) edge(lastStore, i, 1);
+        loads.push_back(i);
+      } else if (f.tag == TAG_SW){
+        if (lastStore != kNone) edge(lastStore, i, 1);
+        for (uint32_t j : loads) edge(j, i, 1);
+        loads.clear();
+        lastStore = i;
+      }
+    }
+  }
+
+  const std::vector<InstrFacts>& facts_;
+  const LatencyModel& lat_;
+  std::vector<std::vector<Edge>> succ_;
+  std::vector<uint32_t> npred_;
+  std::vector<uint64_t> height_, earliest_;
+};
+
+} // namespace
+
+ScheduleStats schedule(Program& prog, const LatencyModel& lat){
+  ScheduleStats st;
+  std::vector<InstrFacts> facts(prog.instrs.size());
+  for (size_t i = 0; i < facts.size(); ++i){
+    if (!analyzeInstr(prog.instrs[i], facts[i])) { st.skipped = "unrecognised instruction"; return st; }
+    // A literal offset can land mid-block, where the CFG sees no boundary to keep.
+    const InstrFacts& f = facts[i];
+    if ((isBranch(f.tag) || f.tag == TAG_JAL) && f.target.empty()){
+      st.skipped = "position-dependent code (AUIPC or literal branch offset)";
+      return st;
+    }
+  }
+
+  Cfg g = buildCfg(prog, facts);
+  st.blocks = g.blocks();
+  Region region(facts, lat);
+  std::vector<uint32_t> order, ident;
+  std::vector<AsmInstr> tmp;
+  for (size_t b = 0; b < g.blocks(); ++b){
+    const uint32_t s = g.start[b], e = g.start[b + 1];
+    ident.resize(e - s);
+    for (uint32_t i = s; i < e; ++i) ident[i - s] = i;
+    uint64_t before = stalls(facts, ident.data(), ident.size(), lat);
+    st.stallsBefore += before;
+    st.stallsAfter += before;
+    if (!before) continue;
+
+    // Split at pinned instructions (only AUIPC can be one before the block's end).
+    order.clear();
+    for (uint32_t r = s; r < e;){
+      uint32_t q = r;
+      while (q + 1 < e && !pinned(facts[q])) ++q;
+      region.run(r, q + 1, order);
+      r = q + 1;
+    }
+    uint64_t after = stalls(facts, order.data(), order.size(), lat);
+    if (after >= before) continue;
+    st.stallsAfter -= before - after;
+    ++st.reordered;
+    tmp.assign(prog.instrs.begin() + s, prog.instrs.begin() + e);
+    for (uint32_t k = 0; k < e - s; ++k) prog.instrs[s + k] = tmp[order[k] - s];
+  }
+  return st;
+}
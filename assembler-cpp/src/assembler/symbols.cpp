@@ -1,16 +1,23 @@
 #include "assembler/symbols.h"
 #include <stdexcept>
 
-void SymbolTable::define(const std::string& name, uint32_t addr){
+void SymbolTable::define(std::string_view name, uint32_t addr){
   map_[name] = addr;
 }
 
-bool SymbolTable::isDefined(const std::string& name) const {
+bool SymbolTable::isDefined(std::string_view name) const {
   return map_.find(name) != map_.end();
 }
 
-uint32_t SymbolTable::get(const std::string& name) const {
+uint32_t SymbolTable::get(std::string_view name) const {
   auto it = map_.find(name);
-  if (it == map_.end()) throw std::runtime_error("undefined symbol: " + name);
+  if (it == map_.end()) throw std::runtime_error("undefined symbol: " + std::string(name));
   return it->second;
 }
+
+bool SymbolTable::lookup(std::string_view name, uint32_t& out) const {
+  auto it = map_.find(name);
+  if (it == map_.end()) return false;
+  out = it->second;
+  return true;
+}
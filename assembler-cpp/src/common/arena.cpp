@@ -0,0 +1,61 @@
+#include "common/arena.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+Arena::Arena(size_t chunkSize) : chunkSize_(chunkSize) {}
+
+Arena::~Arena() {
+    for (auto& c : chunks_) std::free(c.base);
+}
+
+// Moves to the next retained chunk that can hold the request, or adds a new one.
+bool Arena::nextChunk(size_t size, size_t align) {
+    size_t need = size + align;
+    while (cur_ + 1 < chunks_.size()) {
+        ++cur_;
+        if (chunks_[cur_].size >= need) {
+            ptr_ = chunks_[cur_].base;
+            end_ = ptr_ + chunks_[cur_].size;
+            return true;
+        }
+    }
+    // Grow geometrically so huge jobs need O(log n) chunks.
+    size_t sz = std::max({chunkSize_, need, reserved_});
+    char* base = static_cast<char*>(std::malloc(sz));
+    if (!base) return false;
+    reserved_ += sz;
+    chunks_.push_back({base, sz});
+    cur_ = chunks_.size() - 1;
+    ptr_ = base;
+    end_ = base + sz;
+    return true;
+}
+
+void* Arena::alloc(size_t size, size_t align) {
+    uintptr_t p = ((uintptr_t)ptr_ + (align - 1)) & ~(uintptr_t)(align - 1);
+    if (!ptr_ || p + size > (uintptr_t)end_) {
+        if (!nextChunk(size, align)) throw std::bad_alloc();
+        p = ((uintptr_t)ptr_ + (align - 1)) & ~(uintptr_t)(align - 1);
+    }
+    used_ += (p + size) - (uintptr_t)ptr_;
+    high_ = std::max(high_, used_);
+    ptr_ = (char*)(p + size);
+    return (void*)p;
+}
+
+std::string_view Arena::copy(std::string_view s) {
+    if (s.empty()) return {};
+    char* p = static_cast<char*>(alloc(s.size(), 1));
+    std::memcpy(p, s.data(), s.size());
+    return {p, s.size()};
+}
+
+void Arena::reset() {
+    used_ = 0;
+    cur_ = 0;
+    if (chunks_.empty()) { ptr_ = end_ = nullptr; return; }
+    ptr_ = chunks_[0].base;
+    end_ = ptr_ + chunks_[0].size;
+}
@@ -0,0 +1,76 @@
+#include "common/linemap.h"
+#include "common/utils.h"
+#include <algorithm>
+
+static const char kMagic[4] = {'R', 'V', 'L', 'M'};
+static const uint32_t kVersion = 1;
+
+uint32_t LineMap::lineAt(uint32_t pc) const {
+    auto it = std::upper_bound(runs.begin(), runs.end(), pc,
+                               [](uint32_t p, const std::pair<uint32_t, uint32_t>& r) { return p < r.first; });
+    return it == runs.begin() ? 0 : std::prev(it)->second;
+}
+
+static void put32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int k = 0; k < 4; ++k) out.push_back((uint8_t)(v >> (8 * k)));
+}
+
+static void putVar(std::vector<uint8_t>& out, uint32_t v) {
+    for (; v >= 0x80; v >>= 7) out.push_back((uint8_t)(v | 0x80));
+    out.push_back((uint8_t)v);
+}
+
+bool writeLineMap(const std::string& path, const LineMap& map) {
+    std::vector<uint8_t> out(kMagic, kMagic + 4);
+    put32(out, kVersion);
+    put32(out, (uint32_t)map.source.size());
+    out.insert(out.end(), map.source.begin(), map.source.end());
+    put32(out, (uint32_t)map.runs.size());
+    uint32_t pc = 0, line = 0;
+    for (const auto& r : map.runs) {
+        int32_t dl = (int32_t)(r.second - line);
+        putVar(out, r.first - pc);
+        putVar(out, ((uint32_t)dl << 1) ^ (uint32_t)(dl >> 31)); // zigzag
+        pc = r.first;
+        line = r.second;
+    }
+    return writeBinaryFile(path, out);
+}
+
+bool readLineMap(const std::string& path, LineMap& map) {
+    std::vector<uint8_t> in = readBinaryFile(path);
+    size_t p = 0;
+    auto get32 = [&](uint32_t& v) {
+        if (in.size() - p < 4) return false;
+        v = (uint32_t)in[p] | ((uint32_t)in[p + 1] << 8) | ((uint32_t)in[p + 2] << 16) | ((uint32_t)in[p + 3] << 24);
+        p += 4;
+        return true;
+    };
+    auto getVar = [&](uint32_t& v) {
+        v = 0;
+        for (unsigned shift = 0; p < in.size() && shift < 35; shift += 7) {
+            uint8_t b = in[p++];
+            v |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    };
+    uint32_t version, len, n;
+    if (in.size() < 4 || !std::equal(kMagic, kMagic + 4, in.begin())) return false;
+    p = 4;
+    if (!get32(version) || version != kVersion || !get32(len) || in.size() - p < len) return false;
+    map.source.assign(in.begin() + (std::ptrdiff_t)p, in.begin() + (std::ptrdiff_t)(p + len));
+    p += len;
+    if (!get32(n)) return false;
+    map.runs.clear();
+    map.runs.reserve(std::min<size_t>(n, in.size()));
+    uint32_t pc = 0, line = 0;
+    for (uint32_t k = 0; k < n; ++k) {
+        uint32_t dp, zl;
+        if (!getVar(dp) || !getVar(zl)) return false;
+        pc += dp;
+        line += (uint32_t)((int32_t)(zl >> 1) ^ -(int32_t)(zl & 1));
+        map.runs.emplace_back(pc, line);
+    }
+    return true;
+}
@@ -0,0 +1,174 @@
+// CLI: decodecheck [--threads N] [--from X] [--to Y] [--examples N]
+//
+// Conformance check of decodeInstr against the Rust isa crate (isa_decode through isa-ffi):
+// every 32-bit word in [from, to) (default: all 2^32) goes through both decoders, which must
+// agree on whether it decodes and, if so, on tag, rd, rs1, rs2 and imm. Disagreements are
+// grouped by opcode, funct3 and the set of fields that differ, one line per group with a
+// count and the first word seen. Words whose low bits mark an RVC parcel must be rejected by
+// both; the Rust crate has no compressed decoder to hold decodeCompressed against.
+//
+// Doubles as a throughput benchmark: each chunk is decoded by one decoder into a buffer,
+// then by the other, and the two passes are timed separately. Nothing per word allocates or
+// formats, which is what keeps the whole space to minutes.
+#include "common/isa.h"
+#include "decoder/decoder.h"
+#include "decoder/formatter.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t kSpace = 1ull << 32; // every 32-bit word
+constexpr uint64_t kChunk = 1u << 16;   // words per unit of work
+
+enum : uint32_t { kValid = 1, kTag = 2, kRd = 4, kRs1 = 8, kRs2 = 16, kImm = 32 }; // differing fields
+
+struct Group {
+    uint64_t count = 0;
+    uint32_t first = 0; // lowest word in the group (chunks are taken in order per thread)
+};
+
+struct Worker {
+    uint64_t words = 0, valid = 0, mismatches = 0;
+    double cppSeconds = 0, rustSeconds = 0;
+    std::unordered_map<uint32_t, Group> groups; // (opcode << 9 | funct3 << 6 | fields) -> group
+};
+
+uint32_t differences(bool cppOk, const DecodedInstr& c, bool rustOk, const DecodedInstr& r) {
+    if (cppOk != rustOk) return kValid;
+    if (!cppOk) return 0;
+    uint32_t m = 0;
+    if (c.tag != r.tag) m |= kTag;
+    if (c.rd != r.rd) m |= kRd;
+    if (c.rs1 != r.rs1) m |= kRs1;
+    if (c.rs2 != r.rs2) m |= kRs2;
+    if (c.imm != r.imm) m |= kImm;
+    return m;
+}
+
+void run(Worker& w, std::atomic<uint64_t>& next, uint64_t to) {
+    using Clock = std::chrono::steady_clock;
+    std::vector<DecodedInstr> cpp(kChunk), rust(kChunk);
+    std::vector<uint8_t> cppOk(kChunk), rustOk(kChunk);
+    for (;;) {
+        uint64_t lo = next.fetch_add(kChunk, std::memory_order_relaxed);
+        if (lo >= to) break;
+        const uint32_t n = (uint32_t)(std::min(lo + kChunk, to) - lo);
+        const uint32_t base = (uint32_t)lo;
+
+        auto t0 = Clock::now();
+        for (uint32_t i = 0; i < n; ++i) cppOk[i] = decodeInstr(base + i, cpp[i]);
+        auto t1 = Clock::now();
+        for (uint32_t i = 0; i < n; ++i) rustOk[i] = isa_decode(base + i, &rust[i]) == ISA_OK;
+        auto t2 = Clock::now();
+        w.cppSeconds += std::chrono::duration<double>(t1 - t0).count();
+        w.rustSeconds += std::chrono::duration<double>(t2 - t1).count();
+
+        for (uint32_t i = 0; i < n; ++i) {
+            w.valid += rustOk[i];
+            uint32_t m = differences(cppOk[i], cpp[i], rustOk[i], rust[i]);
+            if (!m) continue;
+            uint32_t word = base + i;
+            Group& g = w.groups[(word & 0x7f) << 9 | (word >> 12 & 7) << 6 | m];
+            if (!g.count++) g.first = word;
+            ++w.mismatches;
+        }
+        w.words += n;
+    }
+}
+
+std::string fieldNames(uint32_t m) {
+    static const char* names[] = {"valid", "tag", "rd", "rs1", "rs2", "imm"};
+    std::string s;
+    for (int b = 0; b < 6; ++b)
+        if (m >> b & 1) { if (!s.empty()) s += ','; s += names[b]; }
+    return s;
+}
+
+void describe(char* out, size_t size, bool ok, const DecodedInstr& d) {
+    if (!ok) std::snprintf(out, size, "invalid");
+    else std::snprintf(out, size, "%s rd=%u rs1=%u rs2=%u imm=%d", mnemonicName(d.tag), d.rd, d.rs1, d.rs2, d.imm);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t from = 0, to = kSpace;
+    size_t examples = 20;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--threads" && i + 1 < argc) threads = (unsigned)std::strtoul(argv[++i], nullptr, 0);
+        else if (a == "--from" && i + 1 < argc) from = std::strtoull(argv[++i], nullptr, 0);
+        else if (a == "--to" && i + 1 < argc) to = std::strtoull(argv[++i], nullptr, 0);
+        else if (a == "--examples" && i + 1 < argc) examples = std::strtoull(argv[++i], nullptr, 0);
+        else {
+            std::cerr << "usage: decodecheck [--threads N] [--from X] [--to Y] [--examples N]\n";
+            return 64;
+        }
+    }
+    to = std::min(to, kSpace);
+    if (threads == 0 || from >= to) {
+        std::cerr << "decodecheck: empty range or no threads\n";
+        return 64;
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::atomic<uint64_t> next{from};
+    std::vector<Worker> workers(threads);
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; ++t)
+        pool.emplace_back(run, std::ref(workers[t]), std::ref(next), to);
+    for (auto& th : pool) th.join();
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    Worker total;
+    for (Worker& w : workers) {
+        total.words += w.words;
+        total.valid += w.valid;
+        total.mismatches += w.mismatches;
+        total.cppSeconds += w.cppSeconds;
+        total.rustSeconds += w.rustSeconds;
+        for (const auto& [key, g] : w.groups) {
+            Group& t = total.groups[key];
+            if (!t.count || g.first < t.first) t.first = g.first;
+            t.count += g.count;
+        }
+    }
+
+    // Per-thread rates are decoder cost; the aggregate scales them by the threads that ran.
+    auto rate = [&](double seconds) { return seconds > 0 ? total.words / seconds * threads / 1e6 : 0.0; };
+    std::printf("words      %llu in [0x%llx, 0x%llx), %u threads, %.1f s\n", (unsigned long long)total.words,
+                (unsigned long long)from, (unsigned long long)to, threads, wall);
+    std::printf("valid      %llu\n", (unsigned long long)total.valid);
+    std::printf("decodeInstr %8.1f Mwords/s (%.2f ns/word/thread)\n", rate(total.cppSeconds),
+                total.cppSeconds * 1e9 / total.words);
+    std::printf("isa_decode  %8.1f Mwords/s (%.2f ns/word/thread)\n", rate(total.rustSeconds),
+                total.rustSeconds * 1e9 / total.words);
+
+    std::vector<std::pair<uint32_t, Group>> groups(total.groups.begin(), total.groups.end());
+    std::sort(groups.begin(), groups.end(), [](const auto& a, const auto& b) {
+        return a.second.count != b.second.count ? a.second.count > b.second.count : a.first < b.first;
+    });
+    std::printf("mismatches %llu in %zu groups\n", (unsigned long long)total.mismatches, groups.size());
+    for (size_t k = 0; k < groups.size() && k < examples; ++k) {
+        const auto& [key, g] = groups[k];
+        DecodedInstr c, r;
+        bool cOk = decodeInstr(g.first, c), rOk = isa_decode(g.first, &r) == ISA_OK;
+        char cs[96], rs[96];
+        describe(cs, sizeof(cs), cOk, c);
+        describe(rs, sizeof(rs), rOk, r);
+        std::printf("  opcode=0x%02x funct3=%u differ=%-16s %12llu  e.g. 0x%08x: C++ %s | Rust %s\n", key >> 9,
+                    key >> 6 & 7, fieldNames(key & 63).c_str(), (unsigned long long)g.count, g.first, cs, rs);
+    }
+    if (groups.size() > examples) std::printf("  ... %zu more groups\n", groups.size() - examples);
+    return total.mismatches ? 1 : 0;
+}
@@ -0,0 +1,186 @@
+#include "decoder/cfg.h"
+#include "decoder/decoder.h"
+#include <algorithm>
+
+namespace {
+
+bool testBit(const std::vector<uint64_t>& v, uint32_t addr) {
+    size_t p = addr >> 1;
+    return (p >> 6) < v.size() && (v[p >> 6] >> (p & 63) & 1);
+}
+
+void setBit(std::vector<uint64_t>& v, uint32_t addr) {
+    size_t p = addr >> 1;
+    v[p >> 6] |= 1ull << (p & 63);
+}
+
+bool linksOrFalls(const DecodedInstr& di) {
+    return !((di.tag == TAG_JAL || di.tag == TAG_JALR) && di.rd == 0);
+}
+
+bool endsBlock(InstrTag t) {
+    return t == TAG_BEQ || t == TAG_BNE || t == TAG_JAL || t == TAG_JALR;
+}
+
+// What the previous instruction in straight-line order left in a register: AUIPC and LUI
+// results, so that `auipc rX, hi; jalr rd, lo(rX)` has a known target.
+struct Constant {
+    uint8_t reg = 0;
+    uint32_t value = 0;
+    void after(const DecodedInstr& di, uint32_t pc) {
+        reg = 0;
+        if ((di.tag == TAG_AUIPC || di.tag == TAG_LUI) && di.rd) {
+            reg = di.rd;
+            value = (uint32_t)di.imm + (di.tag == TAG_AUIPC ? pc : 0);
+        }
+    }
+    bool target(const DecodedInstr& di, uint32_t& t) const {
+        if (di.tag != TAG_JALR || !reg || di.rs1 != reg) return false;
+        t = (value + (uint32_t)di.imm) & ~1u;
+        return true;
+    }
+};
+
+} // namespace
+
+bool decodeAt(const uint8_t* image, size_t size, uint32_t addr, DecodedInstr& out, unsigned& len,
+              uint32_t& word) {
+    out = DecodedInstr{};
+    len = 0;
+    word = 0;
+    if ((size_t)addr + 2 > size) return false;
+    uint16_t lo = (uint16_t)(image[addr] | image[addr + 1] << 8);
+    if (instrLength(lo) == 2) {
+        len = 2;
+        word = lo;
+        return decodeCompressed(lo, out);
+    }
+    if ((size_t)addr + 4 > size) return false;
+    len = 4;
+    word = lo | (uint32_t)image[addr + 2] << 16 | (uint32_t)image[addr + 3] << 24;
+    return decodeInstr(word, out);
+}
+
+uint32_t ImageCfg::blockAt(uint32_t addr) const {
+    if (!bit(leaderBits, addr)) return kNone;
+    size_t p = addr >> 1;
+    return rank[p >> 6] + (uint32_t)__builtin_popcountll(leaderBits[p >> 6] & ((1ull << (p & 63)) - 1));
+}
+
+ImageCfg buildImageCfg(const uint8_t* image, size_t size, const std::vector<uint32_t>& entries) {
+    ImageCfg g;
+    size = std::min<size_t>(size, (size_t)1 << 32);
+    const size_t words = (size / 2 + 63) / 64;
+    g.codeBits.assign(words, 0);
+    g.leaderBits.assign(words, 0);
+    auto inImage = [&](uint32_t a) { return (a & 1) == 0 && (size_t)a + 2 <= size; };
+
+    // Descent: each path runs straight until it stops or meets visited code; targets are
+    // queued. Every parcel is decoded at most once, plus once per failed visit.
+    std::vector<uint32_t> work;
+    auto reach = [&](uint32_t a) {
+        if (!inImage(a)) return;
+        setBit(g.leaderBits, a);
+        if (!testBit(g.codeBits, a)) work.push_back(a);
+    };
+    for (uint32_t e : entries) reach(e);
+    while (!work.empty()) {
+        uint32_t a = work.back();
+        work.pop_back();
+        Constant c;
+        for (;;) {
+            if (!inImage(a)) break;
+            if (testBit(g.codeBits, a)) { setBit(g.leaderBits, a); break; } // joins visited code
+            DecodedInstr di;
+            unsigned len;
+            uint32_t word, t;
+            if (!decodeAt(image, size, a, di, len, word)) { ++g.invalid; break; }
+            setBit(g.codeBits, a);
+            ++g.instrs;
+            if (di.tag == TAG_BEQ || di.tag == TAG_BNE || di.tag == TAG_JAL) reach(a + (uint32_t)di.imm);
+            else if (c.target(di, t)) reach(t);
+            if (!linksOrFalls(di)) break;
+            if (endsBlock(di.tag) && inImage(a + len)) setBit(g.leaderBits, a + len);
+            c.after(di, a);
+            a += len;
+        }
+    }
+
+    // Blocks, in address order. Besides the leaders found above, a block starts wherever
+    // code does not continue from the instruction before it (gaps and overlaps).
+    struct Exit { uint32_t target; InstrTag tag; bool falls, links; };
+    std::vector<Exit> exits;
+    size_t leaders = 0;
+    for (uint64_t m : g.leaderBits) leaders += (size_t)__builtin_popcountll(m);
+    leaders += leaders / 16 + 16; // most blocks start at a leader already
+    g.start.reserve(leaders);
+    g.end.reserve(leaders);
+    exits.reserve(leaders);
+    const uint32_t kNone = ImageCfg::kNone;
+    uint32_t expect = kNone; // where the current block continues
+    Constant c;
+    for (size_t w = 0; w < words; ++w) {
+        for (uint64_t m = g.codeBits[w]; m; m &= m - 1) {
+            uint32_t a = (uint32_t)((w * 64 + (size_t)__builtin_ctzll(m)) * 2);
+            DecodedInstr di;
+            unsigned len;
+            uint32_t word;
+            decodeAt(image, size, a, di, len, word);
+            if (a != expect) {
+                // An overlap: the instruction the last one falls into starts a block too.
+                if (expect != kNone && expect > a && testBit(g.codeBits, expect)) setBit(g.leaderBits, expect);
+                c = Constant{};
+            }
+            if (a != expect || testBit(g.leaderBits, a)) {
+                setBit(g.leaderBits, a);
+                g.start.push_back(a);
+                g.end.push_back(a);
+                exits.push_back(Exit{kNone, TAG_INVALID, true, false});
+            }
+            Exit& x = exits.back();
+            g.end.back() = a + len;
+            x.tag = di.tag;
+            x.falls = linksOrFalls(di);
+            x.links = (di.tag == TAG_JAL || di.tag == TAG_JALR) && di.rd != 0;
+            x.target = kNone;
+            uint32_t t;
+            if (di.tag == TAG_BEQ || di.tag == TAG_BNE || di.tag == TAG_JAL) x.target = a + (uint32_t)di.imm;
+            else if (c.target(di, t)) x.target = t;
+            c.after(di, a);
+            expect = endsBlock(di.tag) ? kNone : a + len;
+        }
+    }
+
+    g.rank.resize(words);
+    uint32_t seen = 0;
+    for (size_t w = 0; w < words; ++w) {
+        g.rank[w] = seen;
+        seen += (uint32_t)__builtin_popcountll(g.leaderBits[w]);
+    }
+
+    // Edges. Every fall-through into code lands on a leader by construction.
+    const size_t n = g.start.size();
+    g.fall.assign(n, kNone);
+    g.taken.assign(n, kNone);
+    g.flags.assign(n, 0);
+    auto blockOrExit = [&](uint32_t a) {
+        uint32_t b = g.blockAt(a);
+        return b == kNone ? ImageCfg::kExit : b;
+    };
+    for (size_t b = 0; b < n; ++b) {
+        const Exit& x = exits[b];
+        if (x.falls) g.fall[b] = blockOrExit(g.end[b]);
+        if (x.target != kNone) {
+            g.taken[b] = blockOrExit(x.target);
+            if (g.taken[b] != ImageCfg::kExit)
+                g.flags[g.taken[b]] |= x.links ? ImageCfg::kCallTarget : ImageCfg::kJumpTarget;
+        } else if (x.tag == TAG_JALR) {
+            g.taken[b] = ImageCfg::kExit;
+        }
+    }
+    for (uint32_t e : entries) {
+        uint32_t b = inImage(e) ? g.blockAt(e) : kNone;
+        if (b != kNone) g.flags[b] |= ImageCfg::kEntry;
+    }
+    return g;
+}
@@ -1,19 +1,7 @@
 #include "decoder/decoder.h"
+#include "decoder/formatter.h"
 #include "common/utils.h"
-#include <sstream>
-#include <iomanip>
 #include <stdexcept>
-#include <cctype>
-
-static std::string regName(uint8_t r) {
-    return "x" + std::to_string((unsigned)r);
-}
-
-static std::string hex32(uint32_t v) {
-    std::ostringstream oss;
-    oss << "0x" << std::hex << std::setw(8) << std::setfill('0') << v;
-    return oss.str();
-}
 
 static int32_t imm_i(uint32_t w) { return (int32_t)w >> 20; } // sign-extended 12-bit
 static int32_t imm_s(uint32_t w) {
@@ -40,11 +28,7 @@ static int32_t imm_j(uint32_t w) {
     return signExtend(i, 21);
 }
 
-Decoded decodeWord(uint32_t w, uint32_t pc) {
-    Decoded d;
-    d.pc = pc;
-    d.word = w;
-
+bool decodeInstr(uint32_t w, DecodedInstr& d) {
     uint32_t opcode = bits(w, 6, 0);
     uint8_t  rd     = (uint8_t)bits(w, 11, 7);
     uint8_t  funct3 = (uint8_t)bits(w, 14, 12);
@@ -52,119 +36,181 @@ Decoded decodeWord(uint32_t w, uint32_t pc) {
     uint8_t  rs2    = (uint8_t)bits(w, 24, 20);
     uint8_t  funct7 = (uint8_t)bits(w, 31, 25);
 
+    d = DecodedInstr{TAG_INVALID, 0, 0, 0, 0};
     switch (opcode) {
     // ---------- R-type: ADD/SUB ----------
-    case 0x33: {
-        if (funct3 == 0x0 && funct7 == 0x00) {
-            d.mnemonic = "ADD";
-            d.operands = { regName(rd), regName(rs1), regName(rs2) };
-            return d;
-        }
-        if (funct3 == 0x0 && funct7 == 0x20) {
-            d.mnemonic = "SUB";
-            d.operands = { regName(rd), regName(rs1), regName(rs2) };
-            return d;
+    case 0x33:
+        if (funct3 == 0x0 && (funct7 == 0x00 || funct7 == 0x20)) {
+            d = {funct7 ? TAG_SUB : TAG_ADD, rd, rs1, rs2, 0};
+            return true;
         }
         break;
-    }
     // ---------- I-type arithmetic: ADDI ----------
-    case 0x13: {
-        if (funct3 == 0x0) { // ADDI
-            int32_t imm = imm_i(w);
-            d.mnemonic = "ADDI";
-            d.operands = { regName(rd), regName(rs1), std::to_string(imm) };
-            return d;
-        }
+    case 0x13:
+        if (funct3 == 0x0) { d = {TAG_ADDI, rd, rs1, 0, imm_i(w)}; return true; }
         break;
-    }
     // ---------- I-type loads: LW ----------
-    case 0x03: {
-        if (funct3 == 0x2) { // LW
-            int32_t imm = imm_i(w);
-            d.mnemonic = "LW";
-            std::ostringstream mem; mem << imm << "(" << regName(rs1) << ")";
-            d.operands = { regName(rd), mem.str() };
-            return d;
-        }
+    case 0x03:
+        if (funct3 == 0x2) { d = {TAG_LW, rd, rs1, 0, imm_i(w)}; return true; }
         break;
-    }
     // ---------- S-type stores: SW ----------
-    case 0x23: {
-        if (funct3 == 0x2) { // SW
-            int32_t imm = imm_s(w);
-            d.mnemonic = "SW";
-            std::ostringstream mem; mem << imm << "(" << regName(rs1) << ")";
-            d.operands = { regName(rs2), mem.str() };
-            return d;
-        }
+    case 0x23:
+        if (funct3 == 0x2) { d = {TAG_SW, 0, rs1, rs2, imm_s(w)}; return true; }
         break;
-    }
-    // ---------- B-type branches: BEQ ----------
-    case 0x63: {
-        if (funct3 == 0x0) { // BEQ
-            int32_t off = imm_b(w);      // byte offset (signed)
-            uint32_t tgt = pc + off;     // PC-relative target
-            d.mnemonic = "BEQ";
-            d.operands = { regName(rs1), regName(rs2), hex32(tgt) };
-            return d;
-        }
+    // ---------- B-type branches: BEQ / BNE ----------
+    case 0x63:
+        if (funct3 == 0x0) { d = {TAG_BEQ, 0, rs1, rs2, imm_b(w)}; return true; }
+        if (funct3 == 0x1) { d = {TAG_BNE, 0, rs1, rs2, imm_b(w)}; return true; }
         break;
-    }
-    // ---------- U-type: LUI ----------
-    case 0x37: {
-        int32_t imm = imm_u(w);
-        d.mnemonic = "LUI";
-        d.operands = { regName(rd), hex32((uint32_t)imm) };
-        return d;
-    }
-    // ---------- U-type: AUIPC ----------
-    case 0x17: {
-        int32_t imm = imm_u(w);
-        d.mnemonic = "AUIPC";
-        d.operands = { regName(rd), hex32((uint32_t)imm) };
-        return d;
-    }
+    // ---------- U-type: LUI / AUIPC ----------
+    case 0x37: d = {TAG_LUI,   rd, 0, 0, imm_u(w)}; return true;
+    case 0x17: d = {TAG_AUIPC, rd, 0, 0, imm_u(w)}; return true;
     // ---------- J-type: JAL ----------
-    case 0x6F: {
-        int32_t off = imm_j(w);
-        uint32_t tgt = pc + off;
-        d.mnemonic = "JAL";
-        d.operands = { regName(rd), hex32(tgt) };
-        return d;
-    }
+    case 0x6F: d = {TAG_JAL,   rd, 0, 0, imm_j(w)}; return true;
     // ---------- I-type jumps: JALR ----------
-    case 0x67: {
-        if (funct3 == 0x0) {
-            int32_t imm = imm_i(w);
-            d.mnemonic = "JALR";
-            d.operands = { regName(rd), regName(rs1), std::to_string(imm) };
-            return d;
-        }
+    case 0x67:
+        if (funct3 == 0x0) { d = {TAG_JALR, rd, rs1, 0, imm_i(w)}; return true; }
         break;
-    }
     default:
         break;
     }
+    return false;
+}
+
+bool decodeCompressed(uint16_t h, DecodedInstr& d) {
+    // Expands an RVC parcel into the equivalent base-ISA record. Forms whose expansion is
+    // outside this ISA subset (shifts, logic ops, FP) decode as invalid.
+    uint32_t w = h;
+    uint32_t op = bits(w, 1, 0), f3 = bits(w, 15, 13);
+    uint8_t rd  = (uint8_t)bits(w, 11, 7);           // also rs1 in CI/CR
+    uint8_t rs2 = (uint8_t)bits(w, 6, 2);
+    uint8_t rdp = (uint8_t)(8 + bits(w, 4, 2));      // rd'/rs2' (x8..x15)
+    uint8_t rs1p= (uint8_t)(8 + bits(w, 9, 7));      // rs1'
+    int32_t imm6 = signExtend((bits(w, 12, 12) << 5) | bits(w, 6, 2), 6);
+    // CJ offset: [12|11|10:9|8|7|6|5:3|2] = imm[11|4|9:8|10|6|7|3:1|5]
+    auto cjOff = [&]() {
+        uint32_t i = (bits(w, 12, 12) << 11) | (bits(w, 11, 11) << 4) | (bits(w, 10, 9) << 8)
+                   | (bits(w, 8, 8) << 10) | (bits(w, 7, 7) << 6) | (bits(w, 6, 6) << 7)
+                   | (bits(w, 5, 3) << 1) | (bits(w, 2, 2) << 5);
+        return signExtend(i, 12);
+    };
+    // C.LW/C.SW offset: [12:10|6|5] = uimm[5:3|2|6]
+    int32_t lsOff = (int32_t)((bits(w, 12, 10) << 3) | (bits(w, 6, 6) << 2) | (bits(w, 5, 5) << 6));
 
-    // If we reach here: unknown/unsupported encoding
-    std::ostringstream oss;
-    oss << "unknown encoding: opcode=0x" << std::hex << (unsigned)opcode
-        << " word=" << hex32(w);
-    throw std::runtime_error(oss.str());
+    d = DecodedInstr{TAG_INVALID, 0, 0, 0, 0};
+    switch (op) {
+    case 0x0:
+        if (f3 == 0x0) {                                 // C.ADDI4SPN
+            int32_t nz = (int32_t)((bits(w, 12, 11) << 4) | (bits(w, 10, 7) << 6)
+                                 | (bits(w, 6, 6) << 2) | (bits(w, 5, 5) << 3));
+            if (nz == 0) return false;
+            d = {TAG_ADDI, rdp, 2, 0, nz}; return true;
+        }
+        if (f3 == 0x2) { d = {TAG_LW, rdp, rs1p, 0, lsOff}; return true; }   // C.LW
+        if (f3 == 0x6) { d = {TAG_SW, 0, rs1p, rdp, lsOff}; return true; }   // C.SW
+        return false;
+    case 0x1:
+        switch (f3) {
+        case 0x0: d = {TAG_ADDI, rd, rd, 0, imm6}; return true;              // C.NOP/C.ADDI
+        case 0x1: d = {TAG_JAL, 1, 0, 0, cjOff()}; return true;              // C.JAL
+        case 0x2: d = {TAG_ADDI, rd, 0, 0, imm6}; return true;               // C.LI
+        case 0x3:
+            if (rd == 2) {                                                   // C.ADDI16SP
+                uint32_t i = (bits(w, 12, 12) << 9) | (bits(w, 6, 6) << 4) | (bits(w, 5, 5) << 6)
+                           | (bits(w, 4, 3) << 7) | (bits(w, 2, 2) << 5);
+                if (i == 0) return false;
+                d = {TAG_ADDI, 2, 2, 0, signExtend(i, 10)}; return true;
+            }
+            if (imm6 == 0) return false;                                     // C.LUI
+            d = {TAG_LUI, rd, 0, 0, (int32_t)((uint32_t)imm6 << 12)}; return true;
+        case 0x4:                                                            // C.SUB only
+            if (bits(w, 12, 10) == 0x3 && bits(w, 6, 5) == 0x0) {
+                d = {TAG_SUB, rs1p, rs1p, rdp, 0}; return true;
+            }
+            return false;
+        case 0x5: d = {TAG_JAL, 0, 0, 0, cjOff()}; return true;              // C.J
+        case 0x6: case 0x7: {                                                // C.BEQZ / C.BNEZ
+            uint32_t i = (bits(w, 12, 12) << 8) | (bits(w, 11, 10) << 3) | (bits(w, 6, 5) << 6)
+                       | (bits(w, 4, 3) << 1) | (bits(w, 2, 2) << 5);
+            d = {f3 == 0x6 ? TAG_BEQ : TAG_BNE, 0, rs1p, 0, signExtend(i, 9)}; return true;
+        }
+        default: return false;
+        }
+    case 0x2:
+        if (f3 == 0x2) {                                                     // C.LWSP
+            if (rd == 0) return false;
+            int32_t off = (int32_t)((bits(w, 12, 12) << 5) | (bits(w, 6, 4) << 2) | (bits(w, 3, 2) << 6));
+            d = {TAG_LW, rd, 2, 0, off}; return true;
+        }
+        if (f3 == 0x4) {
+            bool hi = bits(w, 12, 12);
+            if (rs2 == 0) {                                                  // C.JR / C.JALR
+                if (rd == 0) return false;
+                d = {TAG_JALR, (uint8_t)(hi ? 1 : 0), rd, 0, 0}; return true;
+            }
+            if (hi) d = {TAG_ADD, rd, rd, rs2, 0};                           // C.ADD
+            else    d = {TAG_ADD, rd, 0, rs2, 0};                            // C.MV
+            return true;
+        }
+        if (f3 == 0x6) {                                                     // C.SWSP
+            int32_t off = (int32_t)((bits(w, 12, 9) << 2) | (bits(w, 8, 7) << 6));
+            d = {TAG_SW, 0, 2, rs2, off}; return true;
+        }
+        return false;
+    default:
+        return false; // 0b11: not a compressed parcel
+    }
 }
 
-std::string formatDecoded(const Decoded& d, bool show_pc) {
-    std::ostringstream oss;
-    if (show_pc) {
-        oss << std::hex << std::setw(8) << std::setfill('0') << d.pc << ": ";
+Decoded decodeWord(uint32_t w, uint32_t pc) {
+    Decoded d;
+    d.pc = pc;
+    d.word = w;
+
+    // Low bits != 0b11 mark a 16-bit RVC parcel in the low half of w.
+    bool compressed = instrLength((uint16_t)w) == 2;
+    if (compressed) d.word = w & 0xFFFFu;
+    DecodedInstr di;
+    if (!(compressed ? decodeCompressed((uint16_t)w, di) : decodeInstr(w, di))) {
+        // unknown/unsupported encoding
+        std::string msg;
+        appendUnknownEncoding(msg, d.word);
+        throw std::runtime_error(msg);
     }
-    oss << d.mnemonic;
-    if (!d.operands.empty()) {
-        oss << " ";
-        for (size_t i = 0; i < d.operands.size(); ++i) {
-            if (i) oss << ", ";
-            oss << d.operands[i];
-        }
+
+    d.mnemonic = compressed ? std::string("C.") + mnemonicName(di.tag) : mnemonicName(di.tag);
+    auto mem = [&](int32_t imm, uint8_t base) {
+        return std::to_string(imm) + "(" + regName(base) + ")";
+    };
+    auto hex = [](uint32_t v) { std::string s; appendHex32(s, v); return s; };
+    switch (di.tag) {
+    case TAG_ADD: case TAG_SUB:
+        d.operands = { regName(di.rd), regName(di.rs1), regName(di.rs2) };
+        break;
+    case TAG_ADDI: case TAG_JALR:
+        d.operands = { regName(di.rd), regName(di.rs1), std::to_string(di.imm) };
+        break;
+    case TAG_LW:
+        d.operands = { regName(di.rd), mem(di.imm, di.rs1) };
+        break;
+    case TAG_SW:
+        d.operands = { regName(di.rs2), mem(di.imm, di.rs1) };
+        break;
+    case TAG_BEQ: case TAG_BNE: // PC-relative target
+        d.operands = { regName(di.rs1), regName(di.rs2), hex(pc + (uint32_t)di.imm) };
+        break;
+    case TAG_LUI: case TAG_AUIPC:
+        d.operands = { regName(di.rd), hex((uint32_t)di.imm) };
+        break;
+    case TAG_JAL:
+        d.operands = { regName(di.rd), hex(pc + (uint32_t)di.imm) };
+        break;
+    default:
+        break;
     }
-    return oss.str();
+    return d;
+}
+
+std::string formatDecoded(const Decoded& d, bool show_pc) {
+    return formatDecoded(d, show_pc, false);
 }
@@ -1,12 +1,16 @@
 #include "decoder/disassembler_driver.h"
+#include "decoder/cfg.h"
 #include "decoder/decoder.h"
 #include "decoder/formatter.h"
 #include "common/utils.h"
 
 #include <vector>
 #include <cstdint>
+#include <cstdio>
 #include <iostream>
-#include <iomanip>
+
+// Output is formatted into one reusable buffer and written in chunks of about this size.
+static constexpr size_t kFlushBytes = 64 * 1024;
 
 static bool toWordLE(const std::vector<uint8_t>& buf, size_t i, uint32_t& out) {
     if (i + 4 > buf.size()) return false;
@@ -17,34 +21,129 @@ static bool toWordLE(const std::vector<uint8_t>& buf, size_t i, uint32_t& out) {
     return true;
 }
 
-int disassembleFile(const std::string& inPath, bool show_pc, bool show_raw) {
+static uint16_t toHalfLE(const std::vector<uint8_t>& buf, size_t i) {
+    return (uint16_t)(buf[i] | (buf[i+1] << 8));
+}
+
+// Recursive mode: code where the CFG found it, data elsewhere. The listing walks the image
+// in address order, so an instruction that starts inside another one (an overlap) gets no
+// line, and jumps to it print its address rather than a label.
+static void listRecursive(const std::vector<uint8_t>& bytes, bool show_pc, bool show_raw, std::string& out) {
+    const ImageCfg g = buildImageCfg(bytes.data(), bytes.size());
+    const size_t size = bytes.size();
+    auto dataLen = [&](size_t i) { return i + 4 <= size && !g.isCode((uint32_t)i + 2) ? 4u : 2u; };
+    std::vector<uint64_t> line(g.codeBits.size(), 0);
+    for (size_t i = 0; i + 2 <= size;) {
+        if (g.isCode((uint32_t)i)) {
+            line[i >> 7] |= 1ull << ((i >> 1) & 63);
+            i += instrLength(toHalfLE(bytes, i));
+        } else {
+            i += dataLen(i);
+        }
+    }
+    auto labelAt = [&](uint32_t a, char* buf) -> const char* {
+        uint32_t b = g.blockAt(a);
+        if (b == ImageCfg::kNone || !g.flags[b] || !(line[a >> 7] >> ((a >> 1) & 63) & 1)) return nullptr;
+        bool fn = g.flags[b] & (ImageCfg::kEntry | ImageCfg::kCallTarget);
+        std::snprintf(buf, 16, "%c_%08x", fn ? 'f' : 'L', a);
+        return buf;
+    };
+
+    char here[16], there[16], data[48];
+    for (size_t i = 0; i + 2 <= size;) {
+        uint32_t pc = (uint32_t)i;
+        if (g.isCode(pc)) {
+            if (const char* l = labelAt(pc, here)) {
+                if (pc && l[0] == 'f') out += '\n';
+                out += l;
+                out += ":\n";
+            }
+            DecodedInstr di;
+            unsigned len;
+            uint32_t word;
+            decodeAt(bytes.data(), size, pc, di, len, word);
+            const char* target = nullptr;
+            if (di.tag == TAG_BEQ || di.tag == TAG_BNE || di.tag == TAG_JAL) target = labelAt(pc + (uint32_t)di.imm, there);
+            appendDecoded(out, di, pc, word, show_pc, show_raw, target);
+            i += len;
+        } else {
+            unsigned len = dataLen(i);
+            uint32_t word = len == 4 ? (uint32_t)bytes[i] | (uint32_t)bytes[i+1] << 8 | (uint32_t)bytes[i+2] << 16
+                                           | (uint32_t)bytes[i+3] << 24
+                                     : toHalfLE(bytes, i);
+            if (show_pc) { appendPc(out, pc); out += ": "; }
+            if (show_raw) {
+                std::snprintf(data, sizeof(data), len == 4 ? "0x%08x  " : "0x%04x      ", word);
+                out += data;
+            }
+            std::snprintf(data, sizeof(data), len == 4 ? ".word 0x%08x" : ".half 0x%04x", word);
+            out += data;
+            i += len;
+        }
+        out += '\n';
+        if (out.size() >= kFlushBytes) {
+            std::cout.write(out.data(), (std::streamsize)out.size());
+            out.clear();
+        }
+    }
+}
+
+int disassembleFile(const std::string& inPath, bool show_pc, bool show_raw, DisasmMode mode) {
     auto bytes = readBinaryFile(inPath);
     if (bytes.empty()) {
         std::cerr << "disasm: failed to read or empty file: " << inPath << "\n";
         return 1;
     }
 
-    uint32_t pc = 0;
-    for (size_t i = 0; i + 4 <= bytes.size(); i += 4, pc += 4) {
-        uint32_t word = 0;
-        if (!toWordLE(bytes, i, word)) break;
-
-        try {
-            Decoded d = decodeWord(word, pc);
-            std::cout << formatDecoded(d, show_pc, show_raw) << "\n";
-        } catch (const std::exception& ex) {
-            // Still print address/word so you can see where decode failed
-            std::cerr << std::hex;
-            if (show_pc) std::cerr << std::setw(8) << std::setfill('0') << pc << ": ";
-            if (show_raw) std::cerr << formatHex32(word) << "  ";
-            std::cerr << "??  ; " << ex.what() << "\n";
+    std::string out;
+    out.reserve(kFlushBytes + 128);
+    auto flush = [&]() {
+        std::cout.write(out.data(), (std::streamsize)out.size());
+        out.clear();
+    };
+
+    if (mode == DisasmMode::Recursive) {
+        listRecursive(bytes, show_pc, show_raw, out);
+        flush();
+        if (bytes.size() & 1) std::cerr << "disasm: warning: trailing 1 byte(s) ignored (incomplete instruction)\n";
+        return 0;
+    }
+
+    // The stream mixes 32-bit words and 16-bit RVC parcels; the low two bits of each
+    // parcel give its length.
+    size_t i = 0;
+    while (i + 2 <= bytes.size()) {
+        uint32_t pc = (uint32_t)i;
+        uint16_t lo = toHalfLE(bytes, i);
+        unsigned len = instrLength(lo);
+        uint32_t word = lo;
+        if (len == 4 && !toWordLE(bytes, i, word)) break;
+
+        DecodedInstr di;
+        bool ok = len == 2 ? decodeCompressed(lo, di) : decodeInstr(word, di);
+        if (ok) {
+            appendDecoded(out, di, pc, word, show_pc, show_raw);
+            out += '\n';
+            if (out.size() >= kFlushBytes) flush();
+        } else {
+            // Still print address/word so you can see where decode failed; stdout is
+            // flushed first so the two streams stay in order on a terminal.
+            flush();
+            std::string err;
+            if (show_pc) { appendPc(err, pc); err += ": "; }
+            if (show_raw) { appendHex32(err, word); err += "  "; }
+            err += "??  ; ";
+            appendUnknownEncoding(err, word);
+            std::cerr << err << "\n";
         }
+        i += len;
     }
+    flush();
 
-    // If file size isn't a multiple of 4, warn.
-    if (bytes.size() % 4 != 0) {
-        std::cerr << "disasm: warning: trailing " << (bytes.size() % 4)
-                  << " byte(s) ignored (binary not word-aligned)\n";
+    // A partial instruction at the end of the file is reported, not decoded.
+    if (i < bytes.size()) {
+        std::cerr << "disasm: warning: trailing " << (bytes.size() - i)
+                  << " byte(s) ignored (incomplete instruction)\n";
     }
     return 0;
 }
@@ -1,32 +1,149 @@
 #include "decoder/formatter.h"
-#include <sstream>
-#include <iomanip>
+#include <charconv>
+
+// Precomputed text: register names, mnemonics, and two hex digits per byte value.
+static const char* const kRegNames[32] = {
+    "x0",  "x1",  "x2",  "x3",  "x4",  "x5",  "x6",  "x7",
+    "x8",  "x9",  "x10", "x11", "x12", "x13", "x14", "x15",
+    "x16", "x17", "x18", "x19", "x20", "x21", "x22", "x23",
+    "x24", "x25", "x26", "x27", "x28", "x29", "x30", "x31",
+};
+static const unsigned char kRegLen[32] = {
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+};
+
+struct HexPairs {
+    char t[512] = {};
+    constexpr HexPairs() {
+        const char* d = "0123456789abcdef";
+        for (int i = 0; i < 256; ++i) { t[2*i] = d[i >> 4]; t[2*i+1] = d[i & 0xF]; }
+    }
+};
+static constexpr HexPairs kHex{};
+
+const char* regName(uint8_t r) { return kRegNames[r & 0x1F]; }
+
+const char* mnemonicName(InstrTag tag) {
+    switch (tag) {
+    case TAG_ADD:   return "ADD";
+    case TAG_SUB:   return "SUB";
+    case TAG_ADDI:  return "ADDI";
+    case TAG_JALR:  return "JALR";
+    case TAG_LW:    return "LW";
+    case TAG_SW:    return "SW";
+    case TAG_BEQ:   return "BEQ";
+    case TAG_BNE:   return "BNE";
+    case TAG_LUI:   return "LUI";
+    case TAG_AUIPC: return "AUIPC";
+    case TAG_JAL:   return "JAL";
+    default:        return nullptr;
+    }
+}
+
+// 8 lowercase hex digits, written directly into the buffer's tail.
+static void put8(std::string& out, uint32_t v) {
+    size_t n = out.size();
+    out.resize(n + 8);
+    char* p = &out[n];
+    for (int i = 3; i >= 0; --i) {
+        const char* h = &kHex.t[2 * ((v >> (8 * i)) & 0xFF)];
+        *p++ = h[0]; *p++ = h[1];
+    }
+}
+
+static void putReg(std::string& out, uint8_t r) { out.append(kRegNames[r & 0x1F], kRegLen[r & 0x1F]); }
+
+static void putInt(std::string& out, int32_t v) {
+    char tmp[12];
+    auto r = std::to_chars(tmp, tmp + sizeof(tmp), v);
+    out.append(tmp, (size_t)(r.ptr - tmp));
+}
+
+void appendHex32(std::string& out, uint32_t v) { out += "0x"; put8(out, v); }
+void appendPc(std::string& out, uint32_t pc)   { put8(out, pc); }
+
+void appendUnknownEncoding(std::string& out, uint32_t word) {
+    static const char* hexd = "0123456789abcdef";
+    uint32_t op = word & 0x7F;
+    out += "unknown encoding: opcode=0x";
+    if (op >= 16) out += hexd[op >> 4];
+    out += hexd[op & 0xF];
+    out += " word=";
+    appendHex32(out, word);
+}
+
+// Raw encoding column: 32-bit words as 0xXXXXXXXX, RVC parcels as 0xXXXX padded to match.
+static void putRaw(std::string& out, uint32_t word) {
+    if ((word & 0x3u) == 0x3u) { appendHex32(out, word); out += "  "; return; }
+    out += "0x";
+    out.append(&kHex.t[2 * ((word >> 8) & 0xFF)], 2);
+    out.append(&kHex.t[2 * (word & 0xFF)], 2);
+    out += "      ";
+}
 
 std::string formatHex32(uint32_t v) {
-    std::ostringstream oss;
-    oss << "0x" << std::hex << std::setw(8) << std::setfill('0') << v;
-    return oss.str();
+    std::string s; appendHex32(s, v); return s;
 }
 
 std::string formatPc(uint32_t pc) {
-    std::ostringstream oss;
-    oss << std::hex << std::setw(8) << std::setfill('0') << pc;
-    return oss.str();
+    std::string s; appendPc(s, pc); return s;
 }
 
-std::string formatDecoded(const Decoded& d, bool show_pc, bool show_raw) {
-    std::ostringstream oss;
+void appendDecoded(std::string& out, const DecodedInstr& di, uint32_t pc, uint32_t word,
+                   bool show_pc, bool show_raw, const char* target) {
+    // RVC parcels (low bits != 0b11) print as "0xXXXX      C.<base expansion>".
+    bool compressed = (word & 0x3u) != 0x3u;
+    if (show_pc)  { put8(out, pc); out += ": "; }
+    if (show_raw) putRaw(out, word);
 
-    if (show_pc)  oss << formatPc(d.pc) << ": ";
-    if (show_raw) oss << formatHex32(d.word) << "  ";
+    const char* m = mnemonicName(di.tag);
+    if (!m) { out += "??"; return; }
+    if (compressed) out += "C.";
+    out += m;
+    out += ' ';
+    switch (di.tag) {
+    case TAG_ADD: case TAG_SUB:
+        putReg(out, di.rd); out += ", "; putReg(out, di.rs1); out += ", "; putReg(out, di.rs2);
+        break;
+    case TAG_ADDI: case TAG_JALR:
+        putReg(out, di.rd); out += ", "; putReg(out, di.rs1); out += ", "; putInt(out, di.imm);
+        break;
+    case TAG_LW: case TAG_SW:
+        putReg(out, di.tag == TAG_LW ? di.rd : di.rs2); out += ", ";
+        putInt(out, di.imm); out += '('; putReg(out, di.rs1); out += ')';
+        break;
+    case TAG_BEQ: case TAG_BNE:
+        putReg(out, di.rs1); out += ", "; putReg(out, di.rs2); out += ", ";
+        if (target) out += target;
+        else appendHex32(out, pc + (uint32_t)di.imm);
+        break;
+    case TAG_LUI: case TAG_AUIPC:
+        putReg(out, di.rd); out += ", "; appendHex32(out, (uint32_t)di.imm);
+        break;
+    case TAG_JAL:
+        putReg(out, di.rd); out += ", ";
+        if (target) out += target;
+        else appendHex32(out, pc + (uint32_t)di.imm);
+        break;
+    default:
+        break;
+    }
+}
+
+std::string formatDecoded(const Decoded& d, bool show_pc, bool show_raw) {
+    std::string s;
+    s.reserve(64);
+    if (show_pc)  { put8(s, d.pc); s += ": "; }
+    if (show_raw) putRaw(s, d.word);
 
-    oss << d.mnemonic;
+    s += d.mnemonic;
     if (!d.operands.empty()) {
-        oss << " ";
+        s += ' ';
         for (size_t i = 0; i < d.operands.size(); ++i) {
-            if (i) oss << ", ";
-            oss << d.operands[i];
+            if (i) s += ", ";
+            s += d.operands[i];
         }
     }
-    return oss.str();
+    return s;
 }
@@ -0,0 +1,132 @@
+#include "emulator/batch.h"
+#include "common/utils.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+namespace {
+
+// Per-thread job queue. Jobs are whole programs (microseconds at the least), so a mutex
+// per deque is cheap next to the work and keeps stealing obviously correct.
+struct WorkQueue {
+    std::mutex m;
+    std::deque<uint32_t> jobs;
+
+    bool popBack(uint32_t& j) {
+        std::lock_guard<std::mutex> g(m);
+        if (jobs.empty()) return false;
+        j = jobs.back(); jobs.pop_back();
+        return true;
+    }
+    bool popFront(uint32_t& j) {
+        std::lock_guard<std::mutex> g(m);
+        if (jobs.empty()) return false;
+        j = jobs.front(); jobs.pop_front();
+        return true;
+    }
+};
+
+void runOne(const BatchJob& job, const BatchOptions& opts, BatchResult& out) {
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<uint8_t> image = readBinaryFile(job.path);
+    if (!image.empty()) {
+        Engine eng(image, opts.memSize);
+        out.run = eng.run(job.budget ? job.budget : opts.budget);
+        out.hart = eng.hart();
+        out.loaded = true;
+    }
+    out.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+void jsonString(std::ostream& os, const std::string& s) {
+    os << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') os << '\\' << c;
+        else if ((unsigned char)c < 0x20) { char b[8]; std::snprintf(b, sizeof(b), "\\u%04x", c); os << b; }
+        else os << c;
+    }
+    os << '"';
+}
+
+// In StopReason order.
+const char* kStatus[] = {"halted", "end_of_image", "pc_out_of_image", "budget", "mem_fault", "illegal"};
+constexpr int kStatuses = sizeof(kStatus) / sizeof(kStatus[0]);
+
+} // namespace
+
+const char* batchStatusName(const BatchResult& r) {
+    return r.loaded ? kStatus[(int)r.run.reason] : "load_error";
+}
+
+std::vector<BatchResult> runBatch(const std::vector<BatchJob>& jobs, const BatchOptions& opts,
+                                  BatchStats* stats) {
+    auto t0 = std::chrono::steady_clock::now();
+    unsigned nt = opts.threads ? opts.threads : std::max(1u, std::thread::hardware_concurrency());
+    nt = (unsigned)std::max<size_t>(1, std::min<size_t>(nt, jobs.size()));
+    std::vector<BatchResult> results(jobs.size());
+    std::vector<WorkQueue> queues(nt);
+    for (unsigned t = 0; t < nt; ++t)
+        for (size_t j = jobs.size() * t / nt; j < jobs.size() * (t + 1) / nt; ++j)
+            queues[t].jobs.push_back((uint32_t)j);
+
+    // No job creates another, so a thread that finds every deque empty is done.
+    std::atomic<uint64_t> steals{0};
+    auto worker = [&](unsigned self) {
+        for (;;) {
+            uint32_t j;
+            bool got = queues[self].popBack(j);
+            for (unsigned k = 1; !got && k < nt; ++k)
+                if ((got = queues[(self + k) % nt].popFront(j))) steals.fetch_add(1, std::memory_order_relaxed);
+            if (!got) return;
+            runOne(jobs[j], opts, results[j]);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < nt; ++t) pool.emplace_back(worker, t);
+    worker(0);
+    for (auto& t : pool) t.join();
+
+    if (stats) {
+        stats->threads = nt;
+        stats->steals = steals.load();
+        stats->instrs = 0;
+        for (const auto& r : results) stats->instrs += r.run.instrs;
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+    return results;
+}
+
+void writeBatchReport(std::ostream& os, const std::vector<BatchJob>& jobs,
+                      const std::vector<BatchResult>& results, const BatchStats& stats) {
+    uint64_t byStatus[kStatuses + 1] = {};
+    for (const auto& r : results) ++byStatus[r.loaded ? (int)r.run.reason : kStatuses];
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%.6f", stats.seconds);
+    os << "{\n  \"programs\": " << results.size() << ",\n  \"threads\": " << stats.threads
+       << ",\n  \"seconds\": " << buf << ",\n  \"instructions\": " << stats.instrs
+       << ",\n  \"steals\": " << stats.steals << ",\n  \"status\": {";
+    for (int s = 0; s <= kStatuses; ++s)
+        os << (s ? ", " : "") << '"' << (s < kStatuses ? kStatus[s] : "load_error") << "\": " << byStatus[s];
+    os << "},\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BatchResult& r = results[i];
+        os << (i ? ",\n" : "\n") << "    {\"path\": ";
+        jsonString(os, jobs[i].path);
+        os << ", \"status\": \"" << batchStatusName(r) << '"';
+        if (r.loaded) {
+            std::snprintf(buf, sizeof(buf), "%.6f", r.seconds);
+            os << ", \"pc\": " << r.run.pc << ", \"instructions\": " << r.run.instrs;
+            if (r.run.reason == StopReason::MemFault) os << ", \"addr\": " << r.run.addr;
+            os << ", \"seconds\": " << buf << ", \"x\": [";
+            for (int k = 0; k < 32; ++k) os << (k ? "," : "") << r.hart.x[k];
+            os << ']';
+        }
+        os << '}';
+    }
+    os << (results.empty() ? "]\n}\n" : "\n  ]\n}\n");
+}
@@ -0,0 +1,178 @@
+#include "emulator/cache.h"
+#include "decoder/formatter.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ostream>
+
+static bool pow2(uint32_t v) { return v && !(v & (v - 1)); }
+
+bool parseCacheConfig(const std::string& spec, CacheConfig& out) {
+    CacheConfig c;
+    std::vector<std::string> f;
+    for (size_t p = 0;;) {
+        size_t q = spec.find(':', p);
+        f.push_back(spec.substr(p, q == std::string::npos ? q : q - p));
+        if (q == std::string::npos) break;
+        p = q + 1;
+    }
+    if (f.size() < 3 || f.size() > 5) return false;
+    auto num = [](const std::string& s, uint32_t& v) {
+        char* end;
+        unsigned long long x = std::strtoull(s.c_str(), &end, 0);
+        if (end == s.c_str()) return false;
+        if (*end == 'K' || *end == 'k') { x <<= 10; ++end; }
+        else if (*end == 'M' || *end == 'm') { x <<= 20; ++end; }
+        if (*end || x > UINT32_MAX) return false;
+        v = (uint32_t)x;
+        return true;
+    };
+    if (!num(f[0], c.size) || !num(f[1], c.ways) || !num(f[2], c.line)) return false;
+    for (size_t k = 3; k < f.size(); ++k) {
+        if (f[k] == "lru") c.repl = Replacement::LRU;
+        else if (f[k] == "fifo") c.repl = Replacement::FIFO;
+        else if (f[k] == "random") c.repl = Replacement::Random;
+        else if (f[k] == "wb") c.write = WritePolicy::WriteBack;
+        else if (f[k] == "wt") c.write = WritePolicy::WriteThrough;
+        else return false;
+    }
+    out = c;
+    return true;
+}
+
+const char* cacheConfigError(const CacheConfig& c) {
+    if (!pow2(c.line) || c.line < 4) return "line size must be a power of two >= 4";
+    if (!c.ways || c.ways > 255) return "associativity must be 1..255";
+    // 64-bit: 255 ways of a 2 GiB line overflow 32 bits, and a zero product would divide by 0.
+    const uint64_t set = (uint64_t)c.ways * c.line;
+    if (set > c.size) return "size must hold at least one set (ways * line)";
+    if (c.size % set) return "size must be a multiple of ways * line";
+    if (!pow2((uint32_t)(c.size / set))) return "number of sets must be a power of two";
+    return nullptr;
+}
+
+std::string describe(const CacheConfig& c) {
+    char buf[64];
+    const char* repl = c.repl == Replacement::LRU ? "lru" : c.repl == Replacement::FIFO ? "fifo" : "random";
+    if (c.size % (1u << 20) == 0)      std::snprintf(buf, sizeof(buf), "%uM", c.size >> 20);
+    else if (c.size % (1u << 10) == 0) std::snprintf(buf, sizeof(buf), "%uK", c.size >> 10);
+    else                               std::snprintf(buf, sizeof(buf), "%uB", c.size);
+    std::string s = buf;
+    std::snprintf(buf, sizeof(buf), " %u-way %uB %s %s", c.ways, c.line, repl,
+                  c.write == WritePolicy::WriteBack ? "wb" : "wt");
+    return s + buf;
+}
+
+Cache::Cache(const CacheConfig& cfg, Cache* next) : cfg_(cfg), next_(next) {
+    lineShift_ = (unsigned)__builtin_ctz(cfg.line);
+    uint32_t sets = cfg.size / (cfg.ways * cfg.line);
+    setMask_ = sets - 1;
+    tags_.assign((size_t)sets * cfg.ways, kInvalid);
+    dirty_.assign(tags_.size(), 0);
+    rank_.resize(tags_.size());
+    for (size_t k = 0; k < rank_.size(); ++k) rank_[k] = (uint8_t)(k % cfg.ways);
+    fifo_.assign(sets, 0);
+}
+
+void Cache::touch(uint32_t base, uint32_t way) {
+    if (cfg_.repl != Replacement::LRU) return;
+    uint8_t r = rank_[base + way];
+    for (uint32_t w = 0; w < cfg_.ways; ++w)
+        if (rank_[base + w] < r) ++rank_[base + w];
+    rank_[base + way] = 0;
+}
+
+uint32_t Cache::victim(uint32_t set) {
+    uint32_t base = set * cfg_.ways;
+    for (uint32_t w = 0; w < cfg_.ways; ++w)
+        if (tags_[base + w] == kInvalid) return w;
+    switch (cfg_.repl) {
+    case Replacement::LRU:
+        for (uint32_t w = 0; w < cfg_.ways; ++w)
+            if (rank_[base + w] == cfg_.ways - 1) return w;
+        return 0;
+    case Replacement::FIFO: {
+        uint32_t w = fifo_[set];
+        fifo_[set] = (uint8_t)((w + 1) % cfg_.ways);
+        return w;
+    }
+    case Replacement::Random:
+        rng_ ^= rng_ << 13; rng_ ^= rng_ >> 17; rng_ ^= rng_ << 5; // xorshift32
+        return rng_ % cfg_.ways;
+    }
+    return 0;
+}
+
+bool Cache::access(uint32_t addr, bool write) {
+    uint32_t lineNo = addr >> lineShift_;
+    uint32_t set = lineNo & setMask_, base = set * cfg_.ways;
+    ++(write ? st_.writes : st_.reads);
+    for (uint32_t w = 0; w < cfg_.ways; ++w) {
+        if (tags_[base + w] != lineNo) continue;
+        touch(base, w);
+        if (write) {
+            if (cfg_.write == WritePolicy::WriteBack) dirty_[base + w] = 1;
+            else if (next_) next_->access(addr, true);
+        }
+        return true;
+    }
+    ++(write ? st_.writeMisses : st_.readMisses);
+    if (write && cfg_.write == WritePolicy::WriteThrough) { // no allocate
+        if (next_) next_->access(addr, true);
+        return false;
+    }
+    uint32_t w = victim(set);
+    if (tags_[base + w] != kInvalid && dirty_[base + w]) {
+        ++st_.writebacks;
+        if (next_) next_->access(tags_[base + w] << lineShift_, true);
+    }
+    if (next_) next_->access(addr, false); // line fill
+    tags_[base + w] = lineNo;
+    dirty_[base + w] = write;
+    touch(base, w);
+    return false;
+}
+
+CacheModel::CacheModel(uint32_t imageSize, const CacheConfig& icfg, const CacheConfig& dcfg,
+                       const CacheConfig* l2cfg)
+    : l2_(l2cfg ? new Cache(*l2cfg) : nullptr),
+      i_(icfg, l2_.get()), d_(dcfg, l2_.get()),
+      perPc_((imageSize >> 1) + 1) {}
+
+static void levelLine(std::ostream& os, const char* name, const Cache& c) {
+    const CacheStats& s = c.stats();
+    char buf[200];
+    std::snprintf(buf, sizeof(buf),
+                  "%s %s: %llu accesses (%llu reads, %llu writes), %llu misses, %.2f%% hit, %llu writebacks\n",
+                  name, describe(c.config()).c_str(), (unsigned long long)s.accesses(),
+                  (unsigned long long)s.reads, (unsigned long long)s.writes,
+                  (unsigned long long)s.misses(), 100.0 * s.hitRate(), (unsigned long long)s.writebacks);
+    os << buf;
+}
+
+void CacheModel::report(std::ostream& os, const Engine& eng, size_t top) const {
+    levelLine(os, "icache", i_);
+    levelLine(os, "dcache", d_);
+    if (l2_) levelLine(os, "l2", *l2_);
+
+    auto total = [&](uint32_t i) { return perPc_[i].fetch + perPc_[i].data; };
+    std::vector<uint32_t> slots;
+    for (uint32_t i = 0; i < perPc_.size(); ++i)
+        if (total(i)) slots.push_back(i);
+    size_t n = std::min(top, slots.size());
+    std::partial_sort(slots.begin(), slots.begin() + (std::ptrdiff_t)n, slots.end(),
+                      [&](uint32_t a, uint32_t b) { return total(a) != total(b) ? total(a) > total(b) : a < b; });
+    if (!n) return;
+    os << "top misses:     fetch      data  instruction\n";
+    char buf[64];
+    std::string line;
+    for (size_t k = 0; k < n; ++k) {
+        uint32_t pc = slots[k] << 1;
+        const Op& op = eng.opAt(pc);
+        std::snprintf(buf, sizeof(buf), "  %12llu %9llu  ", (unsigned long long)perPc_[slots[k]].fetch,
+                      (unsigned long long)perPc_[slots[k]].data);
+        line = buf;
+        appendDecoded(line, DecodedInstr{op.tag, op.rd, op.rs1, op.rs2, op.imm}, pc, op.word);
+        os << line << "\n";
+    }
+}
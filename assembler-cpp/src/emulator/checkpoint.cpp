@@ -0,0 +1,213 @@
+#include "emulator/checkpoint.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t kPage = GuestMemory::kPageSize;
+
+// Page packing: a byte-oriented LZ77 over one page. A token byte t < 0x80 is followed by
+// t + 1 literal bytes; t >= 0x80 copies (t & 0x7F) + kMinMatch bytes from a u16 distance
+// back (little-endian, 1..kPage), overlapping allowed, so runs of a byte cost 3 bytes per
+// 131. Matches are found through a hash of the next 4 bytes, one candidate per bucket.
+constexpr uint32_t kMinMatch = 4, kMaxMatch = 0x7F + kMinMatch, kMaxLiterals = 0x80;
+constexpr unsigned kHashBits = 12;
+
+uint32_t load32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+// Packs a page into out (kPage bytes); 0 if that would not make it smaller.
+size_t packPage(const uint8_t* in, uint8_t* out) {
+    uint16_t head[1u << kHashBits];
+    std::memset(head, 0xFF, sizeof(head));
+    size_t o = 0, lit = 0, i = 0;
+    auto literals = [&](size_t end) {
+        while (lit < end) {
+            size_t n = std::min<size_t>(end - lit, kMaxLiterals);
+            if (o + 1 + n >= kPage) return false;
+            out[o++] = (uint8_t)(n - 1);
+            std::memcpy(out + o, in + lit, n);
+            o += n; lit += n;
+        }
+        return true;
+    };
+    while (i + kMinMatch <= kPage) {
+        uint32_t w = load32(in + i), h = (w * 2654435761u) >> (32 - kHashBits);
+        uint32_t cand = head[h];
+        head[h] = (uint16_t)i;
+        if (cand == 0xFFFF || load32(in + cand) != w) { ++i; continue; }
+        size_t len = kMinMatch, room = std::min<size_t>(kMaxMatch, kPage - i);
+        while (len < room && in[cand + len] == in[i + len]) ++len;
+        if (!literals(i) || o + 3 >= kPage) return 0;
+        size_t dist = i - cand;
+        out[o++] = (uint8_t)(0x80 | (len - kMinMatch));
+        out[o++] = (uint8_t)dist;
+        out[o++] = (uint8_t)(dist >> 8);
+        i += len; lit = i;
+    }
+    return literals(kPage) ? o : 0;
+}
+
+bool unpackPage(const uint8_t* in, size_t n, uint8_t* out) {
+    size_t i = 0, o = 0;
+    while (i < n) {
+        uint8_t t = in[i++];
+        if (t < 0x80) {
+            size_t k = (size_t)t + 1;
+            if (i + k > n || o + k > kPage) return false;
+            std::memcpy(out + o, in + i, k);
+            i += k; o += k;
+        } else {
+            size_t k = (t & 0x7F) + kMinMatch;
+            if (i + 2 > n) return false;
+            size_t dist = in[i] | (size_t)in[i + 1] << 8;
+            i += 2;
+            if (dist == 0 || dist > o || o + k > kPage) return false;
+            for (size_t e = o + k; o < e; ++o) out[o] = out[o - dist];
+        }
+    }
+    return o == kPage;
+}
+
+bool isZero(const uint8_t* p) {
+    static const uint8_t zero[kPage] = {};
+    return std::memcmp(p, zero, kPage) == 0;
+}
+
+// FNV-1a, 32-bit.
+uint32_t fnv(uint32_t h, const void* data, size_t n) {
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t k = 0; k < n; ++k) h = (h ^ p[k]) * 16777619u;
+    return h;
+}
+constexpr uint32_t kFnvBasis = 2166136261u;
+
+} // namespace
+
+CheckpointWriter::~CheckpointWriter() { wait(); }
+
+void CheckpointWriter::start(Engine& eng, uint64_t instret, const std::string& path) {
+    wait();
+    auto t0 = std::chrono::steady_clock::now();
+    CheckpointHeader hdr;
+    hdr.instret = instret;
+    hdr.memSize = eng.memory().size();
+    hdr.imageSize = eng.imageSize();
+    std::memcpy(hdr.x, eng.hart().x, sizeof(hdr.x));
+    hdr.pc = eng.hart().pc;
+    std::vector<GuestMemory::SharedPage> pages = eng.memory().sharePages();
+    stats_ = CheckpointStats{};
+    stats_.instret = instret;
+    stats_.pauseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    thread_ = std::thread(&CheckpointWriter::write, this, hdr, std::move(pages), path);
+}
+
+bool CheckpointWriter::wait() {
+    if (thread_.joinable()) thread_.join();
+    return ok_;
+}
+
+void CheckpointWriter::write(CheckpointHeader hdr, std::vector<GuestMemory::SharedPage> pages, std::string path) {
+    auto t0 = std::chrono::steady_clock::now();
+    ok_ = false;
+    std::string tmp = path + ".tmp";
+    std::FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) { err_ = "cannot write " + tmp; return; }
+    // Page records follow the header, whose page count is only known at the end.
+    bool good = std::fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    uint32_t hash = kFnvBasis;
+    std::vector<uint8_t> packed(kPage);
+    for (GuestMemory::SharedPage& sp : pages) {
+        const uint8_t* data = sp.data();
+        if (isZero(data)) { ++stats_.zeroPages; sp.release(); continue; }
+        size_t n = packPage(data, packed.data());
+        CheckpointPage rec{sp.vpn(), n ? (uint32_t)n : kPage};
+        const uint8_t* body = n ? packed.data() : data;
+        hash = fnv(fnv(hash, &rec, sizeof(rec)), body, rec.size);
+        good = good && std::fwrite(&rec, sizeof(rec), 1, f) == 1 && std::fwrite(body, 1, rec.size, f) == rec.size;
+        ++hdr.pages;
+        stats_.fileBytes += sizeof(rec) + rec.size;
+        sp.release(); // the engine can write this page in place again
+    }
+    stats_.pages = hdr.pages;
+    stats_.rawBytes = (uint64_t)hdr.pages * kPage;
+    stats_.fileBytes += sizeof(hdr) + sizeof(hash);
+    hash = fnv(fnv(kFnvBasis, &hdr, sizeof(hdr)), &hash, sizeof(hash)); // header last: it was patched
+    good = good && std::fwrite(&hash, sizeof(hash), 1, f) == 1 && std::fseek(f, 0, SEEK_SET) == 0
+           && std::fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    good = std::fclose(f) == 0 && good;
+    if (!good || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        err_ = "cannot write " + path;
+        return;
+    }
+    stats_.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    ok_ = true;
+}
+
+bool saveCheckpoint(Engine& eng, uint64_t instret, const std::string& path, std::string& err) {
+    CheckpointWriter w;
+    w.start(eng, instret, path);
+    if (!w.wait()) { err = w.error(); return false; }
+    return true;
+}
+
+std::unique_ptr<Engine> loadCheckpoint(const std::string& path, uint64_t& instret, std::string& err) {
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) { err = "cannot read " + path; return nullptr; }
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> close(f, &std::fclose);
+    CheckpointHeader hdr;
+    if (std::fread(&hdr, sizeof(hdr), 1, f) != 1 || std::memcmp(hdr.magic, "RVCK", 4) != 0) {
+        err = path + ": not a checkpoint";
+        return nullptr;
+    }
+    if (hdr.version != CheckpointHeader{}.version) {
+        err = path + ": checkpoint version " + std::to_string(hdr.version) + ", expected "
+              + std::to_string(CheckpointHeader{}.version);
+        return nullptr;
+    }
+    if (hdr.memSize == 0 || hdr.memSize > (1ull << 32) || hdr.imageSize > hdr.memSize
+        || (uint64_t)hdr.pages * kPage > hdr.memSize) {
+        err = path + ": bad memory size";
+        return nullptr;
+    }
+    auto corrupt = [&]() { err = path + ": corrupt checkpoint"; return nullptr; };
+    // Pages first: the image the engine is built from is the start of RAM.
+    uint32_t hash = kFnvBasis;
+    std::vector<uint32_t> vpns(hdr.pages);
+    std::vector<uint8_t> ram((size_t)hdr.pages * kPage), packed(kPage);
+    for (uint32_t k = 0; k < hdr.pages; ++k) {
+        CheckpointPage rec;
+        if (std::fread(&rec, sizeof(rec), 1, f) != 1 || rec.size == 0 || rec.size > kPage
+            || (uint64_t)rec.vpn * kPage >= hdr.memSize || std::fread(packed.data(), 1, rec.size, f) != rec.size)
+            return corrupt();
+        hash = fnv(fnv(hash, &rec, sizeof(rec)), packed.data(), rec.size);
+        uint8_t* page = &ram[(size_t)k * kPage];
+        if (rec.size == kPage) std::memcpy(page, packed.data(), kPage);
+        else if (!unpackPage(packed.data(), rec.size, page)) return corrupt();
+        vpns[k] = rec.vpn;
+    }
+    uint32_t stored;
+    hash = fnv(fnv(kFnvBasis, &hdr, sizeof(hdr)), &hash, sizeof(hash));
+    if (std::fread(&stored, sizeof(stored), 1, f) != 1 || stored != hash) return corrupt();
+
+    std::vector<uint8_t> image(hdr.imageSize, 0);
+    for (uint32_t k = 0; k < hdr.pages; ++k) {
+        uint64_t at = (uint64_t)vpns[k] * kPage;
+        if (at < hdr.imageSize)
+            std::memcpy(&image[at], &ram[(size_t)k * kPage], std::min<uint64_t>(kPage, hdr.imageSize - at));
+    }
+    std::unique_ptr<Engine> eng(new Engine(image, hdr.memSize));
+    for (uint32_t k = 0; k < hdr.pages; ++k) eng->memory().write(vpns[k] * kPage, &ram[(size_t)k * kPage], kPage);
+    std::memcpy(eng->hart().x, hdr.x, sizeof(hdr.x));
+    eng->hart().x[0] = 0;
+    eng->hart().pc = hdr.pc;
+    instret = hdr.instret;
+    return eng;
+}
@@ -0,0 +1,109 @@
+#include "emulator/engine.h"
+#include "decoder/decoder.h"
+#include <algorithm>
+
+const char* stopReasonStr(StopReason r) {
+    switch (r) {
+    case StopReason::Halted:       return "halted (jump to self)";
+    case StopReason::EndOfImage:   return "end of image";
+    case StopReason::PcOutOfImage: return "pc outside the image";
+    case StopReason::Budget:       return "instruction budget exhausted";
+    case StopReason::MemFault:     return "memory access out of range";
+    case StopReason::Illegal:      return "illegal instruction";
+    }
+    return "?";
+}
+
+const char* fusionName(Fusion f) {
+    switch (f) {
+    case Fusion::None:       return "none";
+    case Fusion::LuiAddi:    return "lui+addi";
+    case Fusion::AuipcJalr:  return "auipc+jalr";
+    case Fusion::AuipcLw:    return "auipc+lw";
+    case Fusion::AddiBranch: return "addi+branch";
+    }
+    return "?";
+}
+
+Engine::Engine(const std::vector<uint8_t>& image, uint64_t memSize)
+    : mem_(std::min(kMaxMem, std::max<uint64_t>(memSize, image.size()))),
+      codeEnd_((uint32_t)image.size() & ~1u),
+      ops_((codeEnd_ >> 1) + 1) {
+    mem_.write(0, image.data(), image.size());
+    predecode(0, codeEnd_);
+}
+
+void Engine::predecode(uint32_t from, uint32_t to) {
+    // Every 16-bit slot is decoded, so a jump into the middle of a 32-bit word runs whatever
+    // that parcel encodes, like hardware would.
+    to = std::min(to, codeEnd_);
+    for (uint32_t pc = from & ~1u; pc < to; pc += 2) {
+        Op& op = ops_[pc >> 1];
+        uint16_t lo = mem_.fetch16(pc);
+        DecodedInstr di;
+        bool ok;
+        if (instrLength(lo) == 2) {
+            op.len = 2; op.word = lo;
+            ok = decodeCompressed(lo, di);
+        } else {
+            op.len = 4; op.word = lo | ((uint32_t)mem_.fetch16(pc + 2) << 16);
+            ok = pc + 4 <= codeEnd_ && decodeInstr(op.word, di);
+        }
+        if (!ok) di = DecodedInstr{TAG_INVALID, 0, 0, 0, 0};
+        op.tag = di.tag; op.rd = di.rd; op.rs1 = di.rs1; op.rs2 = di.rs2; op.imm = di.imm;
+    }
+    // A pair can start up to one 32-bit instruction before the range.
+    fuse(from > 4 ? from - 4 : 0, to);
+}
+
+void Engine::fuse(uint32_t from, uint32_t to) {
+    to = std::min(to, codeEnd_);
+    for (uint32_t pc = from & ~1u; pc < to; pc += 2) {
+        Op& op = ops_[pc >> 1];
+        op.fuse = Fusion::None;
+        uint32_t pc2 = pc + op.len;
+        if (!fusion_ || op.rd == 0 || pc2 >= codeEnd_) continue;
+        const Op& op2 = ops_[pc2 >> 1];
+        bool reads = op2.rs1 == op.rd;
+        switch (op.tag) {
+        case TAG_LUI:
+            if (op2.tag == TAG_ADDI && reads) op.fuse = Fusion::LuiAddi;
+            break;
+        case TAG_AUIPC:
+            if (op2.tag == TAG_JALR && reads) op.fuse = Fusion::AuipcJalr;
+            else if (op2.tag == TAG_LW && reads) op.fuse = Fusion::AuipcLw;
+            break;
+        case TAG_ADDI:
+            if ((op2.tag == TAG_BEQ || op2.tag == TAG_BNE) && (reads || op2.rs2 == op.rd)) op.fuse = Fusion::AddiBranch;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+bool Engine::write(uint32_t addr, const uint8_t* src, size_t n) {
+    if (!mem_.write(addr, src, n)) return false;
+    if (n && addr < codeEnd_) predecode(addr > 2 ? addr - 2 : 0, (uint32_t)std::min<uint64_t>((uint64_t)addr + n, codeEnd_));
+    return true;
+}
+
+void Engine::setFusion(bool on) {
+    fusion_ = on;
+    fuse(0, codeEnd_);
+}
+
+void Engine::snapshot() {
+    mem_.snapshot();
+    saved_ = h_;
+}
+
+void Engine::restore() {
+    const uint32_t kPage = GuestMemory::kPageSize;
+    std::vector<uint32_t> code;
+    for (uint32_t vpn : mem_.dirtyPages())
+        if ((uint64_t)vpn * kPage < codeEnd_) code.push_back(vpn);
+    mem_.restore();
+    for (uint32_t vpn : code) predecode(vpn * kPage > 2 ? vpn * kPage - 2 : 0, vpn * kPage + kPage);
+    h_ = saved_;
+}
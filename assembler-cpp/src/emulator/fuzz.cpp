@@ -0,0 +1,139 @@
+#include "emulator/fuzz.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+
+namespace {
+
+uint8_t bucket(uint8_t hits) {
+    if (hits <= 2) return hits;
+    if (hits == 3) return 4;
+    if (hits < 8) return 8;
+    if (hits < 16) return 16;
+    if (hits < 32) return 32;
+    return hits < 128 ? 64 : 128;
+}
+
+bool isCrash(StopReason r) {
+    return r == StopReason::MemFault || r == StopReason::Illegal || r == StopReason::PcOutOfImage;
+}
+
+const uint32_t kInteresting[] = {0, 1, 16, 32, 64, 0x100, 0xFFFF, 0x7FFFFFFF, 0x80000000u, 0xFFFFFFFFu};
+
+} // namespace
+
+void EdgeCoverage::clear() {
+    for (uint32_t i : touched_) hits_[i] = 0;
+    touched_.clear();
+}
+
+bool EdgeCoverage::merge(std::vector<uint8_t>& seen) const {
+    bool fresh = false;
+    for (uint32_t i : touched_) {
+        uint8_t b = bucket(hits_[i]);
+        if (b & ~seen[i]) { seen[i] |= b; fresh = true; }
+    }
+    return fresh;
+}
+
+Fuzzer::Fuzzer(Engine& eng, const FuzzConfig& cfg)
+    : eng_(eng), cfg_(cfg), seen_(1u << EdgeCoverage::kMapBits, 0),
+      corpus_{std::vector<uint8_t>(cfg.inputLen, 0)}, rng_(cfg.seed ? cfg.seed : 1) {}
+
+bool Fuzzer::boot(uint64_t budget) {
+    for (uint64_t n = 0; eng_.hart().pc != cfg_.entry; ++n) {
+        if (n == budget || eng_.run(1).reason != StopReason::Budget) return false;
+    }
+    eng_.snapshot();
+    return true;
+}
+
+RunResult Fuzzer::execute(const std::vector<uint8_t>& input) {
+    stats_.dirtyPages += eng_.memory().dirtyPages().size();
+    eng_.restore();
+    eng_.write(cfg_.inputAddr, input.data(), input.size()); // re-predecodes any code it covers
+    eng_.hart().x[10] = cfg_.inputAddr;
+    eng_.hart().x[11] = (uint32_t)input.size();
+    cov_.clear();
+    RunResult r = eng_.run(cfg_.budget, cov_);
+    ++stats_.execs;
+    stats_.instrs += r.instrs;
+    return r;
+}
+
+void Fuzzer::mutate(std::vector<uint8_t>& in) {
+    if (in.empty()) return;
+    for (unsigned k = 1 + rand() % 4; k; --k) {
+        size_t pos = rand() % in.size();
+        unsigned how = rand() % 5;
+        switch (how) {
+        case 0: in[pos] ^= (uint8_t)(1u << (rand() % 8)); break;
+        case 1: in[pos] = (uint8_t)rand(); break;
+        case 2: case 3: { // guests compare whole words: set one or nudge it
+            if (in.size() < 4) break;
+            size_t at = (rand() % (in.size() / 4)) * 4;
+            uint32_t w;
+            std::memcpy(&w, &in[at], 4);
+            if (how == 2) w = kInteresting[rand() % (sizeof(kInteresting) / sizeof(kInteresting[0]))];
+            else w += (rand() & 1) ? 1 + rand() % 35 : -(uint32_t)(1 + rand() % 35);
+            std::memcpy(&in[at], &w, 4);
+            break;
+        }
+        default: { // splice: the same range from another corpus entry
+            const std::vector<uint8_t>& o = corpus_[rand() % corpus_.size()];
+            if (o.size() > pos)
+                std::memcpy(&in[pos], &o[pos], std::min({o.size() - pos, in.size() - pos, (size_t)(1 + rand() % 16)}));
+            break;
+        }
+        }
+    }
+}
+
+void Fuzzer::run(uint64_t execs) {
+    auto t0 = std::chrono::steady_clock::now();
+    if (stats_.execs == 0) { // the seed itself
+        execute(corpus_[0]);
+        cov_.merge(seen_);
+    }
+    std::vector<uint8_t> in;
+    for (uint64_t k = 0; k < execs; ++k) {
+        in = corpus_[rand() % corpus_.size()];
+        mutate(in);
+        RunResult r = execute(in);
+        if (isCrash(r.reason)) {
+            auto it = std::find_if(crashes_.begin(), crashes_.end(), [&](const FuzzCrash& c) {
+                return c.reason == r.reason && c.pc == r.pc;
+            });
+            if (it == crashes_.end()) crashes_.push_back(FuzzCrash{r.reason, r.pc, r.addr, 1, in});
+            else ++it->hits;
+            cov_.merge(seen_);
+            continue;
+        }
+        if (r.reason == StopReason::Budget) ++stats_.hangs;
+        if (cov_.merge(seen_)) corpus_.push_back(in);
+    }
+    stats_.edges = (size_t)std::count_if(seen_.begin(), seen_.end(), [](uint8_t b) { return b != 0; });
+    stats_.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+void Fuzzer::report(std::ostream& os) const {
+    char buf[160];
+    double s = stats_.seconds > 0 ? stats_.seconds : 1e-9;
+    std::snprintf(buf, sizeof(buf), "fuzz: %llu execs in %.3f s (%.0f execs/s, %.1f MIPS), %.2f dirty pages per reset\n",
+                  (unsigned long long)stats_.execs, stats_.seconds, stats_.execs / s, stats_.instrs / s / 1e6,
+                  stats_.execs ? (double)stats_.dirtyPages / stats_.execs : 0.0);
+    os << buf;
+    std::snprintf(buf, sizeof(buf), "coverage: %zu edges, %zu inputs in corpus, %llu hangs, %zu unique crashes\n",
+                  stats_.edges, corpus_.size(), (unsigned long long)stats_.hangs, crashes_.size());
+    os << buf;
+    for (const FuzzCrash& c : crashes_) {
+        std::snprintf(buf, sizeof(buf), "crash: %s at pc 0x%08x", stopReasonStr(c.reason), c.pc);
+        os << buf;
+        if (c.reason == StopReason::MemFault) { std::snprintf(buf, sizeof(buf), " (address 0x%08x)", c.addr); os << buf; }
+        os << ", " << c.hits << " hits, input";
+        for (uint8_t b : c.input) { std::snprintf(buf, sizeof(buf), " %02x", b); os << buf; }
+        os << "\n";
+    }
+}
@@ -0,0 +1,176 @@
+#include "emulator/guest_memory.h"
+#include <algorithm>
+
+namespace {
+
+// What untouched RAM reads as; read TLB entries point here until the page is written.
+alignas(64) const uint8_t kZeroPage[GuestMemory::kPageSize] = {};
+
+} // namespace
+
+GuestMemory::GuestMemory(uint64_t size)
+    : size_(std::min<uint64_t>((size + kPageSize - 1) & ~(uint64_t)(kPageSize - 1), 1ull << 32)),
+      dir_(1u << (32 - kPageBits - kDirBits)) {}
+
+GuestMemory::Page* GuestMemory::page(uint32_t vpn, bool create) {
+    std::unique_ptr<Table>& t = dir_[vpn >> kDirBits];
+    if (!t) {
+        if (!create) return nullptr;
+        t.reset(new Table());
+    }
+    return &t->pages[vpn & ((1u << kDirBits) - 1)];
+}
+
+const GuestMemory::Page* GuestMemory::page(uint32_t vpn) const {
+    const std::unique_ptr<Table>& t = dir_[vpn >> kDirBits];
+    return t ? &t->pages[vpn & ((1u << kDirBits) - 1)] : nullptr;
+}
+
+uint8_t* GuestMemory::writablePage(uint32_t vpn) {
+    if (!isRam(vpn)) return nullptr;
+    Page* p = page(vpn, true);
+    bool existed = p->ram != nullptr;
+    if (existed) unshare(vpn, *p);
+    else {
+        p->ram = std::make_shared<PageData>(); // zeroed
+        ++pages_;
+        TlbEntry& r = rtlb_[vpn & (kTlbEntries - 1)];
+        if (r.vpn == vpn) r.host = p->ram->bytes; // was the zero page
+    }
+    if (tracking_ && !p->dirty) {
+        p->dirty = true;
+        p->savedZero = !existed;
+        if (existed) {
+            if (!p->saved) p->saved.reset(new uint8_t[kPageSize]);
+            std::memcpy(p->saved.get(), p->ram->bytes, kPageSize);
+        }
+        dirty_.push_back(vpn);
+    }
+    return p->ram->bytes;
+}
+
+void GuestMemory::unshare(uint32_t vpn, Page& p) {
+    // Acquire pairs with SharedPage::release(): seeing no readers means their reads of the
+    // page happened before our writes. Seeing a stale count only costs a copy.
+    if (p.ram->readers.load(std::memory_order_acquire) == 0) return;
+    std::shared_ptr<PageData> copy(new PageData);
+    std::memcpy(copy->bytes, p.ram->bytes, kPageSize);
+    p.ram = std::move(copy); // readers keep the old one alive
+    for (TlbEntry* t : {rtlb_, wtlb_}) {
+        TlbEntry& e = t[vpn & (kTlbEntries - 1)];
+        if (e.vpn == vpn) e.host = p.ram->bytes;
+    }
+}
+
+std::vector<GuestMemory::SharedPage> GuestMemory::sharePages() {
+    std::vector<SharedPage> out;
+    out.reserve(pages_);
+    for (uint32_t d = 0; d < dir_.size(); ++d) {
+        if (!dir_[d]) continue;
+        for (uint32_t k = 0; k < (1u << kDirBits); ++k)
+            if (const Page& p = dir_[d]->pages[k]; p.ram) {
+                p.ram->readers.fetch_add(1, std::memory_order_relaxed); // published by starting the reader
+                out.emplace_back(d << kDirBits | k, p.ram);
+            }
+    }
+    // Writes have to find out that a page is shared now.
+    for (TlbEntry& e : wtlb_) e = TlbEntry{};
+    return out;
+}
+
+void GuestMemory::snapshot() {
+    for (uint32_t vpn : dirty_) page(vpn, false)->dirty = false;
+    dirty_.clear();
+    // Pages written before now may sit in the write TLB; their next write must be seen.
+    for (TlbEntry& e : wtlb_) e = TlbEntry{};
+    tracking_ = true;
+}
+
+void GuestMemory::restore() {
+    for (uint32_t vpn : dirty_) {
+        Page* p = page(vpn, false);
+        unshare(vpn, *p);
+        if (p->savedZero) std::memset(p->ram->bytes, 0, kPageSize);
+        else std::memcpy(p->ram->bytes, p->saved.get(), kPageSize);
+        p->dirty = false;
+        TlbEntry& w = wtlb_[vpn & (kTlbEntries - 1)];
+        if (w.vpn == vpn) w = TlbEntry{};
+    }
+    dirty_.clear();
+}
+
+bool GuestMemory::loadSlow(uint32_t addr, uint32_t& v) {
+    ++misses_;
+    uint32_t vpn = addr >> kPageBits, off = addr & (kPageSize - 1);
+    if (off > kPageSize - 4) { // crosses into the next page: RAM only
+        uint8_t b[4];
+        if (!read(addr, b, 4)) return false;
+        std::memcpy(&v, b, 4);
+        return true;
+    }
+    const Page* p = page(vpn);
+    if (p && p->dev) return p->dev->read32(addr - p->devBase, v);
+    if (!isRam(vpn)) return false;
+    TlbEntry& e = rtlb_[vpn & (kTlbEntries - 1)];
+    e.vpn = vpn;
+    e.host = p && p->ram ? p->ram->bytes : const_cast<uint8_t*>(kZeroPage);
+    std::memcpy(&v, e.host + off, 4);
+    return true;
+}
+
+bool GuestMemory::storeSlow(uint32_t addr, uint32_t v) {
+    ++misses_;
+    uint32_t vpn = addr >> kPageBits, off = addr & (kPageSize - 1);
+    if (off > kPageSize - 4) {
+        uint8_t b[4];
+        std::memcpy(b, &v, 4);
+        return write(addr, b, 4);
+    }
+    Page* p = page(vpn, false);
+    if (p && p->dev) return p->dev->write32(addr - p->devBase, v);
+    uint8_t* host = writablePage(vpn);
+    if (!host) return false;
+    TlbEntry& e = wtlb_[vpn & (kTlbEntries - 1)];
+    e.vpn = vpn;
+    e.host = host;
+    std::memcpy(host + off, &v, 4);
+    return true;
+}
+
+bool GuestMemory::write(uint32_t addr, const uint8_t* src, size_t n) {
+    if ((uint64_t)addr + n > size_) return false;
+    while (n) {
+        uint32_t off = addr & (kPageSize - 1);
+        size_t k = std::min<size_t>(n, kPageSize - off);
+        std::memcpy(writablePage(addr >> kPageBits) + off, src, k);
+        addr += (uint32_t)k; src += k; n -= k;
+    }
+    return true;
+}
+
+bool GuestMemory::read(uint32_t addr, uint8_t* dst, size_t n) const {
+    if ((uint64_t)addr + n > size_) return false;
+    while (n) {
+        uint32_t off = addr & (kPageSize - 1);
+        size_t k = std::min<size_t>(n, kPageSize - off);
+        const Page* p = page(addr >> kPageBits);
+        std::memcpy(dst, p && p->ram ? p->ram->bytes + off : kZeroPage, k);
+        addr += (uint32_t)k; dst += k; n -= k;
+    }
+    return true;
+}
+
+bool GuestMemory::mapMmio(uint32_t base, uint32_t size, MmioDevice& dev) {
+    if (!size || (base | size) & (kPageSize - 1) || (uint64_t)base + size > (1ull << 32)) return false;
+    uint32_t first = base >> kPageBits, count = size >> kPageBits;
+    for (uint32_t k = 0; k < count; ++k) {
+        const Page* p = page(first + k);
+        if (isRam(first + k) || (p && p->dev)) return false;
+    }
+    for (uint32_t k = 0; k < count; ++k) {
+        Page* p = page(first + k, true);
+        p->dev = &dev;
+        p->devBase = base;
+    }
+    return true;
+}
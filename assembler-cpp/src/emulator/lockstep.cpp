@@ -0,0 +1,253 @@
+#include "emulator/lockstep.h"
+#include <algorithm>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LOCKSTEP_X86 1
+#endif
+
+// One register across all lanes. GCC/Clang vector arithmetic compiles to whatever the
+// enclosing function targets: 256-bit AVX2 ops in the AVX2 kernel, SSE2 pairs otherwise.
+// Vectors are only passed by reference, which keeps the baseline ABI unchanged.
+typedef uint32_t u32x8 __attribute__((vector_size(32), may_alias));
+static_assert(sizeof(u32x8) == LockstepEngine::kLanes * sizeof(uint32_t), "one vector per register");
+
+namespace {
+
+constexpr unsigned kAll = (1u << LockstepEngine::kLanes) - 1;
+
+#if LOCKSTEP_X86
+__attribute__((target("avx2"))) inline unsigned laneBitsAvx2(const u32x8& m) {
+    return (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_load_si256((const __m256i*)&m)));
+}
+// dst[l] = 4 bytes at base + idx[l] for lanes set in mask; other lanes keep dst.
+__attribute__((target("avx2"))) inline void gatherAvx2(u32x8& dst, const uint8_t* base, const u32x8& idx,
+                                                      const u32x8& mask) {
+    __m256i v = _mm256_mask_i32gather_epi32(_mm256_load_si256((const __m256i*)&dst), (const int*)base,
+                                            _mm256_load_si256((const __m256i*)&idx),
+                                            _mm256_load_si256((const __m256i*)&mask), 1);
+    _mm256_store_si256((__m256i*)&dst, v);
+}
+#endif
+
+template<bool Avx2> inline unsigned laneBits(const u32x8& m) {
+#if LOCKSTEP_X86
+    if constexpr (Avx2) return laneBitsAvx2(m);
+#endif
+    unsigned b = 0;
+    for (unsigned l = 0; l < LockstepEngine::kLanes; ++l) b |= (m[l] >> 31) << l;
+    return b;
+}
+
+template<bool Avx2> inline void gather(u32x8& dst, const uint8_t* base, const u32x8& idx, const u32x8& mask,
+                                       unsigned lanes) {
+#if LOCKSTEP_X86
+    if constexpr (Avx2) { gatherAvx2(dst, base, idx, mask); return; }
+#endif
+    (void)mask;
+    for (; lanes; lanes &= lanes - 1) {
+        unsigned l = (unsigned)__builtin_ctz(lanes);
+        std::memcpy(&dst[l], base + idx[l], 4);
+    }
+}
+
+inline void maskOf(u32x8& m, unsigned lanes) {
+    for (unsigned l = 0; l < LockstepEngine::kLanes; ++l) m[l] = (lanes >> l & 1) ? ~0u : 0u;
+}
+
+bool cpuHasAvx2() {
+#if LOCKSTEP_X86
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+} // namespace
+
+struct LockstepKernel {
+    template<bool Avx2> __attribute__((always_inline)) static inline void run(LockstepEngine& e, uint64_t budget);
+};
+
+template<bool Avx2>
+inline void LockstepKernel::run(LockstepEngine& e, uint64_t budget) {
+    constexpr unsigned L = LockstepEngine::kLanes;
+    u32x8* x = (u32x8*)e.x_;
+    const Op* ops = e.ops_.data();
+    uint8_t* mem = e.mem_.data();
+    const uint32_t codeEnd = e.codeEnd_, memLast = e.memSize_ - 4;
+    u32x8 laneBase;
+    for (unsigned l = 0; l < L; ++l) laneBase[l] = l * e.memSize_;
+
+    uint64_t count[L] = {};
+    unsigned live = kAll;
+    // Stops lanes before the instruction at `at` (MemFault/Illegal/end of image/budget) or
+    // after it retired (Halted), with `n` instructions since their last count update.
+    auto stop = [&](unsigned lanes, StopReason why, uint32_t at, uint64_t n, const u32x8* addr) {
+        for (; lanes; lanes &= lanes - 1) {
+            unsigned l = (unsigned)__builtin_ctz(lanes);
+            count[l] += n;
+            e.res_[l] = RunResult{why, count[l], at, addr ? (*addr)[l] : 0};
+            e.pc_[l] = at;
+        }
+    };
+
+    while (live) {
+        // The group: live lanes at the lowest pc. It runs until a lane would reach the budget,
+        // its lanes diverge or stop, or it reaches the pc of a waiting lane.
+        uint32_t pc = UINT32_MAX, wait = UINT32_MAX;
+        for (unsigned l = 0; l < L; ++l) if (live >> l & 1) pc = std::min(pc, e.pc_[l]);
+        unsigned active = 0;
+        uint64_t left = UINT64_MAX;
+        for (unsigned l = 0; l < L; ++l) {
+            if (!(live >> l & 1)) continue;
+            if (e.pc_[l] == pc) { active |= 1u << l; left = std::min(left, budget - count[l]); }
+            else wait = std::min(wait, e.pc_[l]);
+        }
+        u32x8 act;
+        maskOf(act, active);
+        uint64_t n = 0;
+        unsigned split = 0;   // lanes (of active) whose pc is set per lane in target[]
+        u32x8 target = {};
+
+        for (;;) {
+            if (n == left) {
+                unsigned done = 0;
+                for (unsigned l = 0; l < L; ++l) if ((active >> l & 1) && count[l] + n == budget) done |= 1u << l;
+                stop(done, StopReason::Budget, pc, n, nullptr);
+                live &= ~done; active &= ~done;
+                break;
+            }
+            if (pc >= codeEnd) {
+                stop(active, pc == codeEnd ? StopReason::EndOfImage : StopReason::PcOutOfImage, pc, n, nullptr);
+                live &= ~active; active = 0;
+                break;
+            }
+            const Op& op = ops[pc >> 1];
+            uint32_t next = pc + op.len;
+            u32x8& rd = x[op.rd];
+            switch (op.tag) {
+            case TAG_ADD:   rd = ((x[op.rs1] + x[op.rs2]) & act) | (rd & ~act); break;
+            case TAG_SUB:   rd = ((x[op.rs1] - x[op.rs2]) & act) | (rd & ~act); break;
+            case TAG_ADDI:  rd = ((x[op.rs1] + (uint32_t)op.imm) & act) | (rd & ~act); break;
+            case TAG_LUI:   rd = (act & (uint32_t)op.imm) | (rd & ~act); break;
+            case TAG_AUIPC: rd = (act & (pc + (uint32_t)op.imm)) | (rd & ~act); break;
+            case TAG_LW: case TAG_SW: {
+                u32x8 a = x[op.rs1] + (uint32_t)op.imm;
+                u32x8 bad = (u32x8)(a > memLast);
+                if (op.tag == TAG_SW) bad |= (u32x8)(a < codeEnd); // code is shared: read-only
+                if (unsigned f = laneBits<Avx2>(bad & act)) {
+                    stop(f, StopReason::MemFault, pc, n, &a);
+                    live &= ~f; active &= ~f;
+                    maskOf(act, active);
+                    if (!active) goto regroup;
+                }
+                u32x8 idx = a + laneBase;
+                if (op.tag == TAG_LW) {
+                    gather<Avx2>(rd, mem, idx, act, active);
+                } else {
+                    for (unsigned s = active; s; s &= s - 1) {
+                        unsigned l = (unsigned)__builtin_ctz(s);
+                        std::memcpy(mem + idx[l], &x[op.rs2][l], 4);
+                    }
+                }
+                break;
+            }
+            case TAG_BEQ: case TAG_BNE: {
+                uint32_t t = pc + (uint32_t)op.imm;
+                unsigned eq = laneBits<Avx2>((u32x8)(x[op.rs1] == x[op.rs2])) & active;
+                unsigned taken = op.tag == TAG_BEQ ? eq : active & ~eq;
+                if (taken == active) next = t;
+                else if (taken) { split = active; maskOf(target, taken); target = (target & t) | (~target & next); }
+                break;
+            }
+            case TAG_JAL:
+                rd = (act & next) | (rd & ~act);
+                next = pc + (uint32_t)op.imm;
+                break;
+            case TAG_JALR: {
+                u32x8 t = (x[op.rs1] + (uint32_t)op.imm) & ~1u;
+                rd = (act & next) | (rd & ~act);
+                unsigned l0 = (unsigned)__builtin_ctz(active);
+                if ((laneBits<Avx2>((u32x8)(t == t[l0])) & active) != active) { split = active; target = t; }
+                else next = t[l0];
+                break;
+            }
+            default:
+                stop(active, StopReason::Illegal, pc, n, nullptr);
+                live &= ~active; active = 0;
+                goto regroup;
+            }
+            x[0] = u32x8{};
+            ++n;
+            if (split) {
+                // Divergent branch or JALR: each lane continues at its own target.
+                unsigned halted = laneBits<Avx2>((u32x8)(target == pc)) & split;
+                stop(halted, StopReason::Halted, pc, n, nullptr);
+                live &= ~halted; active &= ~halted;
+                for (unsigned s = active; s; s &= s - 1) {
+                    unsigned l = (unsigned)__builtin_ctz(s);
+                    count[l] += n;
+                    e.pc_[l] = target[l];
+                }
+                active = 0;
+                break;
+            }
+            if (next == pc) {
+                stop(active, StopReason::Halted, pc, n, nullptr);
+                live &= ~active; active = 0;
+                break;
+            }
+            pc = next;
+            if (pc >= wait) break; // merge with the lanes waiting here (or skipped past)
+        }
+    regroup:
+        for (unsigned s = active; s; s &= s - 1) {
+            unsigned l = (unsigned)__builtin_ctz(s);
+            count[l] += n;
+            e.pc_[l] = pc;
+        }
+        e.steps_ += n;
+    }
+}
+
+#if LOCKSTEP_X86
+__attribute__((target("avx2"))) static void runAvx2(LockstepEngine& e, uint64_t budget) {
+    LockstepKernel::run<true>(e, budget);
+}
+#endif
+
+static void runPortable(LockstepEngine& e, uint64_t budget) { LockstepKernel::run<false>(e, budget); }
+
+LockstepEngine::LockstepEngine(const std::vector<uint8_t>& image, uint32_t memSize)
+    : memSize_(std::min(kMaxMem, std::max({memSize, (uint32_t)image.size(), 4u}))),
+      codeEnd_((uint32_t)image.size() & ~1u),
+      mem_((size_t)memSize_ * kLanes, 0),
+      avx2_(cpuHasAvx2()) {
+    // Predecoding is Engine's; its ops are shared by every lane.
+    Engine code(image, (uint32_t)image.size());
+    ops_.resize((codeEnd_ >> 1) + 1);
+    for (uint32_t pc = 0; pc < codeEnd_; pc += 2) ops_[pc >> 1] = code.opAt(pc);
+    for (unsigned l = 0; l < kLanes; ++l) std::memcpy(laneMemory(l), image.data(), std::min<size_t>(image.size(), memSize_));
+}
+
+Hart LockstepEngine::hart(unsigned lane) const {
+    Hart h;
+    for (unsigned r = 0; r < 32; ++r) h.x[r] = x_[r][lane];
+    h.pc = pc_[lane];
+    return h;
+}
+
+void LockstepEngine::setHart(unsigned lane, const Hart& h) {
+    for (unsigned r = 1; r < 32; ++r) x_[r][lane] = h.x[r];
+    pc_[lane] = h.pc;
+}
+
+void LockstepEngine::setAvx2(bool on) { avx2_ = on && cpuHasAvx2(); }
+
+void LockstepEngine::run(uint64_t budget) {
+#if LOCKSTEP_X86
+    if (avx2_) { runAvx2(*this, budget); return; }
+#endif
+    runPortable(*this, budget);
+}
@@ -0,0 +1,444 @@
+// CLI: emulator in.bin [--max N] [--mem BYTES] [--regs] [--timing [--load-latency N]
+//      [--branch-penalty N]] [--cache [--icache SPEC] [--dcache SPEC] [--l2 SPEC]]
+//      [--bp KIND[:BITS],...|all [--btb N] [--ras N]] [--profile [--map FILE]] [--layout-profile FILE --map FILE]
+//      [--trace FILE]
+//      [--console ADDR] [--top N] [--stats] [--no-fuse] [--checkpoint FILE [--checkpoint-at N]] [--resume]
+//      emulator in.bin --sample [--interval N] [--warmup N] [--max-k N] [--per-cluster N] [--seed N]
+//      emulator in.bin --fuzz EXECS [--fuzz-addr ADDR] [--fuzz-len N] [--entry PC] [--seed N] [--max N]
+//      emulator in.bin --lanes STATES [--max N] [--mem BYTES] [--report FILE] [--stats]
+//      emulator --batch [--jobs N] [--max N] [--mem BYTES] [--report FILE] (in.bin | @LIST)...
+#include "emulator/batch.h"
+#include "emulator/cache.h"
+#include "emulator/checkpoint.h"
+#include "emulator/engine.h"
+#include "emulator/fuzz.h"
+#include "emulator/lockstep.h"
+#include "emulator/predict.h"
+#include "emulator/profile.h"
+#include "emulator/sample.h"
+#include "emulator/timing.h"
+#include "emulator/trace.h"
+#include "common/utils.h"
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+// SIGUSR1 asks a --checkpoint run for a checkpoint at the next slice boundary.
+volatile std::sig_atomic_t gCheckpointRequested = 0;
+extern "C" void onCheckpointSignal(int) { gCheckpointRequested = 1; }
+
+// The models selected on the command line, fanned out from one observer. Runs without any
+// use Engine::run's empty observer instead.
+struct Tools : NullObserver {
+    PipelineModel* timing = nullptr;
+    CacheModel* cache = nullptr;
+    BranchModel* branch = nullptr;
+    ProfileModel* profile = nullptr;
+    TraceWriter* trace = nullptr;
+
+    void memAccess(uint32_t pc, uint32_t addr, bool store) {
+        if (cache) cache->memAccess(pc, addr, store);
+        if (trace) trace->memAccess(pc, addr, store);
+    }
+    void control(uint32_t pc, const Op& op, bool taken, uint32_t target) {
+        if (timing) timing->control(pc, op, taken, target);
+        if (branch) branch->control(pc, op, taken, target);
+        if (profile) profile->control(pc, op, taken, target);
+    }
+    void retire(uint32_t pc, const Op& op) {
+        if (timing) timing->retire(pc, op);
+        if (cache) cache->retire(pc, op);
+        if (trace) trace->retire(pc, op);
+    }
+    int count() const { return !!timing + !!cache + !!branch + !!profile + !!trace; }
+};
+
+// --console ADDR: an MMIO page there prints the low byte of every word stored to it.
+struct Console : MmioDevice {
+    bool read32(uint32_t, uint32_t& v) override { v = 0; return true; }
+    bool write32(uint32_t, uint32_t v) override { std::putchar((int)(v & 0xFF)); return true; }
+};
+
+bool cacheArg(const char* spec, const char* name, CacheConfig& c) {
+    if (!parseCacheConfig(spec, c)) {
+        std::cerr << name << ": expected SIZE:WAYS:LINE[:lru|fifo|random][:wb|wt], got " << spec << "\n";
+        return false;
+    }
+    if (const char* why = cacheConfigError(c)) { std::cerr << name << ": " << why << "\n"; return false; }
+    return true;
+}
+
+// "gshare:14,tage" -> predictors; "all" is one of each at the default size.
+bool predictorsArg(std::string list, std::vector<std::unique_ptr<DirectionPredictor>>& out) {
+    if (list == "all") list = "static,bimodal,gshare,tage";
+    for (size_t p = 0; p <= list.size();) {
+        size_t q = std::min(list.find(',', p), list.size());
+        std::string item = list.substr(p, q - p), kind = item;
+        unsigned bits = 12;
+        size_t c = item.find(':');
+        if (c != std::string::npos) { kind = item.substr(0, c); bits = (unsigned)std::strtoul(item.c_str() + c + 1, nullptr, 10); }
+        auto pred = makePredictor(kind, bits);
+        if (!pred) { std::cerr << "--bp: unknown predictor " << kind << " (static|bimodal|gshare|tage|all)\n"; return false; }
+        out.push_back(std::move(pred));
+        p = q + 1;
+    }
+    return true;
+}
+
+// emulator --batch ...: every image on its own hart, all cores busy, one JSON report.
+// A @LIST file names one image per line, optionally followed by its instruction budget;
+// blank lines and lines starting with '#' are skipped.
+int batchMain(int argc, char** argv) {
+    BatchOptions opts;
+    std::vector<BatchJob> jobs;
+    std::string reportFile;
+    for (int i = 2; i < argc; i++) {
+        std::string a = argv[i];
+        auto num = [&]() { return std::strtoull(argv[++i], nullptr, 0); };
+        if (a == "--jobs" && i + 1 < argc) opts.threads = (unsigned)num();
+        else if (a == "--max" && i + 1 < argc) opts.budget = num();
+        else if (a == "--mem" && i + 1 < argc) opts.memSize = num();
+        else if (a == "--report" && i + 1 < argc) reportFile = argv[++i];
+        else if (a[0] == '@') {
+            std::ifstream f(a.substr(1));
+            if (!f) { std::cerr << "--batch: cannot read list " << a.substr(1) << "\n"; return 1; }
+            for (std::string line; std::getline(f, line);) {
+                std::istringstream ls(line);
+                BatchJob job;
+                if (!(ls >> job.path) || job.path[0] == '#') continue;
+                std::string b;
+                if (ls >> b) job.budget = std::strtoull(b.c_str(), nullptr, 0);
+                jobs.push_back(job);
+            }
+        } else jobs.push_back({a, 0});
+    }
+    if (jobs.empty()) { std::cerr << "--batch: no images\n"; return 64; }
+    if (opts.memSize > Engine::kMaxMem) { std::cerr << "--batch: --mem is at most " << Engine::kMaxMem << "\n"; return 64; }
+
+    BatchStats st;
+    std::vector<BatchResult> results = runBatch(jobs, opts, &st);
+    if (reportFile.empty()) writeBatchReport(std::cout, jobs, results, st);
+    else {
+        std::ofstream f(reportFile);
+        if (!f) { std::cerr << "open fail: " << reportFile << "\n"; return 4; }
+        writeBatchReport(f, jobs, results, st);
+    }
+    size_t ok = 0;
+    for (const auto& r : results)
+        ok += r.loaded && (r.run.reason == StopReason::Halted || r.run.reason == StopReason::EndOfImage);
+    std::fprintf(stderr, "batch: %zu/%zu programs finished, %llu instructions in %.3f s on %u threads"
+                 " (%.1f MIPS, %llu steals)\n", ok, results.size(), (unsigned long long)st.instrs,
+                 st.seconds, st.threads, st.seconds > 0 ? (double)st.instrs / st.seconds / 1e6 : 0.0,
+                 (unsigned long long)st.steals);
+    return ok == results.size() ? 0 : 1;
+}
+
+// emulator in.bin --lanes STATES: the image once per line of STATES, LockstepEngine::kLanes
+// at a time. A line sets a starting state as xN=VALUE / pc=VALUE words (the rest zero);
+// blank lines and lines starting with '#' are skipped. The report is --batch's, with one
+// entry per state named in.bin:LINE.
+int lanesMain(const std::string& inFile, const std::string& statesFile, uint64_t budget, uint64_t memSize,
+              const std::string& reportFile, bool stats) {
+    if (memSize > LockstepEngine::kMaxMem) { std::cerr << "--lanes: --mem is at most " << LockstepEngine::kMaxMem << " per lane\n"; return 64; }
+    auto image = readBinaryFile(inFile);
+    if (image.empty()) { std::cerr << "Empty or unreadable input.\n"; return 1; }
+    std::ifstream f(statesFile);
+    if (!f) { std::cerr << "--lanes: cannot read " << statesFile << "\n"; return 1; }
+    std::vector<BatchJob> jobs;
+    std::vector<Hart> states;
+    unsigned lineNo = 0;
+    for (std::string line; std::getline(f, line);) {
+        ++lineNo;
+        std::istringstream ls(line);
+        std::string w;
+        Hart h;
+        bool any = false;
+        while (ls >> w) {
+            if (w[0] == '#') break;
+            size_t eq = w.find('=');
+            unsigned r = 33;
+            if (eq != std::string::npos && w.compare(0, eq, "pc") == 0) r = 32;
+            else if (eq > 1 && eq != std::string::npos && w[0] == 'x') r = (unsigned)std::strtoul(w.c_str() + 1, nullptr, 10);
+            if (r > 32) { std::cerr << statesFile << ":" << lineNo << ": expected xN=VALUE or pc=VALUE, got " << w << "\n"; return 64; }
+            uint32_t v = (uint32_t)std::strtoull(w.c_str() + eq + 1, nullptr, 0);
+            if (r == 32) h.pc = v;
+            else if (r) h.x[r] = v;
+            any = true;
+        }
+        if (!any) continue;
+        states.push_back(h);
+        jobs.push_back({inFile + ":" + std::to_string(lineNo), budget});
+    }
+    if (jobs.empty()) { std::cerr << "--lanes: no states in " << statesFile << "\n"; return 64; }
+
+    const unsigned L = LockstepEngine::kLanes;
+    std::vector<BatchResult> results(jobs.size());
+    BatchStats st;
+    st.threads = 1;
+    uint64_t steps = 0;
+    bool avx2 = false;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t g = 0; g < states.size(); g += L) {
+        // A short last group fills its spare lanes with copies of its first state.
+        LockstepEngine eng(image, (uint32_t)memSize);
+        for (unsigned l = 0; l < L; ++l) eng.setHart(l, states[g + (g + l < states.size() ? l : 0)]);
+        eng.run(budget);
+        steps += eng.steps();
+        avx2 = eng.avx2();
+        for (unsigned l = 0; l < L && g + l < states.size(); ++l) {
+            results[g + l].loaded = true;
+            results[g + l].run = eng.result(l);
+            results[g + l].hart = eng.hart(l);
+            st.instrs += eng.result(l).instrs;
+        }
+    }
+    st.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (reportFile.empty()) writeBatchReport(std::cout, jobs, results, st);
+    else {
+        std::ofstream out(reportFile);
+        if (!out) { std::cerr << "open fail: " << reportFile << "\n"; return 4; }
+        writeBatchReport(out, jobs, results, st);
+    }
+    if (stats && st.seconds > 0)
+        std::fprintf(stderr, "lanes: %zu states, %llu instructions in %.3f s (%.1f MIPS, %s kernel), "
+                     "%.0f%% lane occupancy\n", states.size(), (unsigned long long)st.instrs, st.seconds,
+                     (double)st.instrs / st.seconds / 1e6, avx2 ? "AVX2" : "portable",
+                     steps ? 100.0 * st.instrs / ((double)steps * L) : 0.0);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc >= 2 && std::string(argv[1]) == "--batch") return batchMain(argc, argv);
+    if (argc < 2) {
+        std::cerr << "usage: emulator in.bin [--max N] [--mem BYTES] [--regs] [--timing [--load-latency N]"
+                     " [--branch-penalty N]] [--cache [--icache SPEC] [--dcache SPEC] [--l2 SPEC]]"
+                     " [--bp KIND[:BITS],...|all [--btb N] [--ras N]] [--profile [--map FILE]]"
+                     " [--layout-profile FILE --map FILE] [--trace FILE] [--console ADDR] [--top N] [--stats] [--no-fuse]"
+                     " [--checkpoint FILE [--checkpoint-at N]] [--resume]\n"
+                     "       emulator in.bin --sample [--interval N] [--warmup N] [--max-k N] [--per-cluster N]"
+                     " [--seed N] [timing options] [--max N]\n"
+                     "       emulator in.bin --fuzz EXECS [--fuzz-addr ADDR] [--fuzz-len N] [--entry PC]"
+                     " [--seed N] [--max N]\n"
+                     "       emulator in.bin --lanes STATES [--max N] [--mem BYTES] [--report FILE] [--stats]\n"
+                     "       emulator --batch [--jobs N] [--max N] [--mem BYTES] [--report FILE]"
+                     " (in.bin | @LIST)...\n";
+        return 64;
+    }
+    std::string inFile = argv[1];
+    uint64_t budget = 100000000;
+    uint64_t memSize = 1u << 20, laneMem = 1u << 16; // --lanes programs are small, and 8 share a group
+    bool regs = false, timing = false, cache = false, l2 = false, stats = false;
+    size_t top = 10;
+    TimingConfig tc;
+    CacheConfig icfg, dcfg, l2cfg;
+    l2cfg.size = 256 * 1024; l2cfg.ways = 8; l2cfg.line = 64;
+    std::vector<std::unique_ptr<DirectionPredictor>> preds;
+    BranchConfig bc;
+    bool bp = false, profile = false, console = false;
+    uint32_t consoleAddr = 0;
+    uint64_t fuzzExecs = 0;
+    bool budgetSet = false, resume = false, fuse = true;
+    uint64_t checkpointAt = UINT64_MAX;
+    std::string checkpointFile;
+    FuzzConfig fc;
+    bool sample = false;
+    SampleConfig sc;
+    std::string mapFile, layoutFile, traceFile, lanesFile, reportFile;
+    for (int i = 2; i < argc; i++) {
+        std::string a = argv[i];
+        auto num = [&]() { return std::strtoull(argv[++i], nullptr, 0); };
+        if (a == "--max" && i + 1 < argc) { budget = num(); budgetSet = true; }
+        else if (a == "--mem" && i + 1 < argc) memSize = laneMem = num();
+        else if (a == "--regs") regs = true;
+        else if (a == "--timing") timing = true;
+        else if (a == "--top" && i + 1 < argc) top = (size_t)num();
+        else if (a == "--load-latency" && i + 1 < argc) tc.loadLatency = (unsigned)num();
+        else if (a == "--branch-penalty" && i + 1 < argc) tc.branchPenalty = (unsigned)num();
+        else if (a == "--cache") cache = true;
+        else if (a == "--icache" && i + 1 < argc) { if (!cacheArg(argv[++i], "--icache", icfg)) return 64; cache = true; }
+        else if (a == "--dcache" && i + 1 < argc) { if (!cacheArg(argv[++i], "--dcache", dcfg)) return 64; cache = true; }
+        else if (a == "--l2" && i + 1 < argc) { if (!cacheArg(argv[++i], "--l2", l2cfg)) return 64; cache = l2 = true; }
+        else if (a == "--bp" && i + 1 < argc) { if (!predictorsArg(argv[++i], preds)) return 64; bp = true; }
+        else if (a == "--btb" && i + 1 < argc) bc.btbEntries = (uint32_t)num();
+        else if (a == "--ras" && i + 1 < argc) bc.rasDepth = (uint32_t)num();
+        else if (a == "--profile") profile = true;
+        else if (a == "--map" && i + 1 < argc) mapFile = argv[++i];
+        else if (a == "--layout-profile" && i + 1 < argc) layoutFile = argv[++i];
+        else if (a == "--trace" && i + 1 < argc) traceFile = argv[++i];
+        else if (a == "--console" && i + 1 < argc) { consoleAddr = (uint32_t)num(); console = true; }
+        else if (a == "--fuzz" && i + 1 < argc) fuzzExecs = num();
+        else if (a == "--fuzz-addr" && i + 1 < argc) fc.inputAddr = (uint32_t)num();
+        else if (a == "--fuzz-len" && i + 1 < argc) fc.inputLen = (uint32_t)num();
+        else if (a == "--entry" && i + 1 < argc) fc.entry = (uint32_t)num();
+        else if (a == "--seed" && i + 1 < argc) fc.seed = num();
+        else if (a == "--sample") sample = true;
+        else if (a == "--interval" && i + 1 < argc) sc.interval = num();
+        else if (a == "--warmup" && i + 1 < argc) sc.warmup = num();
+        else if (a == "--max-k" && i + 1 < argc) sc.maxK = (unsigned)num();
+        else if (a == "--per-cluster" && i + 1 < argc) sc.perCluster = (unsigned)num();
+        else if (a == "--lanes" && i + 1 < argc) lanesFile = argv[++i];
+        else if (a == "--report" && i + 1 < argc) reportFile = argv[++i];
+        else if (a == "--stats") stats = true;
+        else if (a == "--checkpoint" && i + 1 < argc) checkpointFile = argv[++i];
+        else if (a == "--checkpoint-at" && i + 1 < argc) checkpointAt = num();
+        else if (a == "--resume") resume = true;
+        else if (a == "--no-fuse") fuse = false;
+    }
+    if (!layoutFile.empty() && mapFile.empty()) {
+        std::cerr << "--layout-profile: needs --map (the profile names source lines)\n";
+        return 64;
+    }
+    if (!mapFile.empty() && layoutFile.empty()) profile = true;
+    const bool countFlow = profile || !layoutFile.empty();
+    if (memSize > Engine::kMaxMem) { std::cerr << "--mem: at most " << Engine::kMaxMem << " bytes\n"; return 64; }
+    if (!lanesFile.empty()) return lanesMain(inFile, lanesFile, budget, laneMem, reportFile, stats);
+    if (!bc.btbEntries || (bc.btbEntries & (bc.btbEntries - 1))) {
+        std::cerr << "--btb: entries must be a power of two\n";
+        return 64;
+    }
+    // --resume: in.bin is a checkpoint, and --mem comes from it.
+    std::unique_ptr<Engine> engine;
+    uint64_t instretBefore = 0;
+    if (resume) {
+        std::string err;
+        engine = loadCheckpoint(inFile, instretBefore, err);
+        if (!engine) { std::cerr << "--resume: " << err << "\n"; return 1; }
+    } else {
+        auto image = readBinaryFile(inFile);
+        if (image.empty()) { std::cerr << "Empty or unreadable input.\n"; return 1; }
+        engine.reset(new Engine(image, memSize));
+    }
+    Engine& eng = *engine;
+    eng.setFusion(fuse);
+    Console con;
+    if (console && !eng.memory().mapMmio(consoleAddr, GuestMemory::kPageSize, con)) {
+        std::cerr << "--console: address must be page-aligned and outside RAM (--mem)\n";
+        return 64;
+    }
+    PipelineModel model(eng.imageSize(), tc);
+    CacheModel caches(eng.imageSize(), icfg, dcfg, l2 ? &l2cfg : nullptr);
+    BranchModel branches(eng.imageSize(), std::move(preds), bc);
+    ProfileModel prof(eng.imageSize());
+    Tools tools;
+    if (timing) tools.timing = &model;
+    if (cache) tools.cache = &caches;
+    if (bp) tools.branch = &branches;
+    if (countFlow) tools.profile = &prof;
+    std::unique_ptr<TraceWriter> tracer;
+    if (!traceFile.empty()) {
+        tracer.reset(new TraceWriter(eng.hart(), traceFile));
+        if (!tracer->ok()) return 1;
+        tools.trace = tracer.get();
+    }
+    if (fuzzExecs) {
+        // --max bounds each execution (and the boot code); hangs are cut off early by default.
+        if (budgetSet) fc.budget = budget;
+        Fuzzer fz(eng, fc);
+        if (!fz.boot(fc.budget)) {
+            std::fprintf(stderr, "--fuzz: pc 0x%08x not reached\n", fc.entry);
+            return 1;
+        }
+        fz.run(fuzzExecs);
+        fz.report(std::cout);
+        return fz.crashes().empty() ? 0 : 1;
+    }
+    if (sample) {
+        sc.seed = fc.seed;
+        sc.timing = tc;
+        SampleResult sr = runSampled(eng, budget, sc);
+        writeSampleReport(std::cout, sr, sc);
+        return sr.stop.reason == StopReason::Halted || sr.stop.reason == StopReason::EndOfImage ? 0 : 1;
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    if (countFlow) prof.begin(eng.hart().pc);
+    // Profiling or tracing alone runs its model directly: both have to stay close to
+    // untraced speed.
+    auto runFor = [&](uint64_t n) {
+        return tools.count() == 0 ? eng.run(n)
+             : tools.count() == 1 && tools.profile ? eng.run(n, prof)
+             : tools.count() == 1 && tools.trace ? eng.run(n, *tracer)
+             : eng.run(n, tools);
+    };
+    RunResult r;
+    CheckpointWriter saver;
+    auto savedReport = [&]() {
+        if (!saver.busy()) return true;
+        if (!saver.wait()) { std::cerr << "--checkpoint: " << saver.error() << "\n"; return false; }
+        const CheckpointStats& cs = saver.stats();
+        std::fprintf(stderr, "checkpoint: %s at instruction %llu: %zu pages (%zu zero pages left out), %.1f KiB"
+                     " packed to %.1f KiB; paused %.0f us, written in %.3f s\n", checkpointFile.c_str(),
+                     (unsigned long long)cs.instret, cs.pages, cs.zeroPages, cs.rawBytes / 1024.0,
+                     cs.fileBytes / 1024.0, cs.pauseSeconds * 1e6, cs.seconds);
+        return true;
+    };
+    if (checkpointFile.empty()) r = runFor(budget);
+    else {
+        // Run in slices that end at --checkpoint-at and often enough to notice SIGUSR1. The
+        // guest keeps running while the checkpoint is written.
+        const uint64_t kSlice = 1u << 22;
+        std::signal(SIGUSR1, onCheckpointSignal);
+        uint64_t done = 0;
+        for (;;) {
+            if (instretBefore + done == checkpointAt || gCheckpointRequested) {
+                gCheckpointRequested = 0;
+                if (!savedReport()) return 1;
+                saver.start(eng, instretBefore + done, checkpointFile);
+            }
+            uint64_t n = std::min(budget - done, kSlice);
+            if (checkpointAt > instretBefore + done) n = std::min(n, checkpointAt - instretBefore - done);
+            r = runFor(n);
+            done += r.instrs;
+            if (r.reason != StopReason::Budget || done == budget) break;
+        }
+        r.instrs = done;
+        if (!savedReport()) return 1;
+    }
+    if (countFlow) prof.end(r);
+    if (tracer) tracer->flush();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::fprintf(stderr, "stop: %s at pc 0x%08x after %llu instructions", stopReasonStr(r.reason),
+                 r.pc, (unsigned long long)r.instrs);
+    if (r.reason == StopReason::MemFault) std::fprintf(stderr, " (address 0x%08x)", r.addr);
+    if (resume) std::fprintf(stderr, ", %llu since reset", (unsigned long long)(instretBefore + r.instrs));
+    std::fprintf(stderr, "\n");
+    if (stats && secs > 0)
+        std::fprintf(stderr, "run: %.3f s, %.1f MIPS; memory: %zu pages, %llu TLB misses\n", secs,
+                     (double)r.instrs / secs / 1e6, eng.memory().pagesAllocated(),
+                     (unsigned long long)eng.memory().tlbMisses());
+    if (stats) {
+        uint64_t pairs = 0;
+        std::fprintf(stderr, "fused:");
+        for (unsigned k = 1; k < kFusionKinds; ++k) {
+            std::fprintf(stderr, "%s %s %llu", k > 1 ? "," : "", fusionName((Fusion)k),
+                         (unsigned long long)eng.fusions((Fusion)k));
+            pairs += eng.fusions((Fusion)k);
+        }
+        std::fprintf(stderr, " (%.1f%% of instructions ran in pairs)\n", r.instrs ? 200.0 * pairs / r.instrs : 0.0);
+    }
+    if (timing) model.report(std::cout, eng, top);
+    if (cache) caches.report(std::cout, eng, top);
+    if (bp) branches.report(std::cout, eng, top);
+    if (countFlow) {
+        LineMap map;
+        if (!mapFile.empty() && !readLineMap(mapFile, map)) std::cerr << "--map: cannot read " << mapFile << "\n";
+        if (profile) prof.report(std::cout, eng, mapFile.empty() ? nullptr : &map, top);
+        if (!layoutFile.empty()) {
+            std::ofstream f(layoutFile);
+            if (!f || !prof.writeLayoutProfile(f, eng, map) || !f.flush())
+                std::cerr << "--layout-profile: cannot write " << layoutFile << "\n";
+        }
+    }
+    if (regs)
+        for (int k = 1; k < 32; ++k) std::printf("x%d=%08x\n", k, eng.hart().x[k]);
+    return r.reason == StopReason::Halted || r.reason == StopReason::EndOfImage ? 0 : 1;
+}
@@ -0,0 +1,263 @@
+#include "emulator/predict.h"
+#include "decoder/formatter.h"
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+
+namespace {
+
+// 2-bit saturating counter, taken when >= 2.
+inline void bump(uint8_t& c, bool taken) {
+    if (taken) { if (c < 3) ++c; }
+    else if (c > 0) --c;
+}
+
+class StaticBtfn : public DirectionPredictor {
+public:
+    bool predict(uint32_t pc, uint32_t target) override { return target <= pc; }
+    void update(uint32_t, bool) override {}
+    std::string name() const override { return "static"; }
+};
+
+class Bimodal : public DirectionPredictor {
+public:
+    explicit Bimodal(unsigned bits) : bits_(bits), t_(1u << bits, 1) {}
+    bool predict(uint32_t pc, uint32_t) override { return t_[idx(pc)] >= 2; }
+    void update(uint32_t pc, bool taken) override { bump(t_[idx(pc)], taken); }
+    std::string name() const override { return "bimodal:" + std::to_string(bits_); }
+private:
+    uint32_t idx(uint32_t pc) const { return (pc >> 1) & ((1u << bits_) - 1); }
+    unsigned bits_;
+    std::vector<uint8_t> t_;
+};
+
+class Gshare : public DirectionPredictor {
+public:
+    explicit Gshare(unsigned bits) : bits_(bits), t_(1u << bits, 1) {}
+    bool predict(uint32_t pc, uint32_t) override { return t_[idx(pc)] >= 2; }
+    void update(uint32_t pc, bool taken) override {
+        bump(t_[idx(pc)], taken);
+        hist_ = (hist_ << 1) | (taken ? 1u : 0u);
+    }
+    std::string name() const override { return "gshare:" + std::to_string(bits_); }
+private:
+    uint32_t idx(uint32_t pc) const { return ((pc >> 1) ^ hist_) & ((1u << bits_) - 1); }
+    unsigned bits_;
+    uint32_t hist_ = 0;
+    std::vector<uint8_t> t_;
+};
+
+// TAGE with a bimodal base and four tagged tables over geometric global-history lengths.
+// Kept small: one allocation per misprediction, 3-bit counters, 2-bit usefulness with a
+// periodic halving reset.
+class TageLite : public DirectionPredictor {
+public:
+    explicit TageLite(unsigned bits) : bits_(bits), base_(1u << bits, 1) {
+        tbits_ = bits > 2 ? bits - 2 : 1;
+        for (auto& t : tables_) t.assign(1u << tbits_, Entry{});
+    }
+    bool predict(uint32_t pc, uint32_t) override {
+        provider_ = alt_ = -1;
+        for (int k = kTables - 1; k >= 0; --k) {
+            idx_[k] = index(pc, k);
+            tag_[k] = tag(pc, k);
+        }
+        for (int k = kTables - 1; k >= 0; --k) {
+            if (tables_[k][idx_[k]].tag != tag_[k]) continue;
+            if (provider_ < 0) provider_ = k;
+            else { alt_ = k; break; }
+        }
+        baseIdx_ = (pc >> 1) & ((1u << bits_) - 1);
+        altPred_ = alt_ >= 0 ? tables_[alt_][idx_[alt_]].ctr >= 0 : base_[baseIdx_] >= 2;
+        pred_ = provider_ >= 0 ? tables_[provider_][idx_[provider_]].ctr >= 0 : altPred_;
+        return pred_;
+    }
+    void update(uint32_t, bool taken) override {
+        if (provider_ >= 0) {
+            Entry& e = tables_[provider_][idx_[provider_]];
+            if (pred_ != altPred_) {
+                if (pred_ == taken) { if (e.u < 3) ++e.u; }
+                else if (e.u > 0) --e.u;
+            }
+            if (taken) { if (e.ctr < 3) ++e.ctr; }
+            else if (e.ctr > -4) --e.ctr;
+        } else {
+            bump(base_[baseIdx_], taken);
+        }
+        if (pred_ != taken && provider_ < kTables - 1) {
+            bool placed = false;
+            for (int k = provider_ + 1; k < kTables && !placed; ++k) {
+                Entry& e = tables_[k][idx_[k]];
+                if (e.u == 0) { e = Entry{tag_[k], (int8_t)(taken ? 0 : -1), 0}; placed = true; }
+            }
+            if (!placed)
+                for (int k = provider_ + 1; k < kTables; ++k) --tables_[k][idx_[k]].u;
+        }
+        if (++tick_ % (1u << 18) == 0)
+            for (auto& t : tables_) for (auto& e : t) e.u >>= 1;
+        hist_ = (hist_ << 1) | (taken ? 1u : 0u);
+    }
+    std::string name() const override { return "tage:" + std::to_string(bits_); }
+
+private:
+    static constexpr int kTables = 4;
+    static constexpr unsigned kHist[kTables] = {4, 10, 24, 60};
+    struct Entry { uint16_t tag = 0xFFFF; int8_t ctr = 0; uint8_t u = 0; };
+
+    // Low `len` history bits folded down to `n` bits.
+    uint32_t fold(unsigned len, unsigned n) const {
+        uint64_t h = len >= 64 ? hist_ : hist_ & ((1ull << len) - 1);
+        uint32_t f = 0;
+        for (; h; h >>= n) f ^= (uint32_t)h & ((1u << n) - 1);
+        return f;
+    }
+    uint32_t index(uint32_t pc, int k) const {
+        return ((pc >> 1) ^ (pc >> (tbits_ + 1)) ^ fold(kHist[k], tbits_)) & ((1u << tbits_) - 1);
+    }
+    uint16_t tag(uint32_t pc, int k) const {
+        return (uint16_t)(((pc >> 1) ^ fold(kHist[k], 8) ^ (fold(kHist[k], 7) << 1)) & 0xFF);
+    }
+
+    unsigned bits_, tbits_;
+    std::vector<uint8_t> base_;
+    std::vector<Entry> tables_[kTables];
+    uint64_t hist_ = 0;
+    uint32_t tick_ = 0;
+    // state of the prediction in flight
+    int provider_ = -1, alt_ = -1;
+    bool pred_ = false, altPred_ = false;
+    uint32_t baseIdx_ = 0, idx_[kTables] = {};
+    uint16_t tag_[kTables] = {};
+};
+
+constexpr unsigned TageLite::kHist[];
+
+bool isLink(uint8_t r) { return r == 1 || r == 5; }
+
+} // namespace
+
+std::unique_ptr<DirectionPredictor> makePredictor(const std::string& kind, unsigned bits) {
+    bits = std::min(std::max(bits, 2u), 24u);
+    if (kind == "static")  return std::unique_ptr<DirectionPredictor>(new StaticBtfn());
+    if (kind == "bimodal") return std::unique_ptr<DirectionPredictor>(new Bimodal(bits));
+    if (kind == "gshare")  return std::unique_ptr<DirectionPredictor>(new Gshare(bits));
+    if (kind == "tage")    return std::unique_ptr<DirectionPredictor>(new TageLite(bits));
+    return nullptr;
+}
+
+BranchModel::BranchModel(uint32_t imageSize, std::vector<std::unique_ptr<DirectionPredictor>> preds,
+                         BranchConfig cfg)
+    : preds_(std::move(preds)), cfg_(cfg),
+      btbTag_(cfg.btbEntries, UINT32_MAX), btbTarget_(cfg.btbEntries, 0),
+      ras_(std::max<uint32_t>(cfg.rasDepth, 1), 0),
+      miss_(preds_.size(), 0), dirMiss_(preds_.size(), 0),
+      perPc_((imageSize >> 1) + 1) {}
+
+bool BranchModel::btbHit(uint32_t pc, uint32_t target) const {
+    uint32_t i = (pc >> 1) & (cfg_.btbEntries - 1);
+    return btbTag_[i] == pc && btbTarget_[i] == target;
+}
+
+void BranchModel::control(uint32_t pc, const Op& op, bool taken, uint32_t target) {
+    PcBranch& b = perPc_[pc >> 1];
+    if (b.misses.empty()) b.misses.assign(preds_.size(), 0);
+    ++b.count;
+    if (taken) ++b.taken;
+
+    bool targetOk = true; // for a taken transfer: would fetch have gone to `target`?
+    if (op.tag == TAG_JALR && op.rd == 0 && isLink(op.rs1)) {
+        ++tot_.returns;
+        targetOk = rasCount_ && ras_[rasTop_] == target;
+        if (rasCount_) { rasTop_ = (rasTop_ + (uint32_t)ras_.size() - 1) % (uint32_t)ras_.size(); --rasCount_; }
+        if (!targetOk) ++tot_.rasMisses;
+    } else if (taken) {
+        targetOk = btbHit(pc, target);
+        if (!targetOk) ++tot_.btbMisses;
+    }
+    if (op.tag == TAG_JAL) ++tot_.jumps;
+    else if (op.tag == TAG_JALR && !(op.rd == 0 && isLink(op.rs1))) ++tot_.indirect;
+    if ((op.tag == TAG_JAL || op.tag == TAG_JALR) && isLink(op.rd)) {
+        rasTop_ = (rasTop_ + 1) % (uint32_t)ras_.size();
+        ras_[rasTop_] = pc + op.len;
+        rasCount_ = std::min(rasCount_ + 1, (uint32_t)ras_.size());
+    }
+
+    bool cond = op.tag == TAG_BEQ || op.tag == TAG_BNE;
+    if (cond) {
+        ++tot_.branches;
+        if (taken) ++tot_.taken;
+    }
+    for (size_t p = 0; p < preds_.size(); ++p) {
+        bool miss;
+        if (cond) {
+            bool guess = preds_[p]->predict(pc, target);
+            preds_[p]->update(pc, taken);
+            if (guess != taken) ++dirMiss_[p];
+            miss = guess != taken || (taken && !targetOk);
+        } else {
+            miss = !targetOk;
+        }
+        if (miss) { ++miss_[p]; ++b.misses[p]; }
+    }
+    if (taken) {
+        uint32_t i = (pc >> 1) & (cfg_.btbEntries - 1);
+        btbTag_[i] = pc;
+        btbTarget_[i] = target;
+    }
+}
+
+void BranchModel::report(std::ostream& os, const Engine& eng, size_t top) const {
+    char buf[200];
+    uint64_t transfers = tot_.branches + tot_.jumps + tot_.returns + tot_.indirect;
+    std::snprintf(buf, sizeof(buf),
+                  "branches: %llu conditional (%.1f%% taken), %llu JAL, %llu returns, %llu other JALR\n"
+                  "targets: btb %u entries, %llu misses; ras depth %u, %llu misses\n",
+                  (unsigned long long)tot_.branches,
+                  tot_.branches ? 100.0 * (double)tot_.taken / (double)tot_.branches : 0.0,
+                  (unsigned long long)tot_.jumps, (unsigned long long)tot_.returns,
+                  (unsigned long long)tot_.indirect, cfg_.btbEntries, (unsigned long long)tot_.btbMisses,
+                  (unsigned)ras_.size(), (unsigned long long)tot_.rasMisses);
+    os << buf;
+    for (size_t p = 0; p < preds_.size(); ++p) {
+        std::snprintf(buf, sizeof(buf),
+                      "%-12s direction %.2f%% correct; %llu mispredicts over all transfers (%.2f%%)\n",
+                      preds_[p]->name().c_str(),
+                      tot_.branches ? 100.0 - 100.0 * (double)dirMiss_[p] / (double)tot_.branches : 100.0,
+                      (unsigned long long)miss_[p],
+                      transfers ? 100.0 * (double)miss_[p] / (double)transfers : 0.0);
+        os << buf;
+    }
+
+    // One table per predictor, each ranked by that predictor's misses; every table shows all
+    // predictors' miss rates so a branch can be compared across them.
+    std::vector<uint32_t> slots;
+    for (uint32_t i = 0; i < perPc_.size(); ++i)
+        if (perPc_[i].count) slots.push_back(i);
+    size_t n = std::min(top, slots.size());
+    if (!n) return;
+    std::snprintf(buf, sizeof(buf), "%15s %7s", "count", "taken%");
+    std::string head = buf;
+    for (const auto& p : preds_) { std::snprintf(buf, sizeof(buf), " %11.11s", p->name().c_str()); head += buf; }
+    for (size_t r = 0; r < preds_.size(); ++r) {
+        auto key = [&](uint32_t i) { return perPc_[i].misses[r]; };
+        std::partial_sort(slots.begin(), slots.begin() + (std::ptrdiff_t)n, slots.end(),
+                          [&](uint32_t a, uint32_t b) { return key(a) != key(b) ? key(a) > key(b) : a < b; });
+        os << "top mispredicts (" << preds_[r]->name() << "):\n" << head << "  instruction\n";
+        std::string line;
+        for (size_t k = 0; k < n; ++k) {
+            const PcBranch& b = perPc_[slots[k]];
+            uint32_t pc = slots[k] << 1;
+            std::snprintf(buf, sizeof(buf), "  %13llu %6.1f%%", (unsigned long long)b.count,
+                          100.0 * (double)b.taken / (double)b.count);
+            line = buf;
+            for (size_t p = 0; p < preds_.size(); ++p) {
+                std::snprintf(buf, sizeof(buf), " %10.2f%%", 100.0 * (double)b.misses[p] / (double)b.count);
+                line += buf;
+            }
+            line += "  ";
+            const Op& op = eng.opAt(pc);
+            appendDecoded(line, DecodedInstr{op.tag, op.rd, op.rs1, op.rs2, op.imm}, pc, op.word);
+            os << line << "\n";
+        }
+    }
+}
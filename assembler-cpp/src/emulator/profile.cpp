@@ -0,0 +1,129 @@
+#include "emulator/profile.h"
+#include "decoder/formatter.h"
+#include "common/utils.h"
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+
+namespace {
+
+struct Block {
+    uint32_t first, last; // PCs of the first and last instruction
+    uint64_t entries, instrs;
+};
+
+bool transfers(InstrTag t) { return t == TAG_BEQ || t == TAG_BNE || t == TAG_JAL || t == TAG_JALR; }
+
+} // namespace
+
+std::vector<uint64_t> ProfileModel::counts(const Engine& eng) const {
+    std::vector<uint64_t> c((eng.imageSize() >> 1) + 1, 0);
+    int64_t flow = 0;
+    for (uint32_t pc = 0; pc < eng.imageSize(); pc += eng.opAt(pc).len) {
+        flow += entries_[pc >> 1];
+        c[pc >> 1] = flow > 0 ? (uint64_t)flow : 0;
+        if (transfers(eng.opAt(pc).tag)) flow = 0; // continues only through recorded entries
+    }
+    return c;
+}
+
+void ProfileModel::report(std::ostream& os, const Engine& eng, const LineMap* map, size_t top) const {
+    const std::vector<uint64_t> count = counts(eng);
+    // Linear sweep of the image, as the disassembler does.
+    std::vector<uint32_t> pcs;
+    std::vector<uint8_t> target((eng.imageSize() >> 1) + 1, 0);
+    for (uint32_t pc = 0; pc < eng.imageSize(); pc += eng.opAt(pc).len) {
+        pcs.push_back(pc);
+        const Op& op = eng.opAt(pc);
+        uint32_t t = pc + (uint32_t)op.imm;
+        if ((op.tag == TAG_BEQ || op.tag == TAG_BNE || op.tag == TAG_JAL) && t < eng.imageSize())
+            target[t >> 1] = 1;
+    }
+
+    std::vector<Block> blocks;
+    uint64_t total = 0;
+    for (size_t k = 0; k < pcs.size(); ++k) {
+        uint32_t pc = pcs[k];
+        uint64_t c = count[pc >> 1];
+        total += c;
+        bool leader = k == 0 || target[pc >> 1] || transfers(eng.opAt(pcs[k - 1]).tag)
+                   || c != count[pcs[k - 1] >> 1];
+        if (leader) blocks.push_back(Block{pc, pc, c, 0});
+        blocks.back().last = pc;
+        blocks.back().instrs += c;
+    }
+    size_t executed = (size_t)std::count_if(blocks.begin(), blocks.end(), [](const Block& b) { return b.instrs; });
+    char buf[160];
+    std::snprintf(buf, sizeof(buf), "profile: %llu instructions in %zu executed blocks\n",
+                  (unsigned long long)total, executed);
+    os << buf;
+
+    size_t n = std::min(top, executed);
+    std::partial_sort(blocks.begin(), blocks.begin() + (std::ptrdiff_t)n, blocks.end(),
+                      [](const Block& a, const Block& b) { return a.instrs != b.instrs ? a.instrs > b.instrs : a.first < b.first; });
+
+    // Source text, when the map names a readable file.
+    std::vector<std::string> lines;
+    if (map) {
+        std::string src = readFileToString(map->source);
+        for (size_t p = 0; p < src.size();) {
+            size_t q = std::min(src.find('\n', p), src.size());
+            lines.push_back(src.substr(p, q - p));
+            p = q + 1;
+        }
+    }
+    std::string base = map ? map->source.substr(map->source.find_last_of('/') + 1) : std::string();
+
+    std::string out;
+    for (size_t b = 0; b < n; ++b) {
+        const Block& blk = blocks[b];
+        std::snprintf(buf, sizeof(buf), "\nblock %zu: %08x..%08x  %llu entries, %llu instructions (%.1f%%)\n",
+                      b + 1, blk.first, blk.last, (unsigned long long)blk.entries,
+                      (unsigned long long)blk.instrs, total ? 100.0 * (double)blk.instrs / (double)total : 0.0);
+        os << buf;
+        for (uint32_t pc = blk.first; pc <= blk.last; pc += eng.opAt(pc).len) {
+            const Op& op = eng.opAt(pc);
+            std::snprintf(buf, sizeof(buf), "%12llu  ", (unsigned long long)count[pc >> 1]);
+            out = buf;
+            appendDecoded(out, DecodedInstr{op.tag, op.rd, op.rs1, op.rs2, op.imm}, pc, op.word, true, true);
+            if (uint32_t line = map ? map->lineAt(pc) : 0) {
+                if (out.size() < 64) out.append(64 - out.size(), ' ');
+                out += "  ; " + base + ":" + std::to_string(line);
+                if (line <= lines.size()) {
+                    const std::string& s = lines[line - 1];
+                    size_t a = s.find_first_not_of(" \t");
+                    if (a != std::string::npos) out += "  " + s.substr(a);
+                }
+            }
+            os << out << "\n";
+        }
+    }
+}
+
+bool ProfileModel::writeLayoutProfile(std::ostream& os, const Engine& eng, const LineMap& map) const {
+    const std::vector<uint64_t> count = counts(eng);
+    os << "# layout profile of " << map.source << " (assembler --layout-profile)\n";
+    std::vector<uint8_t> seen;
+    std::string out;
+    char buf[96];
+    for (uint32_t pc = 0; pc < eng.imageSize(); pc += eng.opAt(pc).len) {
+        const Op& op = eng.opAt(pc);
+        uint32_t line = map.lineAt(pc);
+        if (!line) continue;
+        if (line >= seen.size()) seen.resize(line + 1, 0);
+        if (!seen[line]) {
+            seen[line] = 1;
+            if (count[pc >> 1]) {
+                std::snprintf(buf, sizeof(buf), "@%u %llu\n", line, (unsigned long long)count[pc >> 1]);
+                out += buf;
+            }
+        }
+        uint32_t to = map.lineAt(pc + (uint32_t)op.imm);
+        if (taken_[pc >> 1] && to && (op.tag == TAG_BEQ || op.tag == TAG_BNE || op.tag == TAG_JAL)) {
+            std::snprintf(buf, sizeof(buf), "@%u -> @%u %llu\n", line, to, (unsigned long long)taken_[pc >> 1]);
+            out += buf;
+        }
+    }
+    os << out;
+    return (bool)os;
+}
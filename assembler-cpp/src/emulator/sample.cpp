@@ -0,0 +1,315 @@
+#include "emulator/sample.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <ostream>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double since(Clock::time_point t0) { return std::chrono::duration<double>(Clock::now() - t0).count(); }
+
+uint64_t mix(uint64_t z) { // splitmix64 finalizer
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+struct Rng {
+    uint64_t s;
+    uint64_t next() { s ^= s << 13; s ^= s >> 7; s ^= s << 17; return s; } // xorshift64
+    double unit() { return (double)(next() >> 11) * (1.0 / 9007199254740992.0); }
+};
+
+// Instructions per basic block entry of the current interval. A block runs from a control
+// transfer's destination to the next control instruction, counted when it retires.
+class BbvCollector : public NullObserver {
+public:
+    explicit BbvCollector(uint32_t imageSize) : counts_((imageSize >> 1) + 1, 0) {}
+
+    void control(uint32_t pc, const Op& op, bool taken, uint32_t target) {
+        next_ = taken ? target : pc + op.len;
+        ended_ = true;
+    }
+    void retire(uint32_t, const Op&) {
+        ++n_;
+        if (ended_) { add(); start_ = next_; ended_ = false; }
+    }
+
+    // The interval's vector, projected; a block cut by the interval end counts in both.
+    Bbv take(uint64_t instrs) {
+        add();
+        Bbv b;
+        for (uint32_t slot : touched_) {
+            double w = (double)counts_[slot] / (double)instrs;
+            for (unsigned d = 0; d < kBbvDims; ++d) // a fixed random direction per block
+                b.v[d] += w * ((double)(mix((uint64_t)slot * kBbvDims + d) >> 11) * (2.0 / 9007199254740992.0) - 1.0);
+            counts_[slot] = 0;
+        }
+        touched_.clear();
+        return b;
+    }
+
+private:
+    void add() {
+        uint32_t slot = start_ >> 1;
+        if (!n_ || slot >= counts_.size()) { n_ = 0; return; }
+        if (!counts_[slot]) touched_.push_back(slot);
+        counts_[slot] += n_;
+        n_ = 0;
+    }
+
+    std::vector<uint64_t> counts_;
+    std::vector<uint32_t> touched_;
+    uint64_t n_ = 0;
+    uint32_t start_ = 0, next_ = 0;
+    bool ended_ = false;
+};
+
+double dist2(const Bbv& a, const Bbv& b) {
+    double s = 0;
+    for (unsigned d = 0; d < kBbvDims; ++d) s += (a.v[d] - b.v[d]) * (a.v[d] - b.v[d]);
+    return s;
+}
+
+// One k-means run from k-means++ seeds; returns the sum of squared distances.
+double kmeans(const std::vector<Bbv>& x, unsigned k, Rng& rng, std::vector<uint32_t>& assign, std::vector<Bbv>& centers) {
+    const size_t n = x.size();
+    centers.assign(1, x[rng.next() % n]);
+    std::vector<double> d(n);
+    while (centers.size() < k) {
+        double total = 0;
+        for (size_t i = 0; i < n; ++i) {
+            d[i] = std::numeric_limits<double>::max();
+            for (const Bbv& c : centers) d[i] = std::min(d[i], dist2(x[i], c));
+            total += d[i];
+        }
+        size_t pick = rng.next() % n;
+        if (total > 0) {
+            double r = rng.unit() * total;
+            for (pick = 0; pick + 1 < n && (r -= d[pick]) > 0; ++pick) {}
+        }
+        centers.push_back(x[pick]);
+    }
+    assign.assign(n, 0);
+    double sse = 0;
+    for (int iter = 0; iter < 100; ++iter) {
+        bool moved = iter == 0;
+        sse = 0;
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t best = 0;
+            double bd = dist2(x[i], centers[0]);
+            for (uint32_t c = 1; c < k; ++c)
+                if (double e = dist2(x[i], centers[c]); e < bd) { bd = e; best = c; }
+            moved |= best != assign[i];
+            assign[i] = best;
+            sse += bd;
+        }
+        if (!moved) break;
+        std::vector<Bbv> sum(k);
+        std::vector<size_t> count(k, 0);
+        for (size_t i = 0; i < n; ++i) {
+            ++count[assign[i]];
+            for (unsigned dd = 0; dd < kBbvDims; ++dd) sum[assign[i]].v[dd] += x[i].v[dd];
+        }
+        for (uint32_t c = 0; c < k; ++c) {
+            if (!count[c]) continue; // keeps its old center
+            for (unsigned dd = 0; dd < kBbvDims; ++dd) centers[c].v[dd] = sum[c].v[dd] / (double)count[c];
+        }
+    }
+    return sse;
+}
+
+// BIC of a hard spherical-Gaussian clustering (Pelleg and Moore's X-means formulation).
+double bic(const std::vector<uint32_t>& assign, unsigned k, double sse) {
+    const double R = (double)assign.size(), M = kBbvDims;
+    std::vector<size_t> count(k, 0);
+    for (uint32_t a : assign) ++count[a];
+    double var = std::max(sse / ((R - k) * M), 1e-12);
+    double l = -R * M / 2 * std::log(2 * 3.14159265358979323846 * var) - (R - k) * M / 2;
+    for (size_t c : count)
+        if (c) l += (double)c * std::log((double)c / R);
+    double params = k * (M + 1);
+    return l - params / 2 * std::log(R);
+}
+
+} // namespace
+
+std::vector<uint32_t> clusterBbvs(const std::vector<Bbv>& bbvs, unsigned maxK, uint64_t seed) {
+    const size_t n = bbvs.size();
+    if (n < 3) return std::vector<uint32_t>(n, 0);
+    maxK = (unsigned)std::min<size_t>(std::max(maxK, 1u), n - 1);
+    Rng rng{mix(seed) | 1};
+    std::vector<std::vector<uint32_t>> best(maxK + 1);
+    std::vector<double> score(maxK + 1);
+    std::vector<uint32_t> assign;
+    std::vector<Bbv> centers;
+    for (unsigned k = 1; k <= maxK; ++k) {
+        double bestSse = std::numeric_limits<double>::max();
+        for (int restart = 0; restart < 5; ++restart) {
+            double sse = kmeans(bbvs, k, rng, assign, centers);
+            if (sse < bestSse) { bestSse = sse; best[k] = assign; }
+        }
+        score[k] = bic(best[k], k, bestSse);
+    }
+    double lo = *std::min_element(score.begin() + 1, score.end());
+    double hi = *std::max_element(score.begin() + 1, score.end());
+    unsigned k = 1;
+    while (k < maxK && score[k] < lo + 0.9 * (hi - lo)) ++k;
+    // Renumber so that cluster ids follow first appearance, with none left empty.
+    std::vector<uint32_t> id(k, UINT32_MAX), out(n);
+    uint32_t next = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t& c = id[best[k][i]];
+        if (c == UINT32_MAX) c = next++;
+        out[i] = c;
+    }
+    return out;
+}
+
+SampleResult runSampled(Engine& eng, uint64_t budget, const SampleConfig& cfg) {
+    SampleResult res;
+    const uint64_t interval = std::max<uint64_t>(cfg.interval, 1);
+    eng.snapshot();
+
+    // 1. Functional run, one BBV per interval.
+    auto t0 = Clock::now();
+    BbvCollector bbv(eng.imageSize());
+    std::vector<uint64_t> lengths;
+    uint64_t done = 0;
+    for (;;) {
+        RunResult r = eng.run(std::min(interval, budget - done), bbv);
+        done += r.instrs;
+        if (r.instrs) { res.bbvs.push_back(bbv.take(r.instrs)); lengths.push_back(r.instrs); }
+        res.stop = r;
+        if (r.reason != StopReason::Budget || done == budget) break;
+    }
+    res.stop.instrs = done;
+    res.intervals = res.bbvs.size();
+    res.profileSeconds = since(t0);
+    if (!res.intervals) { eng.restore(); return res; }
+
+    // 2. Clusters, their representatives and samples.
+    t0 = Clock::now();
+    res.assignment = clusterBbvs(res.bbvs, cfg.maxK, cfg.seed);
+    uint32_t k = *std::max_element(res.assignment.begin(), res.assignment.end()) + 1;
+    res.clusters.resize(k);
+    for (size_t i = 0; i < res.intervals; ++i) {
+        SampleCluster& c = res.clusters[res.assignment[i]];
+        c.members.push_back(i);
+        c.weight += (double)lengths[i] / (double)done;
+    }
+    Rng rng{mix(cfg.seed + 1) | 1};
+    std::vector<std::pair<size_t, std::pair<uint32_t, size_t>>> plan; // interval, (cluster, sample slot)
+    for (uint32_t c = 0; c < k; ++c) {
+        SampleCluster& cl = res.clusters[c];
+        Bbv mean;
+        for (size_t i : cl.members)
+            for (unsigned d = 0; d < kBbvDims; ++d) mean.v[d] += res.bbvs[i].v[d] / (double)cl.members.size();
+        cl.representative = *std::min_element(cl.members.begin(), cl.members.end(), [&](size_t a, size_t b) {
+            return dist2(res.bbvs[a], mean) < dist2(res.bbvs[b], mean);
+        });
+        std::vector<size_t> rest;
+        for (size_t i : cl.members) if (i != cl.representative) rest.push_back(i);
+        cl.sampled.push_back(cl.representative);
+        while (cl.sampled.size() < std::max(cfg.perCluster, 1u) && !rest.empty()) { // the rest at random
+            size_t j = rng.next() % rest.size();
+            cl.sampled.push_back(rest[j]);
+            rest[j] = rest.back();
+            rest.pop_back();
+        }
+        cl.sampleCpi.assign(cl.sampled.size(), 0);
+        for (size_t s = 0; s < cl.sampled.size(); ++s) plan.push_back({cl.sampled[s], {c, s}});
+    }
+    std::sort(plan.begin(), plan.end());
+    res.clusterSeconds = since(t0);
+
+    // 3. From the start again: fast-forward to each sample, warm the model up, measure.
+    t0 = Clock::now();
+    eng.restore();
+    uint64_t pos = 0;
+    // EX slots so far; cycles() adds the pipeline fill and drain.
+    auto slots = [](const PipelineModel& m) { return m.instrs() ? m.cycles() - 4 : 0; };
+    for (const auto& p : plan) {
+        uint64_t start = p.first * interval, warmFrom = std::max(pos, start > cfg.warmup ? start - cfg.warmup : 0);
+        if (warmFrom > pos) pos += eng.run(warmFrom - pos).instrs;
+        PipelineModel model(eng.imageSize(), cfg.timing);
+        if (start > pos) {
+            uint64_t w = eng.run(start - pos, model).instrs;
+            pos += w;
+            res.warmupInstrs += w;
+        }
+        uint64_t c0 = slots(model), i0 = model.instrs();
+        pos += eng.run(lengths[p.first], model).instrs;
+        uint64_t measured = model.instrs() - i0;
+        res.detailInstrs += measured;
+        res.clusters[p.second.first].sampleCpi[p.second.second] =
+            measured ? (double)(slots(model) - c0) / (double)measured : 0.0;
+    }
+    eng.restore();
+    res.detailSeconds = since(t0);
+
+    // Stratified estimate: cluster means weighted by instructions. A cluster's variance
+    // comes from its own samples, or the pooled variance when it has only one.
+    double pooled = 0, dof = 0, var = 0;
+    for (SampleCluster& c : res.clusters) {
+        double m = 0;
+        for (double v : c.sampleCpi) m += v / (double)c.sampleCpi.size();
+        c.cpi = m;
+        res.cpi += c.weight * m;
+        if (c.sampleCpi.size() > 1) {
+            for (double v : c.sampleCpi) pooled += (v - m) * (v - m);
+            dof += (double)c.sampleCpi.size() - 1;
+        }
+    }
+    bool bounded = true;
+    for (const SampleCluster& c : res.clusters) {
+        double m = (double)c.sampleCpi.size(), N = (double)c.members.size();
+        if (m == N) continue;
+        double s2 = 0;
+        if (m > 1) {
+            for (double v : c.sampleCpi) s2 += (v - c.cpi) * (v - c.cpi) / (m - 1);
+        } else if (dof > 0) s2 = pooled / dof;
+        else bounded = false;
+        var += c.weight * c.weight * (1 - m / N) * s2 / m;
+    }
+    res.cpiError = bounded ? 1.96 * std::sqrt(var) : -1;
+    return res;
+}
+
+void writeSampleReport(std::ostream& os, const SampleResult& r, const SampleConfig& cfg) {
+    char buf[200];
+    uint64_t instrs = r.stop.instrs;
+    std::snprintf(buf, sizeof(buf), "sampling: %zu intervals of %llu instructions (%llu in total, stop: %s)\n",
+                  r.intervals, (unsigned long long)cfg.interval, (unsigned long long)instrs, stopReasonStr(r.stop.reason));
+    os << buf;
+    if (!r.intervals) return;
+    std::snprintf(buf, sizeof(buf), "clusters: %zu; timed %llu instructions in detail plus %llu warm-up (%.2f%% of the run)\n",
+                  r.clusters.size(), (unsigned long long)r.detailInstrs, (unsigned long long)r.warmupInstrs,
+                  100.0 * (double)(r.detailInstrs + r.warmupInstrs) / (double)instrs);
+    os << buf;
+    os << "  cluster  intervals   weight  representative  sampled  CPI (each sample)\n";
+    for (size_t c = 0; c < r.clusters.size(); ++c) {
+        const SampleCluster& cl = r.clusters[c];
+        std::snprintf(buf, sizeof(buf), "  %7zu  %9zu  %6.2f%%  %14zu  %7zu  %.4f (", c, cl.members.size(),
+                      100.0 * cl.weight, cl.representative, cl.sampled.size(), cl.cpi);
+        os << buf;
+        for (size_t s = 0; s < cl.sampleCpi.size(); ++s) {
+            std::snprintf(buf, sizeof(buf), "%s%.4f", s ? " " : "", cl.sampleCpi[s]);
+            os << buf;
+        }
+        os << ")\n";
+    }
+    if (r.cpiError >= 0)
+        std::snprintf(buf, sizeof(buf), "CPI: %.4f +/- %.4f (95%%), about %.0f cycles\n", r.cpi, r.cpiError, r.cpi * (double)instrs);
+    else
+        std::snprintf(buf, sizeof(buf), "CPI: %.4f (no error bound: sample clusters more than once), about %.0f cycles\n",
+                      r.cpi, r.cpi * (double)instrs);
+    os << buf;
+    std::snprintf(buf, sizeof(buf), "time: functional %.3f s, clustering %.3f s, detailed %.3f s\n",
+                  r.profileSeconds, r.clusterSeconds, r.detailSeconds);
+    os << buf;
+}
@@ -0,0 +1,40 @@
+#include "emulator/timing.h"
+#include "decoder/formatter.h"
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+
+PipelineModel::PipelineModel(uint32_t imageSize, TimingConfig cfg)
+    : cfg_(cfg), perPc_((imageSize >> 1) + 1) {}
+
+void PipelineModel::report(std::ostream& os, const Engine& eng, size_t top) const {
+    char buf[160];
+    std::snprintf(buf, sizeof(buf), "timing: %llu cycles, %llu instructions, CPI %.3f\n",
+                  (unsigned long long)cycles(), (unsigned long long)instrs_, cpi());
+    os << buf;
+    std::snprintf(buf, sizeof(buf), "stalls: load-use %llu, other data %llu, control %llu\n",
+                  (unsigned long long)loadUseStalls_, (unsigned long long)otherDataStalls_,
+                  (unsigned long long)controlStalls_);
+    os << buf;
+
+    std::vector<uint32_t> slots;
+    for (uint32_t i = 0; i < perPc_.size(); ++i)
+        if (perPc_[i].dataStalls + perPc_[i].controlStalls) slots.push_back(i);
+    auto total = [&](uint32_t i) { return perPc_[i].dataStalls + perPc_[i].controlStalls; };
+    size_t n = std::min(top, slots.size());
+    std::partial_sort(slots.begin(), slots.begin() + (std::ptrdiff_t)n, slots.end(),
+                      [&](uint32_t a, uint32_t b) { return total(a) != total(b) ? total(a) > total(b) : a < b; });
+    if (!n) return;
+    os << "top stalls:     count      data   control  instruction\n";
+    std::string line;
+    for (size_t k = 0; k < n; ++k) {
+        uint32_t pc = slots[k] << 1;
+        const PcTiming& t = perPc_[slots[k]];
+        const Op& op = eng.opAt(pc);
+        std::snprintf(buf, sizeof(buf), "  %10llu %9llu %9llu  ", (unsigned long long)t.count,
+                      (unsigned long long)t.dataStalls, (unsigned long long)t.controlStalls);
+        line = buf;
+        appendDecoded(line, DecodedInstr{op.tag, op.rd, op.rs1, op.rs2, op.imm}, pc, op.word);
+        os << line << "\n";
+    }
+}
@@ -0,0 +1,72 @@
+#include "emulator/trace.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+TraceWriter::TraceWriter(const Hart& hart, const std::string& path, size_t ringRecords)
+    : hart_(hart) {
+    size_t cap = kPublish;
+    while (cap < ringRecords) cap <<= 1;
+    ring_.resize(cap);
+    mask_ = cap - 1;
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_) { std::cerr << "Error: failed to open file for writing: " << path << "\n"; return; }
+    TraceHeader h;
+    std::fwrite(&h, sizeof(h), 1, file_);
+    thread_ = std::thread(&TraceWriter::drain, this);
+}
+
+TraceWriter::~TraceWriter() { flush(); }
+
+void TraceWriter::waitForSpace() {
+    // Let the drain thread see everything, then wait for it to free a publish batch.
+    published_.store(head_, std::memory_order_release);
+    while (head_ - (tailSeen_ = consumed_.load(std::memory_order_acquire)) > ring_.size() - kPublish)
+        std::this_thread::yield();
+}
+
+void TraceWriter::drain() {
+    uint64_t tail = 0;
+    for (;;) {
+        uint64_t head = published_.load(std::memory_order_acquire);
+        if (head == tail) {
+            if (stop_.load(std::memory_order_acquire) && published_.load(std::memory_order_acquire) == tail) break;
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            continue;
+        }
+        while (tail != head) { // at most two contiguous pieces
+            size_t at = (size_t)(tail & mask_);
+            size_t n = (size_t)std::min<uint64_t>(head - tail, ring_.size() - at);
+            std::fwrite(&ring_[at], sizeof(TraceRecord), n, file_);
+            tail += n;
+        }
+        consumed_.store(tail, std::memory_order_release);
+    }
+}
+
+void TraceWriter::flush() {
+    if (!file_) return;
+    published_.store(head_, std::memory_order_release);
+    stop_.store(true, std::memory_order_release);
+    thread_.join();
+    std::fclose(file_);
+    file_ = nullptr;
+}
+
+TraceReader::TraceReader(const std::string& path) {
+    file_ = std::fopen(path.c_str(), "rb");
+    if (!file_) { std::cerr << "Error: failed to open trace: " << path << "\n"; return; }
+    TraceHeader want, h;
+    if (std::fread(&h, sizeof(h), 1, file_) != 1 || std::memcmp(h.magic, want.magic, 4) != 0
+        || h.version != want.version || h.recordSize != want.recordSize) {
+        std::cerr << "Error: not a version " << want.version << " trace: " << path << "\n";
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+TraceReader::~TraceReader() { if (file_) std::fclose(file_); }
+
+size_t TraceReader::read(TraceRecord* out, size_t max) {
+    return file_ ? std::fread(out, sizeof(TraceRecord), max, file_) : 0;
+}
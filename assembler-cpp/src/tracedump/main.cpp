@@ -0,0 +1,62 @@
+// CLI: tracedump trace.trc [--skip N] [--count N]  (decode an emulator --trace file)
+#include "emulator/trace.h"
+#include "decoder/decoder.h"
+#include "decoder/formatter.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: tracedump trace.trc [--skip N] [--count N]\n";
+        return 64;
+    }
+    uint64_t skip = 0, count = UINT64_MAX;
+    for (int i = 2; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--skip" && i + 1 < argc) skip = std::strtoull(argv[++i], nullptr, 0);
+        else if (a == "--count" && i + 1 < argc) count = std::strtoull(argv[++i], nullptr, 0);
+    }
+    TraceReader in(argv[1]);
+    if (!in.ok()) return 1;
+
+    std::vector<TraceRecord> buf(4096);
+    uint64_t seq = 0, shown = 0;
+    char tail[64];
+    for (size_t n; shown < count && (n = in.read(buf.data(), buf.size())) != 0;) {
+        for (size_t k = 0; k < n && shown < count; ++k, ++seq) {
+            if (seq < skip) continue;
+            const TraceRecord& r = buf[k];
+            std::string line = std::to_string(seq);
+            if (line.size() < 10) line.insert(0, 10 - line.size(), ' ');
+            line += "  ";
+            Decoded d;
+            try {
+                d = decodeWord(r.word, r.pc);
+            } catch (const std::runtime_error& e) {
+                std::cout << line << formatPc(r.pc) << ": " << e.what() << "\n";
+                ++shown;
+                continue;
+            }
+            line += formatDecoded(d, true, true);
+            // What the instruction produced: rd's new value, or the store and its address.
+            DecodedInstr di;
+            if (instrLength((uint16_t)r.word) == 2) decodeCompressed((uint16_t)r.word, di);
+            else decodeInstr(r.word, di);
+            tail[0] = 0;
+            if (di.tag == TAG_SW)
+                std::snprintf(tail, sizeof(tail), "  [0x%08x] <- 0x%08x", r.addr, r.value);
+            else if (di.tag == TAG_LW)
+                std::snprintf(tail, sizeof(tail), "  %s = 0x%08x <- [0x%08x]", regName(di.rd), r.value, r.addr);
+            else if (di.rd)
+                std::snprintf(tail, sizeof(tail), "  %s = 0x%08x", regName(di.rd), r.value);
+            if (tail[0] && line.size() < 60) line.append(60 - line.size(), ' ');
+            std::cout << line << tail << "\n";
+            ++shown;
+        }
+    }
+    return 0;
+}
@@ -63,6 +63,12 @@ fw_2:
 fw_3:
     ADDI  x0, x0, 0
 
+# BNE: same B-type layout as BEQ with funct3 = 001
+bne_bk:
+    ADDI  x0, x0, 0
+    BNE   x5, x6, bne_bk      # back -4 bytes
+    BNE   x0, x7, fw_3        # expect 0xfe701ae3
+
 # PC-relative branch to earlier gap (varied spacing)
 gap0:
     ADDI  x0, x0, 0
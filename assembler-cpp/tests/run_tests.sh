@@ -9,9 +9,9 @@ cd "${SCRIPT_DIR}"/..
 # Function to run a test and report status
 run_test() {
     local test_name=$1
-    local test_cmd=$2
+    shift
     printf "=== Running %s tests ===\n" "${test_name}"
-    if ${test_cmd}; then
+    if "$@"; then
         printf "%s tests passed\n" "${test_name}"
         return 0
     else
@@ -33,10 +33,17 @@ cmake --build build -j || { echo "Build failed"; exit 1; }
 failed_tests=0
 
 # Run assembler tests
-run_test "assembler" "./build/test_assemble" || ((failed_tests++))
+run_test "assembler" ./build/test_assemble || ((failed_tests++))
 
 # Run disassembler tests
-run_test "disassembler" "./build/test_disassemble" || ((failed_tests++))
+run_test "disassembler" ./build/test_disassemble || ((failed_tests++))
+
+# Run execution engine tests
+run_test "emulator" ./build/test_emulator || ((failed_tests++))
+
+# Cross-check the C++ decoder against the Rust crate on the top 2^24 words (bits 0-23 vary:
+# every opcode, rd, funct3 and rs1, negative immediates); the full space is `decodecheck` alone
+run_test "decoder conformance" ./build/decodecheck --from 0xff000000 --to 0x100000000 || ((failed_tests++))
 
 # Report overall status
 echo "=== Test Summary ==="
@@ -1,6 +1,452 @@
 #include "assembler/driver.h"
+#include "assembler/encode.h"
+#include "assembler/lexer.h"
+#include "assembler/rv.h"
+#include "common/utils.h"
+#include "decoder/decoder.h"
+#include <array>
+#include <algorithm>
 #include <iostream>
 #include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+void check(bool ok, const std::string& what, int& failed) {
+    std::cout << (ok ? "[PASS] " : "[FAIL] ") << what << "\n";
+    if (!ok) failed++;
+}
+
+// Fixed at compile time: the words are in the binary, nothing runs.
+constexpr auto kSum = rv::program<5>([](auto& a) {
+    using namespace rv;
+    Label loop = a.label();
+    a.li(x5, 10).li(x6, 0);
+    a.bind(loop).add(x6, x6, x5).addi(x5, x5, -1).bne(x5, x0, loop);
+});
+static_assert(rv::addi(rv::x5, rv::x0, 3) == 0x00300293, "ADDI x5, x0, 3");
+static_assert(kSum[4] == 0xfe029ce3, "BNE x5, x0, -8 resolved at compile time");
+
+// The rv:: API must produce the text assembler's bytes, labels and LI expansion included.
+int checkInline() {
+    using namespace rv;
+    int failed = 0;
+    namespace fs = std::filesystem;
+    std::string in = (fs::temp_directory_path() / "test_assemble_rv.s").string();
+    std::string out = (fs::temp_directory_path() / "test_assemble_rv.bin").string();
+    std::ofstream(in) << "start: add x3, x1, x2\nsub x4, x3, x1\naddi x5, x0, -2048\nlw x6, 2047(x2)\n"
+                         "sw x6, -4(x2)\nlui x7, 0xfffff\nauipc x8, 0x5000\njalr x1, x8, 12\n"
+                         "beq x5, x6, end\nbne x5, x0, start\nli x9, 0x12345678\nli x10, 0x40000\n"
+                         "li x11, -1\nmv x12, x11\ncall f\nj start\nf: addi x0, x0, 0\nret\nend: jal x0, end\n";
+    std::vector<uint8_t> text;
+    if (assembleFile(in, out, false) == 0) text = readBinaryFile(out);
+
+    Assembler<> a;
+    Label start = a.here(), end = a.label(), f = a.label();
+    a.add(x3, x1, x2).sub(x4, x3, x1).addi(x5, x0, -2048).lw(x6, 2047, x2).sw(x6, -4, x2);
+    a.lui(x7, 0xfffff).auipc(x8, 5).jalr(x1, x8, 12).beq(x5, x6, end).bne(x5, x0, start);
+    a.li(x9, 0x12345678).li(x10, 0x40000).li(x11, -1).mv(x12, x11).call(f).j(start);
+    a.bind(f).nop().ret();
+    a.bind(end).jal(x0, end);
+    std::vector<uint32_t> words = a.finish();
+    check(!text.empty() && bytes(words) == text, "rv:: program matches the text assembler byte for byte", failed);
+    check(bytes(kSum) == bytes(std::array<uint32_t, 5>{addi(x5, x0, 10), addi(x6, x0, 0), add(x6, x6, x5),
+                                                        addi(x5, x5, -1), bne(x5, x0, -8)}),
+          "constexpr program: backward branch resolved", failed);
+
+    auto throws = [](auto f) {
+        try { f(); } catch (const std::out_of_range&) { return true; }
+        return false;
+    };
+    volatile int32_t big = 2048;
+    check(throws([&] { addi(x1, x1, big); }) && throws([&] { beq(x1, x2, 3); })
+              && throws([&] { Assembler<> b; b.j(b.label()); b.finish(); })
+              && throws([&] { Assembler<1> b; b.nop().nop(); }),
+          "run-time range, alignment, unbound-label and capacity errors throw", failed);
+    return failed;
+}
+
+// Source text straight through the encoder, so a test can set any EncoderOptions and see
+// every diagnostic.
+struct Built {
+    std::vector<uint8_t> image;
+    std::vector<std::string> errors; // parse, then encode
+    ScheduleStats sched{};
+    PeepholeStats peep{};
+
+    uint32_t word(size_t byteOff) const {
+        uint32_t w = 0;
+        for (int k = 3; k >= 0; --k) w = w << 8 | image[byteOff + k];
+        return w;
+    }
+};
+
+Built build(const std::string& src, EncoderOptions eo = {}) {
+    Arena arena;
+    std::vector<Token> toks = Lexer(src).tokenize();
+    Parser ps(toks, arena);
+    Program prog = ps.parse();
+    SymbolTable syms;
+    Encoder enc(prog, syms, eo);
+    Built b;
+    b.image = enc.assemble();
+    b.errors = ps.errors();
+    b.errors.insert(b.errors.end(), enc.errors().begin(), enc.errors().end());
+    b.sched = enc.scheduleStats();
+    b.peep = enc.peepholeStats();
+    return b;
+}
+
+std::string repeat(const char* line, size_t n) {
+    std::string s;
+    for (size_t i = 0; i < n; ++i) s += line;
+    return s;
+}
+
+// AUIPC hi / 12-bit lo split of a PC-relative offset, lo sign-extended.
+int32_t hi20(uint32_t off) { return (int32_t)((off + 0x800u) >> 12); }
+int32_t lo12(uint32_t off) { return (int32_t)(off - ((off + 0x800u) & ~0xfffu)); }
+
+// The arena under the front end: bump allocation, chunk reuse across reset(), oversized
+// requests and std::vector growth through ArenaAllocator.
+int checkArena() {
+    int failed = 0;
+    Arena a(1024);
+    void* first = a.alloc(100);
+    char* big = static_cast<char*>(a.alloc(5000));
+    std::fill(big, big + 5000, 'x');
+    a.alloc(3, 1);
+    void* wide = a.alloc(8, 64);
+    check(a.bytesReserved() >= 1024 + 5000 && a.bytesUsed() >= 5111 && a.highWater() == a.bytesUsed()
+              && (uintptr_t)wide % 64 == 0 && (uintptr_t)first % alignof(std::max_align_t) == 0,
+          "arena: a request larger than a chunk gets its own, alignment is honoured", failed);
+    std::string_view s = a.copy("label");
+    check(s == "label" && a.copy("").empty(), "arena: copy", failed);
+
+    const size_t reserved = a.bytesReserved(), high = a.highWater();
+    a.reset();
+    check(a.bytesUsed() == 0 && a.highWater() == high && a.bytesReserved() == reserved && a.alloc(100) == first,
+          "arena: reset keeps the chunks and the high-water mark", failed);
+    a.alloc(5000);
+
+    auto fill = [&] {
+        ArenaVector<uint32_t> v(a);
+        for (uint32_t k = 0; k < 10000; ++k) v.push_back(k * 3);
+        bool ok = v.size() == 10000;
+        for (uint32_t k = 0; ok && k < v.size(); ++k) ok = v[k] == k * 3;
+        return ok;
+    };
+    bool grown = fill();
+    const size_t after = a.bytesReserved();
+    a.reset();
+    check(grown && after > reserved && fill() && a.bytesReserved() == after && a.highWater() >= 10000 * 4,
+          "arena: ArenaVector grows, and the same job after reset() allocates nothing new", failed);
+    return failed;
+}
+
+// Every bad instruction is reported in one run, in source order, and encodes as a zero word
+// so the good ones after it keep their PCs.
+int checkDiagnostics() {
+    using namespace rv;
+    int failed = 0;
+    Built b = build("addi x5, x0, 1\n"          // 1  0x00
+                    "addi x6, x0, 4096\n"       // 2  0x04
+                    "foo x1, x2\n"              // 3  0x08
+                    "add x1, x2\n"              // 4  0x0c
+                    "beq x1, x2, nowhere\n"     // 5  0x10
+                    "lw x5, x2\n"               // 6  0x14
+                    "L: addi x7, x0, 7\n"       // 7  0x18
+                    "jal x0, L\n");             // 8  0x1c
+    const std::vector<std::string> want = {
+        "encode error (line 2): addi: immediate out of range (4096)",
+        "encode error (line 3): foo: unknown mnemonic",
+        "encode error (line 4): add: operand count mismatch (rd, rs1, rs2)",
+        "encode error (line 5): beq: undefined symbol (nowhere)",
+        "encode error (line 6): lw: expected off(rs1) (x2)",
+    };
+    check(b.errors == want, "diagnostics: one per bad line, in order, with line, mnemonic, reason and operand",
+          failed);
+    bool zeros = b.image.size() == 32;
+    for (size_t at = 4; zeros && at < 0x18; at += 4) zeros = b.word(at) == 0;
+    check(zeros && b.word(0) == addi(x5, x0, 1) && b.word(0x18) == addi(x7, x0, 7) && b.word(0x1c) == jal(x0, -4),
+          "diagnostics: bad lines encode as 0, good ones keep their PCs", failed);
+    return failed;
+}
+
+// Far BEQ/BNE/JAL grow from one word to the smallest long form that reaches; LA is always
+// AUIPC+ADDI.
+int checkRelax() {
+    using namespace rv;
+    int failed = 0;
+    constexpr size_t kNear = 1, kMid = 1100, kFar = 1u << 18; // pad words: <4 KiB, <1 MiB, >1 MiB
+    const char* pad = "addi x0, x0, 0\n";
+
+    struct Case {
+        const char* name;
+        const char* instr;                   // at PC 0, jumping/pointing past the padding to L
+        size_t padWords;
+        std::vector<uint32_t> (*expect)(uint32_t target);
+    };
+    const Case cases[] = {
+        {"near BEQ", "beq x1, x2, L\n", kNear, [](uint32_t t) {
+             return std::vector<uint32_t>{beq(x1, x2, (int32_t)t)}; }},
+        {"mid BEQ (BNE +8; JAL)", "beq x1, x2, L\n", kMid, [](uint32_t t) {
+             return std::vector<uint32_t>{bne(x1, x2, 8), jal(x0, (int32_t)t - 4)}; }},
+        {"far BEQ (BNE +12; AUIPC; JALR)", "beq x1, x2, L\n", kFar, [](uint32_t t) {
+             return std::vector<uint32_t>{bne(x1, x2, 12), auipc(x6, hi20(t - 4)), jalr(x0, x6, lo12(t - 4))}; }},
+        {"near BNE", "bne x3, x0, L\n", kNear, [](uint32_t t) {
+             return std::vector<uint32_t>{bne(x3, x0, (int32_t)t)}; }},
+        {"mid BNE (BEQ +8; JAL)", "bne x3, x0, L\n", kMid, [](uint32_t t) {
+             return std::vector<uint32_t>{beq(x3, x0, 8), jal(x0, (int32_t)t - 4)}; }},
+        {"far BNE (BEQ +12; AUIPC; JALR)", "bne x3, x0, L\n", kFar, [](uint32_t t) {
+             return std::vector<uint32_t>{beq(x3, x0, 12), auipc(x6, hi20(t - 4)), jalr(x0, x6, lo12(t - 4))}; }},
+        {"near JAL", "jal x1, L\n", kMid, [](uint32_t t) {
+             return std::vector<uint32_t>{jal(x1, (int32_t)t)}; }},
+        {"far JAL x1 (AUIPC x1; JALR)", "jal x1, L\n", kFar, [](uint32_t t) {
+             return std::vector<uint32_t>{auipc(x1, hi20(t)), jalr(x1, x1, lo12(t))}; }},
+        {"far JAL x0 (AUIPC x6; JALR)", "jal x0, L\n", kFar, [](uint32_t t) {
+             return std::vector<uint32_t>{auipc(x6, hi20(t)), jalr(x0, x6, lo12(t))}; }},
+        {"near LA (AUIPC; ADDI)", "la x5, L\n", kNear, [](uint32_t t) {
+             return std::vector<uint32_t>{auipc(x5, 0), addi(x5, x5, (int32_t)t)}; }},
+        {"mid LA (AUIPC; ADDI)", "la x5, L\n", kMid, [](uint32_t t) {
+             return std::vector<uint32_t>{auipc(x5, hi20(t)), addi(x5, x5, lo12(t))}; }},
+        {"far LA (AUIPC; ADDI)", "la x5, L\n", kFar, [](uint32_t t) {
+             return std::vector<uint32_t>{auipc(x5, hi20(t)), addi(x5, x5, lo12(t))}; }},
+    };
+    for (const Case& c : cases) {
+        Built b = build(std::string(c.instr) + repeat(pad, c.padWords) + "L: addi x0, x0, 0\n");
+        size_t size = b.image.size() - 4 * (c.padWords + 1);
+        std::vector<uint32_t> want = c.expect((uint32_t)(size + 4 * c.padWords));
+        bool ok = b.errors.empty() && size == 4 * want.size();
+        for (size_t k = 0; ok && k < want.size(); ++k) ok = b.word(4 * k) == want[k];
+        check(ok, std::string(c.name) + ": " + std::to_string(want.size() * 4) + " bytes", failed);
+    }
+
+    // Backward: the target does not move as the branch grows, and the short form is re-tried.
+    Built back = build("L: addi x0, x0, 0\n" + repeat(pad, kMid) + "bne x1, x0, L\n");
+    uint32_t at = 4 * (kMid + 1);
+    check(back.errors.empty() && back.image.size() == at + 8 && back.word(at) == beq(x1, x0, 8)
+              && back.word(at + 4) == jal(x0, -(int32_t)at - 4),
+          "mid backward BNE (BEQ +8; JAL)", failed);
+
+    // The far forms through the scratch register must not clobber one the program uses.
+    std::string usesX6 = "jal x0, L\n" + repeat(pad, kFar) + "L: add x6, x6, x6\n";
+    Built clash = build(usesX6);
+    check(clash.errors.size() == 1 && clash.errors[0].find("x6 is used") != std::string::npos,
+          "far JAL x0 refused when x6 is in use", failed);
+    EncoderOptions eo;
+    eo.scratch = 7;
+    Built other = build(usesX6, eo);
+    uint32_t t = 4 * (kFar + 2);
+    check(other.errors.empty() && other.word(0) == auipc(x7, hi20(t)) && other.word(4) == jalr(x0, x7, lo12(t)),
+          "--scratch x7: far JAL x0 goes through x7", failed);
+    Built branch = build("beq x1, x2, L\n" + repeat(pad, kFar) + "L: lw x6, 0(x2)\n");
+    check(branch.errors.size() == 1 && branch.errors[0].find("x6 is used") != std::string::npos,
+          "far BEQ refused when x6 is in use", failed);
+    check(build("beq x1, x2, L\n" + repeat(pad, kMid) + "L: lw x6, 0(x2)\n").errors.empty(),
+          "mid BEQ needs no scratch register", failed);
+    return failed;
+}
+
+// la, j, call and tail as the encoder emits them, near and relaxed.
+int checkPseudo() {
+    using namespace rv;
+    int failed = 0;
+    auto words = [](const Built& b) {
+        std::vector<uint32_t> w;
+        for (size_t k = 0; b.errors.empty() && k + 4 <= b.image.size(); k += 4) w.push_back(b.word(k));
+        return w;
+    };
+    using W = std::vector<uint32_t>;
+
+    // PC-relative both ways, so the address is right wherever the image is loaded.
+    check(words(build("la x5, L\naddi x0, x0, 0\nL: la x6, L\n"))
+              == W{auipc(x5, 0), addi(x5, x5, 12), nop(), auipc(x6, 0), addi(x6, x6, 0)},
+          "la: AUIPC+ADDI forward and onto itself", failed);
+    check(words(build("L: addi x0, x0, 0\nla x7, L\n")) == W{nop(), auipc(x7, 0), addi(x7, x7, -4)},
+          "la: backward", failed);
+    check(words(build("la x5, 0x12345\n")) == W{lui(x5, 0x12), addi(x5, x5, 0x345)}, "la with a number is li",
+          failed);
+    EncoderOptions rvc;
+    rvc.compress = true;
+    Built small = build("la x8, L\nL: addi x0, x0, 0\n", rvc);
+    check(small.image.size() == 10 && words(small) == W{auipc(x8, 0), addi(x8, x8, 8)},
+          "la: no 16-bit form under --rvc", failed);
+
+    check(words(build("L: j L\ncall L\ntail L\nret\n")) == W{j(0), jal(x1, -4), jal(x0, -8), ret()},
+          "j, call, tail, ret: near", failed);
+    const size_t kFar = 1u << 18;
+    std::string pad = repeat("addi x0, x0, 0\n", kFar);
+    uint32_t t = 4 * (kFar + 2); // L, from the first word of each two-word form
+    W far = words(build("call L\n" + pad + "L: ret\n"));
+    check(far.size() == kFar + 3 && far[0] == auipc(x1, hi20(t)) && far[1] == jalr(x1, x1, lo12(t)),
+          "call: relaxed to AUIPC x1; JALR x1", failed);
+    for (const char* m : {"tail", "j"}) {
+        far = words(build(std::string(m) + " L\n" + pad + "L: ret\n"));
+        check(far.size() == kFar + 3 && far[0] == auipc(x6, hi20(t)) && far[1] == jalr(x0, x6, lo12(t)),
+              std::string(m) + ": relaxed to AUIPC x6; JALR x0", failed);
+        Built clash = build(std::string(m) + " L\n" + pad + "L: mv x10, x6\n");
+        check(clash.errors.size() == 1 && clash.errors[0].find("x6 is used") != std::string::npos,
+              std::string(m) + ": far form refused when x6 is in use", failed);
+    }
+    return failed;
+}
+
+// Operands of a commutative operation in a fixed order, and ADD rd, x0, rs (C.MV's
+// expansion) as the MV it came from, so two records compare equal when they do the same thing.
+DecodedInstr canonical(DecodedInstr d) {
+    if (d.tag == TAG_ADD && (d.rs1 == 0 || d.rs2 == 0)) return {TAG_ADDI, d.rd, (uint8_t)(d.rs1 | d.rs2), 0, 0};
+    if ((d.tag == TAG_ADD || d.tag == TAG_BEQ || d.tag == TAG_BNE) && d.rs1 > d.rs2) std::swap(d.rs1, d.rs2);
+    return d;
+}
+
+bool operator==(const DecodedInstr& a, const DecodedInstr& b) {
+    return a.tag == b.tag && a.rd == b.rd && a.rs1 == b.rs1 && a.rs2 == b.rs2 && a.imm == b.imm;
+}
+
+// Every RVC form --rvc emits, checked against an independent assembler's parcel (llvm-mc
+// -mattr=+c), then decoded back: the parcel must do what the 32-bit word it replaced does.
+// Offsets are literal so both layouts agree on them.
+int checkCompress() {
+    int failed = 0;
+    struct Form { const char* src; uint16_t parcel; }; // parcel 0: stays 32-bit
+    const Form forms[] = {
+        {"addi x0, x0, 0", 0x0001},   {"addi x9, x9, -3", 0x14f5},  {"addi x10, x0, 31", 0x457d},
+        {"addi x2, x2, -64", 0x7139}, {"addi x8, x2, 1020", 0x1fe0}, {"mv x11, x12", 0x85b2},
+        {"add x5, x5, x7", 0x929e},   {"add x5, x0, x7", 0x829e},   {"sub x8, x8, x15", 0x8c1d},
+        {"lw x9, 124(x10)", 0x5d64},  {"sw x11, 64(x15)", 0xc3ac},  {"lw x1, 252(x2)", 0x50fe},
+        {"sw x31, 8(x2)", 0xc47e},    {"lui x3, 0x1f", 0x61fd},     {"lui x3, 0xfffe0", 0x7181},
+        {"jal x0, -2048", 0xb001},    {"jal x1, 2046", 0x2ffd},     {"ret", 0x8082},
+        {"jalr x1, x5, 0", 0x9282},   {"beq x8, x0, -256", 0xd001}, {"bne x15, x0, 254", 0xeffd},
+        // No 16-bit form: immediate too wide, register outside x8..x15, offset out of reach.
+        {"addi x9, x9, 32", 0},       {"sub x5, x5, x6", 0},        {"lw x9, 128(x10)", 0},
+        {"auipc x5, 0", 0},           {"jal x5, 8", 0},             {"beq x5, x0, 8", 0},
+    };
+    std::string src;
+    for (const Form& f : forms) (src += f.src) += "\n";
+    EncoderOptions rvc;
+    rvc.compress = true;
+    Built full = build(src), mixed = build(src, rvc);
+    check(full.errors.empty() && mixed.errors.empty() && full.image.size() == 4 * std::size(forms),
+          "rvc: round-trip program assembles", failed);
+    size_t at = 0, expectBytes = 0;
+    for (const Form& f : forms) expectBytes += f.parcel ? 2 : 4;
+    for (size_t k = 0; k < std::size(forms) && full.errors.empty() && at + 2 <= mixed.image.size(); ++k) {
+        const Form& f = forms[k];
+        DecodedInstr want, got;
+        bool ok = decodeInstr(full.word(4 * k), want);
+        uint16_t half = (uint16_t)(mixed.image[at] | mixed.image[at + 1] << 8);
+        if (f.parcel) {
+            ok = ok && half == f.parcel && decodeCompressed(half, got);
+            at += 2;
+        } else {
+            ok = ok && (half & 3) == 3 && at + 4 <= mixed.image.size() && mixed.word(at) == full.word(4 * k);
+            got = want;
+            at += 4;
+        }
+        check(ok && canonical(got) == canonical(want), std::string("rvc: ") + f.src, failed);
+    }
+    check(at == mixed.image.size() && mixed.image.size() == expectBytes, "rvc: image size with mixed 16/32-bit forms",
+          failed);
+    return failed;
+}
+
+// --sched: the new order is checked against the same program written in that order.
+int checkSchedule() {
+    int failed = 0;
+    auto scheduled = [&](const std::string& src, const std::string& want, unsigned load, uint64_t before,
+                         uint64_t after, const std::string& what) {
+        EncoderOptions eo;
+        eo.schedule = true;
+        eo.latency.load = load;
+        Built got = build(src, eo), ref = build(want);
+        check(got.errors.empty() && got.sched.skipped == nullptr && got.image == ref.image
+                  && got.sched.stallsBefore == before && got.sched.stallsAfter == after
+                  && got.sched.reordered == (before != after),
+              what + ": stalls " + std::to_string(got.sched.stallsBefore) + " -> "
+                  + std::to_string(got.sched.stallsAfter), failed);
+    };
+
+    // The independent ADDI fills the load's shadow; a longer latency pulls in both.
+    const std::string use = "lw x5, 0(x2)\nadd x6, x5, x5\naddi x7, x0, 1\naddi x8, x0, 2\n";
+    scheduled(use, "lw x5, 0(x2)\naddi x7, x0, 1\nadd x6, x5, x5\naddi x8, x0, 2\n", 2, 1, 0,
+              "load-use stall hidden");
+    scheduled(use, "lw x5, 0(x2)\naddi x7, x0, 1\naddi x8, x0, 2\nadd x6, x5, x5\n", 3, 2, 0,
+              "load latency 3: two instructions fill the shadow");
+
+    // ADDI x9 may not move above the AUIPC to hide the first stall, but fills the second
+    // one. The LW may not pass the SW, ADDI x10 may not pass the ADD reading x10 (WAR) and
+    // the BEQ that ends the block stays last.
+    scheduled("lw x5, 0(x2)\nadd x6, x5, x5\nauipc x7, 0\naddi x9, x0, 1\n"
+              "lw x10, 4(x2)\nadd x11, x10, x10\nsw x11, 8(x2)\nlw x12, 12(x2)\naddi x10, x0, 1\n"
+              "addi x13, x0, 1\nbeq x13, x0, L\nL: addi x0, x0, 0\n",
+              "lw x5, 0(x2)\nadd x6, x5, x5\nauipc x7, 0\nlw x10, 4(x2)\naddi x9, x0, 1\n"
+              "add x11, x10, x10\nsw x11, 8(x2)\nlw x12, 12(x2)\naddi x10, x0, 1\naddi x13, x0, 1\n"
+              "beq x13, x0, L\nL: addi x0, x0, 0\n",
+              2, 2, 1, "AUIPC, block end, memory order and WAR hold");
+
+    // A label starts a new block: the ADDI after it may not move up into the load's shadow.
+    scheduled("lw x5, 0(x2)\nadd x6, x5, x5\nL: addi x7, x0, 1\n",
+              "lw x5, 0(x2)\nadd x6, x5, x5\nL: addi x7, x0, 1\n", 2, 1, 1, "nothing crosses a label");
+
+    // The BEQ skips to the ADDI by literal offset; scheduling would move the ADD into its place.
+    EncoderOptions eo;
+    eo.schedule = true;
+    const std::string literal = "beq x0, x0, 12\nlw x5, 0(x2)\nadd x6, x5, x5\naddi x7, x0, 1\nL: beq x0, x0, L\n";
+    Built lit = build(literal, eo);
+    check(lit.errors.empty() && lit.sched.skipped != nullptr && lit.sched.reordered == 0
+              && lit.image == build(literal).image,
+          "literal branch offset: program left untouched", failed);
+    return failed;
+}
+
+// -O: each rule on a minimal program, checked against the expected result written out by
+// hand, plus programs the pass must leave alone.
+int checkPeephole() {
+    int failed = 0;
+    using Hits = std::array<size_t, PeepholeStats::kRules>; // addi-zero, x0-write, jump-next, addi-fold, dead-write
+    auto optimized = [&](const std::string& src, const std::string& want, Hits hits, const std::string& what) {
+        EncoderOptions eo;
+        eo.optimize = true;
+        Built got = build(src, eo), ref = build(want);
+        check(got.errors.empty() && got.peep.skipped == nullptr && got.image == ref.image
+                  && std::equal(hits.begin(), hits.end(), got.peep.hits),
+              "-O " + what, failed);
+    };
+
+    optimized("addi x5, x5, 0\nmv x6, x6\nadd x7, x5, x6\n", "add x7, x5, x6\n", {2, 0, 0, 0, 0},
+              "addi-zero: ADDI/MV of a register to itself");
+    optimized("add x0, x5, x6\nlui x0, 5\naddi x0, x0, 0\naddi x7, x0, 1\n", "addi x7, x0, 1\n",
+              {0, 3, 0, 0, 0}, "x0-write: results written to x0");
+    optimized("beq x5, x6, L\nj L\nL: addi x7, x0, 1\n", "L: addi x7, x0, 1\n", {0, 0, 2, 0, 0},
+              "jump-next: jumps to the next instruction, and a branch that becomes one");
+    optimized("addi x5, x6, 10\nadd x7, x8, x9\naddi x5, x5, 20\n", "add x7, x8, x9\naddi x5, x6, 30\n",
+              {0, 0, 0, 1, 0}, "addi-fold: ADDI chain through an unrelated instruction");
+    optimized("addi x5, x0, 1\nlui x6, 2\naddi x5, x0, 2\nadd x6, x5, x5\n", "addi x5, x0, 2\nadd x6, x5, x5\n",
+              {0, 0, 0, 0, 2}, "dead-write: values overwritten before any read");
+
+    // Nothing fires: the program must assemble exactly as without -O.
+    const Hits none{};
+    auto kept = [&](const std::string& src, const std::string& what) { optimized(src, src, none, what); };
+    kept("addi x5, x6, 10\nL: addi x5, x5, 20\nbne x7, x0, L\n", "addi-fold stops at a label");
+    kept("addi x5, x6, 10\nadd x7, x5, x5\naddi x5, x5, 20\n", "addi-fold keeps a value that is read");
+    kept("addi x5, x6, 2000\naddi x5, x5, 100\n", "addi-fold keeps a sum that does not fit 12 bits");
+    kept("addi x5, x0, 1\nbeq x6, x0, L\naddi x5, x0, 2\nL: add x7, x5, x5\n",
+         "dead-write keeps a value live on the taken path");
+    kept("L: beq x5, x6, L\nj M\naddi x7, x0, 1\nM: addi x8, x0, 1\n",
+         "jump-next keeps a jump over live code and a branch to itself");
+
+    EncoderOptions eo;
+    eo.optimize = true;
+    const std::string pic = "auipc x5, 0\naddi x6, x6, 0\n";
+    Built skipped = build(pic, eo);
+    check(skipped.peep.skipped != nullptr && skipped.image == build(pic).image,
+          "-O skips position-dependent code (AUIPC)", failed);
+    return failed;
+}
+
+} // namespace
 
 int main() {
     namespace fs = std::filesystem;
@@ -26,6 +472,14 @@ int main() {
             std::cout << "Wrote " << out_bin << " and " << out_hex << "\n";
         }
     }
+    failed += checkInline();
+    failed += checkArena();
+    failed += checkDiagnostics();
+    failed += checkRelax();
+    failed += checkPseudo();
+    failed += checkCompress();
+    failed += checkSchedule();
+    failed += checkPeephole();
     std::cout << "\nAssembly test done (" << failed << " failed)\n";
     return failed;
 }
@@ -1,6 +1,132 @@
+#include "assembler/driver.h"
+#include "decoder/cfg.h"
+#include "decoder/decoder.h"
 #include "decoder/disassembler_driver.h"
+#include "common/utils.h"
 #include <iostream>
 #include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// Assembles src through the real driver and returns the image (empty on error).
+std::vector<uint8_t> assemble(const std::string& src, const std::string& path, const AsmOptions& opts = {}) {
+    std::string in = path + ".s";
+    std::ofstream(in) << src;
+    Arena arena;
+    if (assembleFile(in, path, opts, arena) != 0) return {};
+    return readBinaryFile(path);
+}
+
+// Listing of the image at path, as disassembleFile prints it.
+std::string listing(const std::string& path, DisasmMode mode) {
+    std::ostringstream os;
+    std::streambuf* old = std::cout.rdbuf(os.rdbuf());
+    int rc = disassembleFile(path, true, false, mode);
+    std::cout.rdbuf(old);
+    return rc == 0 ? os.str() : std::string();
+}
+
+// Words between functions that nothing reaches must stay data, calls and branches must be
+// followed, and the listing must name targets instead of printing addresses.
+int checkRecursive() {
+    int failed = 0;
+    auto check = [&](bool ok, const char* what) {
+        std::cout << (ok ? "[PASS] " : "[FAIL] ") << what << "\n";
+        if (!ok) failed++;
+    };
+    namespace fs = std::filesystem;
+    std::string path = (fs::temp_directory_path() / "test_disasm_cfg.bin").string();
+    std::vector<uint8_t> img = assemble("addi x5, x0, 3\n"     // 00
+                                        "beq x5, x0, a\n"      // 04 -> 14
+                                        "call f\n"             // 08 -> 1c
+                                        "h: j h\n"             // 0c
+                                        "add x1, x2, x3\n"     // 10 unreachable
+                                        "a: j h\n"             // 14
+                                        "add x1, x2, x3\n"     // 18 unreachable
+                                        "f: addi x10, x0, 1\n" // 1c
+                                        "ret\n",               // 20
+                                        path);
+    ImageCfg g = buildImageCfg(img.data(), img.size());
+    const uint32_t X = ImageCfg::kExit, N = ImageCfg::kNone;
+    check(g.instrs == 7 && !g.isCode(0x10) && !g.isCode(0x18) && g.isCode(0x1c), "cfg: data words are not code");
+    check(g.blocks() == 5 && g.start == std::vector<uint32_t>({0x00, 0x08, 0x0c, 0x14, 0x1c})
+              && g.end == std::vector<uint32_t>({0x08, 0x0c, 0x10, 0x18, 0x24}),
+          "cfg: block boundaries");
+    check(g.fall == std::vector<uint32_t>({1, 2, N, N, N}) && g.taken == std::vector<uint32_t>({3, 4, 2, 2, X}),
+          "cfg: edges (a call falls through to its return point, ret goes nowhere known)");
+    check(g.flags[0] == ImageCfg::kEntry && g.flags[2] == ImageCfg::kJumpTarget
+              && g.flags[4] == ImageCfg::kCallTarget && g.blockAt(0x1c) == 4 && g.blockAt(0x20) == N,
+          "cfg: entry, jump and call targets");
+
+    // auipc x6, 0; jalr x1, x6, 12 calls 0c.
+    std::vector<uint8_t> ind = assemble("auipc x6, 0\njalr x1, x6, 12\nh: j h\nret\n", path);
+    ImageCfg h = buildImageCfg(ind.data(), ind.size());
+    check(h.instrs == 4 && h.blocks() == 3 && h.taken[0] == 2 && h.fall[0] == 1 && h.flags[2] == ImageCfg::kCallTarget,
+          "cfg: AUIPC+JALR with a constant target is followed");
+
+    writeBinaryFile(path, img);
+    std::string s = listing(path, DisasmMode::Recursive);
+    check(s.find("f_00000000:\n00000000: ADDI x5, x0, 3\n00000004: BEQ x5, x0, L_00000014\n") == 0
+              && s.find("00000008: JAL x1, f_0000001c\nL_0000000c:\n0000000c: JAL x0, L_0000000c\n") != std::string::npos
+              && s.find("00000010: .word 0x003100b3\nL_00000014:\n") != std::string::npos
+              && s.find("\nf_0000001c:\n0000001c: ADDI x10, x0, 1\n") != std::string::npos,
+          "recursive listing: labels for targets, data as .word");
+    return failed;
+}
+
+// An --rvc image mixes 16-bit parcels and 32-bit words: both listings must step by each
+// parcel's own size and show every C. form as the base instruction it expands to.
+int checkCompressed() {
+    int failed = 0;
+    auto check = [&](bool ok, const char* what) {
+        std::cout << (ok ? "[PASS] " : "[FAIL] ") << what << "\n";
+        if (!ok) failed++;
+    };
+    namespace fs = std::filesystem;
+    std::string path = (fs::temp_directory_path() / "test_disasm_rvc.bin").string();
+    AsmOptions rvc;
+    rvc.compress = true;
+    std::vector<uint8_t> img = assemble("li x9, 10\n"            // 00 C.LI
+                                        "loop: addi x9, x9, -1\n" // 02 C.ADDI
+                                        "bne x9, x0, loop\n"      // 04 C.BNEZ -> 02
+                                        "addi x10, x0, 1000\n"    // 06 32-bit
+                                        "mv x11, x10\n"           // 0a C.MV
+                                        "ret\n",                  // 0c C.JR
+                                        path, rvc);
+    check(img.size() == 14, "rvc: 5 parcels and one word");
+    auto rest = [](const char* target) {
+        return std::string("00000002: C.ADDI x9, x9, -1\n00000004: C.BNE x9, x0, ") + target
+             + "\n00000006: ADDI x10, x0, 1000\n0000000a: C.ADD x11, x0, x10\n0000000c: C.JALR x0, x1, 0\n";
+    };
+    check(listing(path, DisasmMode::Linear) == "00000000: C.ADDI x9, x0, 10\n" + rest("0x00000002"),
+          "rvc: linear listing of a mixed image");
+    check(listing(path, DisasmMode::Recursive)
+              == "f_00000000:\n00000000: C.ADDI x9, x0, 10\nL_00000002:\n" + rest("L_00000002"),
+          "rvc: recursive listing of a mixed image");
+    return failed;
+}
+
+// decodeWord's exception carries the disassembler's wording for an undecodable parcel.
+int checkUnknown() {
+    int failed = 0;
+    auto thrown = [](uint32_t w) {
+        try { decodeWord(w, 0); } catch (const std::runtime_error& e) { return std::string(e.what()); }
+        return std::string();
+    };
+    auto check = [&](bool ok, const char* what) {
+        std::cout << (ok ? "[PASS] " : "[FAIL] ") << what << "\n";
+        if (!ok) failed++;
+    };
+    check(thrown(0x0000007f) == "unknown encoding: opcode=0x7f word=0x0000007f"
+              && thrown(0x12340000) == "unknown encoding: opcode=0x0 word=0x00000000",
+          "unknown encoding: word and RVC parcel");
+    return failed;
+}
+
+} // namespace
 
 int main() {
     namespace fs = std::filesystem;
@@ -11,12 +137,16 @@ int main() {
         if (f.path().extension() == ".bin") {
             std::cout << "[DISASM] " << f.path().filename().string() << "\n";
             int rc = disassembleFile(f.path().string(), true, true);
+            if (rc == 0) rc = disassembleFile(f.path().string(), true, true, DisasmMode::Recursive);
             if (rc != 0) {
                 std::cerr << "Disasm failed for " << f.path() << "\n";
                 failed++;
             }
         }
     }
+    failed += checkRecursive();
+    failed += checkCompressed();
+    failed += checkUnknown();
     std::cout << "\nDisassembly test done (" << failed << " failed)\n";
     return failed;
 }
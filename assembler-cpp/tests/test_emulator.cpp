@@ -0,0 +1,514 @@
+#include "assembler/driver.h"
+#include "emulator/batch.h"
+#include "emulator/cache.h"
+#include "emulator/checkpoint.h"
+#include "emulator/engine.h"
+#include "emulator/fuzz.h"
+#include "emulator/lockstep.h"
+#include "emulator/predict.h"
+#include "emulator/profile.h"
+#include "emulator/sample.h"
+#include "common/linemap.h"
+#include "emulator/timing.h"
+#include "emulator/trace.h"
+#include "common/utils.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+int failed = 0;
+
+void check(bool ok, const std::string& what) {
+    std::cout << (ok ? "[PASS] " : "[FAIL] ") << what << "\n";
+    if (!ok) failed++;
+}
+
+// Assembles src through the real driver and returns the image (empty on error).
+std::vector<uint8_t> assemble(const std::string& src, const AsmOptions& opts = {}) {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path();
+    std::string in = (dir / "test_emulator.s").string(), out = (dir / "test_emulator.bin").string();
+    std::ofstream(in) << src;
+    Arena arena;
+    if (assembleFile(in, out, opts, arena) != 0) return {};
+    return readBinaryFile(out);
+}
+
+} // namespace
+
+int main() {
+    {
+        // sum 1..10 with a BNE loop, then halt on `JAL x0, self`
+        Engine eng(assemble("li x5, 10\nli x6, 0\nloop: add x6, x6, x5\naddi x5, x5, -1\n"
+                            "bne x5, x0, loop\nend: j end\n"));
+        RunResult r = eng.run(1000);
+        check(r.reason == StopReason::Halted && eng.hart().x[6] == 55, "loop sum halts with x6 = 55");
+        check(r.instrs == 2 + 3 * 10 + 1, "retired instruction count");
+    }
+    {
+        Engine eng(assemble("li x2, 0x800\nli x5, 0x12345678\nsw x5, 4(x2)\nlw x7, 4(x2)\n"
+                            "call fn\nj done\nfn: addi x8, x0, 1\nret\ndone: addi x9, x0, 2\n"));
+        RunResult r = eng.run(1000);
+        const uint32_t* x = eng.hart().x;
+        check(r.reason == StopReason::EndOfImage && x[7] == 0x12345678 && x[8] == 1 && x[9] == 2,
+              "SW/LW round trip, call/ret, run off the end");
+    }
+    {
+        Engine eng(assemble("lui x2, 0x80000\nlw x5, 0(x2)\n"), 4096);
+        RunResult r = eng.run(10);
+        check(r.reason == StopReason::MemFault && r.addr == 0x80000000 && r.pc == 4, "LW outside memory faults");
+    }
+    {
+        // 4 GiB is the whole address space, not a size truncated to 0; pages still come on demand.
+        Engine eng(assemble("lui x1, 0x10000\nsw x1, 0(x1)\nlui x2, 0xfffff\nsw x1, 0x7fc(x2)\nlw x3, 0x7fc(x2)\n"),
+                   Engine::kMaxMem);
+        RunResult r = eng.run(10);
+        check(eng.memory().size() == Engine::kMaxMem && r.reason == StopReason::EndOfImage
+                  && eng.hart().x[3] == 0x10000000,
+              "4 GiB of memory reaches the top of the address space");
+    }
+    {
+        Engine eng(assemble("loop: addi x5, x5, 1\nj loop\n"));
+        RunResult r = eng.run(7);
+        check(r.reason == StopReason::Budget && r.instrs == 7 && eng.hart().x[5] == 4, "budget stops a loop");
+    }
+    {
+        // LW feeding the next instruction: one load-use bubble; taken BEQ: two bubbles.
+        Engine eng(assemble("lw x5, 0(x0)\nadd x6, x5, x5\nbeq x0, x0, skip\naddi x0, x0, 0\n"
+                            "skip: addi x7, x0, 1\n"));
+        PipelineModel m(eng.imageSize());
+        eng.run(100, m);
+        check(m.instrs() == 4 && m.loadUseStalls() == 1 && m.controlStalls() == 2, "load-use and branch stalls");
+        check(m.cycles() == 4 + 1 + 2 + 4, "cycle count includes pipeline fill");
+        check(m.perPc()[4 >> 1].dataStalls == 1 && m.perPc()[8 >> 1].controlStalls == 2, "per-PC attribution");
+    }
+    {
+        // Two lines in the same set: conflict misses when direct-mapped, none after warm-up
+        // with two ways; LRU then evicts the least recently used of three.
+        CacheConfig c;
+        check(parseCacheConfig("1K:1:32", c) && !cacheConfigError(c), "parse cache spec");
+        CacheConfig bad;
+        check(parseCacheConfig("0:2:2048M", bad) && cacheConfigError(bad) && parseCacheConfig("1K:2:1K", bad)
+                  && cacheConfigError(bad) && parseCacheConfig("3K:1:32", bad) && cacheConfigError(bad),
+              "cache spec: line or set larger than the cache, sets not a power of two");
+        Cache dm(c);
+        for (int k = 0; k < 8; ++k) dm.access(k & 1 ? 1024 : 0, false);
+        c.ways = 2;
+        Cache two(c);
+        for (int k = 0; k < 8; ++k) two.access(k & 1 ? 1024 : 0, false);
+        check(dm.stats().misses() == 8 && two.stats().misses() == 2, "direct-mapped vs 2-way conflicts");
+        two.access(0, false); two.access(2048, false); // evicts 1024, not 0
+        check(two.access(0, false) && !two.access(1024, false), "LRU victim");
+    }
+    {
+        // Write-back L1 over an L2: dirty victims reach the L2 as writes.
+        CacheConfig l1, l2;
+        parseCacheConfig("64:1:32:wb", l1);
+        parseCacheConfig("1K:2:32", l2);
+        Cache next(l2), first(l1, &next);
+        first.access(0, true);
+        first.access(64, false); // same set: writes back line 0
+        check(first.stats().writebacks == 1 && next.stats().writes == 1 && next.stats().reads == 2,
+              "write-back victim goes to L2");
+    }
+    {
+        // A 4-trip inner loop: static BTFN misses every exit, gshare learns the pattern;
+        // call/ret pairs are predicted by the RAS after the BTB has seen the call once.
+        Engine eng(assemble("li x10, 200\nouter: li x11, 4\ninner: addi x11, x11, -1\ncall leaf\n"
+                            "bne x11, x0, inner\naddi x10, x10, -1\nbne x10, x0, outer\nend: j end\n"
+                            "leaf: ret\n"));
+        std::vector<std::unique_ptr<DirectionPredictor>> preds;
+        preds.push_back(makePredictor("static"));
+        preds.push_back(makePredictor("gshare", 10));
+        BranchModel bm(eng.imageSize(), std::move(preds));
+        RunResult r = eng.run(100000, bm);
+        check(r.reason == StopReason::Halted && bm.totals().returns == 800 && bm.totals().rasMisses == 0,
+              "returns predicted by the RAS");
+        check(bm.mispredicts(0) >= 200 && bm.mispredicts(1) < 40, "gshare learns a short loop, static does not");
+        std::ostringstream os;
+        bm.report(os, eng, 1);
+        std::string s = os.str();
+        size_t byStatic = s.find("top mispredicts (static):"), byGshare = s.find("top mispredicts (gshare");
+        size_t inner = s.find("BNE x11, x0", byStatic);
+        check(byStatic != std::string::npos && byGshare != std::string::npos && byStatic < inner && inner < byGshare,
+              "mispredict report ranks each predictor separately");
+    }
+    {
+        // Counts rebuilt from flow entries match counting every retirement, including a run
+        // that stops on its budget mid-block and is then resumed.
+        struct Retired : NullObserver {
+            std::vector<uint64_t> n = std::vector<uint64_t>(64, 0);
+            void retire(uint32_t pc, const Op&) { ++n[pc >> 1]; }
+        };
+        struct Both : NullObserver {
+            ProfileModel& p; Retired& r;
+            Both(ProfileModel& p, Retired& r) : p(p), r(r) {}
+            void control(uint32_t pc, const Op& op, bool t, uint32_t tg) { p.control(pc, op, t, tg); }
+            void retire(uint32_t pc, const Op& op) { r.retire(pc, op); }
+        };
+        Engine eng(assemble("li x10, 9\nouter: li x11, 3\ninner: addi x11, x11, -1\ncall leaf\n"
+                            "bne x11, x0, inner\naddi x10, x10, -1\nbne x10, x0, outer\nend: j end\n"
+                            "leaf: addi x12, x12, 1\nret\n"));
+        ProfileModel prof(eng.imageSize());
+        Retired ret;
+        Both both(prof, ret);
+        for (uint64_t budget : {37u, 1000u}) {
+            prof.begin(eng.hart().pc);
+            prof.end(eng.run(budget, both));
+        }
+        std::vector<uint64_t> c = prof.counts(eng);
+        bool same = true;
+        for (uint32_t pc = 0; pc < eng.imageSize(); pc += 4) same = same && c[pc >> 1] == ret.n[pc >> 1];
+        check(same, "profile counts from flow entries");
+
+        LineMap m, back;
+        m.source = "k.s";
+        m.runs = {{0, 1}, {4, 3}, {12, 2}, {400, 90}};
+        std::string path = (std::filesystem::temp_directory_path() / "test_emulator.map").string();
+        check(writeLineMap(path, m) && readLineMap(path, back) && back.source == "k.s" && back.runs == m.runs
+              && back.lineAt(8) == 3 && back.lineAt(13) == 2 && back.lineAt(1000) == 90, "line map round trip");
+    }
+    {
+        // A ring far smaller than the run forces the producer to wait on the drain thread.
+        Engine eng(assemble("li x2, 0x400\nli x5, 300\nloop: sw x5, 0(x2)\nlw x6, 0(x2)\n"
+                            "addi x5, x5, -1\nbne x5, x0, loop\nend: j end\n"));
+        std::string path = (std::filesystem::temp_directory_path() / "test_emulator.trc").string();
+        TraceWriter tw(eng.hart(), path, 256);
+        RunResult r = eng.run(10000, tw);
+        tw.flush();
+        std::vector<TraceRecord> recs(2000);
+        TraceReader in(path);
+        size_t n = in.read(recs.data(), recs.size());
+        check(r.reason == StopReason::Halted && tw.records() == r.instrs && n == r.instrs, "trace has every retirement");
+        const TraceRecord& st = recs[2 + 4 * 7];     // 8th SW: x5 = 293 to 0x400
+        const TraceRecord& ld = recs[2 + 4 * 7 + 1];
+        check(st.pc == 8 && st.value == 293 && st.addr == 0x400 && ld.pc == 12 && ld.value == 293
+              && ld.addr == 0x400 && recs[n - 1].pc == 24, "trace records value and address");
+    }
+    {
+        // More threads than programs of very different lengths; each keeps its own memory.
+        namespace fs = std::filesystem;
+        std::vector<BatchJob> jobs;
+        std::vector<uint32_t> want;
+        for (int k = 0; k < 12; ++k) {
+            std::string p = (fs::temp_directory_path() / ("test_emulator_batch" + std::to_string(k) + ".bin")).string();
+            writeBinaryFile(p, assemble("li x2, 0x400\nlw x6, 0(x2)\nli x5, " + std::to_string(k * 50) +
+                                        "\nloop: addi x6, x6, 1\naddi x5, x5, -1\nbne x5, x0, loop\n"
+                                        "sw x6, 0(x2)\nend: j end\n"));
+            jobs.push_back({p, 0});
+            want.push_back(k * 50);
+        }
+        jobs[0].budget = 10; // k = 0 loops 2^32 times
+        jobs.push_back({(fs::temp_directory_path() / "test_emulator_missing.bin").string(), 0});
+        BatchOptions opts;
+        opts.threads = 5;
+        opts.budget = 100000;
+        BatchStats st;
+        std::vector<BatchResult> res = runBatch(jobs, opts, &st);
+        bool ok = res[0].run.reason == StopReason::Budget && res[0].run.instrs == 10 && !res.back().loaded;
+        for (int k = 1; k < 12; ++k)
+            ok = ok && res[k].run.reason == StopReason::Halted && res[k].hart.x[6] == want[k];
+        check(ok && st.threads == 5, "batch: budgets, isolated memory, missing image");
+        std::ostringstream rep;
+        writeBatchReport(rep, jobs, res, st);
+        check(rep.str().find("\"budget\": 1, \"mem_fault\": 0, \"illegal\": 0, \"load_error\": 1}")
+              != std::string::npos, "batch report counts stop reasons");
+    }
+    {
+        // Lanes diverge on a data-dependent loop count and on JALR through a per-lane table
+        // entry; each lane must end exactly as Engine ends on its own.
+        std::vector<uint8_t> image = assemble(
+            "li x2, 0x400\nloop: add x6, x6, x10\nsw x6, 0(x2)\naddi x10, x10, -1\nbne x10, x0, loop\n"
+            "la x7, even\nadd x7, x7, x11\njalr x1, x7, 0\nj end\n"
+            "even: lw x8, 0(x2)\nret\nodd: addi x8, x0, -1\nret\n"
+            "end: beq x12, x0, end\nsw x0, 0(x0)\n");
+        bool same = true;
+        for (bool avx2 : {false, true}) {
+            LockstepEngine ls(image);
+            ls.setAvx2(avx2);
+            Hart in[LockstepEngine::kLanes];
+            for (unsigned l = 0; l < LockstepEngine::kLanes; ++l) {
+                in[l].x[10] = l % 3 ? 1 + l : 0x7FFFFFFF; // lane 0, 3, 6: budget
+                in[l].x[11] = l & 1 ? 8 : 0;              // jalr to even or odd
+                in[l].x[12] = l == 5;                     // lane 5 stores into the image
+                ls.setHart(l, in[l]);
+            }
+            ls.run(2000);
+            for (unsigned l = 0; l < LockstepEngine::kLanes; ++l) {
+                Engine eng(image, 1u << 16);
+                eng.hart() = in[l];
+                RunResult r = eng.run(2000);
+                const RunResult& q = ls.result(l);
+                Hart h = ls.hart(l);
+                if (l == 5) // Engine rewrites its code and runs off the end; the lane faults on the SW
+                    same = same && q.reason == StopReason::MemFault && q.addr == 0 && r.reason == StopReason::EndOfImage
+                           && q.instrs + 1 == r.instrs && q.pc + 4 == r.pc;
+                else
+                    same = same && q.reason == r.reason && q.instrs == r.instrs && q.pc == r.pc
+                           && std::equal(h.x, h.x + 32, eng.hart().x);
+            }
+            same = same && ls.result(1).reason == StopReason::Halted && ls.result(0).reason == StopReason::Budget;
+        }
+        check(same, "lockstep lanes match Engine, both kernels");
+    }
+    {
+        // Sparse 4 GiB RAM: only touched pages exist; TLB conflicts, page-crossing words, MMIO.
+        GuestMemory m(0xFFFFFFFFu);
+        uint32_t v = 1;
+        bool ok = m.size() == (1ull << 32) && m.load32(0xDEADBEE0, v) && v == 0 && m.pagesAllocated() == 0;
+        const uint32_t a = 0x00001000, b = a + GuestMemory::kTlbEntries * GuestMemory::kPageSize; // same TLB slot
+        ok = ok && m.store32(a, 0x11111111) && m.store32(b, 0x22222222) && m.load32(a, v) && v == 0x11111111
+             && m.load32(b, v) && v == 0x22222222 && m.store32(0x7FFFFFFE, 0xA1B2C3D4) && m.load32(0x7FFFFFFE, v)
+             && v == 0xA1B2C3D4 && m.pagesAllocated() == 4 && !m.store32(0xFFFFFFFE, 0) && !m.load32(0xFFFFFFFD, v);
+        check(ok, "sparse paged memory");
+
+        struct Regs : MmioDevice {
+            uint32_t r[4] = {};
+            bool read32(uint32_t off, uint32_t& v) override { if (off >= 16 || off & 3) return false; v = r[off >> 2]; return true; }
+            bool write32(uint32_t off, uint32_t v) override { if (off >= 16 || off & 3) return false; r[off >> 2] = v * 2; return true; }
+        } dev;
+        Engine eng(assemble("lui x2, 0x40000\nli x5, 21\nsw x5, 4(x2)\nlw x6, 4(x2)\nsw x5, 16(x2)\n"), 1u << 16);
+        RunResult r = eng.run(100);
+        bool mapped = r.reason == StopReason::MemFault && r.addr == 0x40000004 // nothing there yet
+                      && eng.memory().mapMmio(0x40000000, GuestMemory::kPageSize, dev) && !eng.memory().mapMmio(0x8000, 0x1000, dev);
+        eng.hart() = Hart{};
+        r = eng.run(100);
+        check(mapped && eng.hart().x[6] == 42 && dev.r[1] == 42 && r.reason == StopReason::MemFault && r.addr == 0x40000010,
+              "MMIO handlers");
+    }
+    {
+        // Snapshot/restore copies back only the pages written since, including new ones.
+        GuestMemory m(1u << 20);
+        uint32_t v = 0;
+        bool ok = m.store32(0x1000, 1) && m.store32(0x2000, 2);
+        m.snapshot();
+        ok = ok && m.dirtyPages().empty() && m.store32(0x1000, 10) && m.store32(0x1004, 11) && m.store32(0x5000, 50)
+             && m.dirtyPages().size() == 2;
+        m.restore();
+        ok = ok && m.dirtyPages().empty() && m.load32(0x1000, v) && v == 1 && m.load32(0x1004, v) && v == 0
+             && m.load32(0x2000, v) && v == 2 && m.load32(0x5000, v) && v == 0;
+        ok = ok && m.store32(0x2000, 20) && m.dirtyPages().size() == 1; // write TLB still catches the first write
+        m.restore();
+        check(ok && m.load32(0x2000, v) && v == 2, "memory snapshot and restore");
+
+        // The guest patches its own code; restore re-predecodes it and replays identically.
+        Engine eng(assemble("la x5, patch\nlw x6, 0(x5)\nsw x0, 0(x5)\nli x7, 0x800\nsw x6, 0(x7)\n"
+                            "patch: addi x8, x8, 1\nend: j end\n"), 1u << 16);
+        eng.snapshot();
+        RunResult a = eng.run(100);
+        eng.restore();
+        bool fresh = eng.hart().pc == 0 && eng.hart().x[8] == 0;
+        RunResult b = eng.run(100);
+        check(fresh && a.reason == StopReason::Illegal && b.reason == a.reason && b.pc == a.pc
+              && b.instrs == a.instrs && eng.memory().dirtyPages().size() == 1,
+              "engine restore re-predecodes patched code");
+    }
+    {
+        // Three nested word compares guard a wild load; coverage feedback gets through them.
+        Engine eng(assemble("lw x5, 0(x10)\nli x6, 7\nbne x5, x6, out\nlw x5, 4(x10)\nli x6, 3\n"
+                            "bne x5, x6, out\nlw x5, 8(x10)\nli x6, 12\nbne x5, x6, out\n"
+                            "lui x7, 0x80000\nlw x8, 0(x7)\nout: j out\n"));
+        FuzzConfig cfg;
+        cfg.inputLen = 16;
+        Fuzzer fz(eng, cfg);
+        bool booted = fz.boot(0);
+        fz.run(200000);
+        const std::vector<FuzzCrash>& c = fz.crashes();
+        uint32_t w[3] = {};
+        if (!c.empty()) std::memcpy(w, c[0].input.data(), sizeof(w));
+        check(booted && c.size() == 1 && c[0].reason == StopReason::MemFault && c[0].addr == 0x80000000
+              && w[0] == 7 && w[1] == 3 && w[2] == 12 && fz.corpus().size() >= 3,
+              "fuzzer reaches a guarded crash");
+    }
+    {
+        // An input written over code runs as code: a zero word at 4 is illegal, not the NOP
+        // that was predecoded there.
+        Engine eng(assemble("li x5, 1\naddi x0, x0, 0\nlui x7, 0x80000\nlw x8, 0(x7)\n"));
+        FuzzConfig cfg;
+        cfg.inputAddr = 4;
+        cfg.inputLen = 4;
+        Fuzzer fz(eng, cfg);
+        bool booted = fz.boot(0);
+        fz.run(50);
+        const std::vector<FuzzCrash>& c = fz.crashes();
+        bool illegal = std::any_of(c.begin(), c.end(), [](const FuzzCrash& k) {
+            return k.reason == StopReason::Illegal && k.pc == 4;
+        });
+        check(booted && illegal, "fuzz input over code is predecoded before it runs");
+    }
+    {
+        // A background checkpoint sees memory as of start(), whatever the engine writes after.
+        namespace fs = std::filesystem;
+        std::string path = (fs::temp_directory_path() / "test_emulator.ckpt").string();
+        Engine eng(assemble("li x5, 0x3000\nli x6, 0x12345678\nsw x6, 0(x5)\nend: j end\n"), 1u << 20);
+        eng.run(100);
+        GuestMemory& m = eng.memory();
+        uint32_t seed = 1;
+        for (uint32_t a = 0; a < 0x1000; a += 4) {
+            m.store32(0x10000 + a, a / 64);                   // packs well
+            m.store32(0x20000 + a, seed = seed * 1103515245u + 12345); // does not
+        }
+        m.store32(0x30000, 0); // allocated but zero: left out
+        std::vector<uint8_t> before(0x40000), after(0x40000);
+        m.read(0, before.data(), before.size());
+        CheckpointWriter w;
+        w.start(eng, 1234, path);
+        for (uint32_t a = 0; a < 0x40000; a += 0x800) m.store32(a + 0x100, 0xDEADBEEF);
+        bool ok = w.wait() && w.stats().pages == 4 && w.stats().zeroPages == 1
+                  && w.stats().fileBytes < 3 * GuestMemory::kPageSize;
+        uint64_t instret = 0;
+        std::string err;
+        std::unique_ptr<Engine> back = loadCheckpoint(path, instret, err);
+        ok = ok && back && instret == 1234 && back->hart().pc == eng.hart().pc && back->hart().x[6] == 0x12345678
+             && back->memory().size() == m.size() && back->imageSize() == eng.imageSize();
+        if (back) back->memory().read(0, after.data(), after.size());
+        check(ok && after == before && back->run(10).reason == StopReason::Halted, "background checkpoint round trip");
+
+        std::vector<uint8_t> file = readBinaryFile(path);
+        file[file.size() / 2] ^= 1;
+        std::ofstream(path, std::ios::binary).write((const char*)file.data(), (std::streamsize)file.size());
+        bool corrupt = !loadCheckpoint(path, instret, err) && err.find("corrupt") != std::string::npos;
+        file[4] = 2; // version
+        std::ofstream(path, std::ios::binary).write((const char*)file.data(), (std::streamsize)file.size());
+        check(corrupt && !loadCheckpoint(path, instret, err) && err.find("version 2") != std::string::npos,
+              "damaged or newer checkpoints are refused");
+    }
+    {
+        // Writes racing the writer thread: every page is written over and over while it is
+        // being saved, some before the writer reaches them (copied), some after it released
+        // them (in place). The file still holds memory as of start(). Run under TSan too.
+        namespace fs = std::filesystem;
+        std::string path = (fs::temp_directory_path() / "test_emulator_race.ckpt").string();
+        const uint32_t kPages = 256, kBytes = kPages * GuestMemory::kPageSize;
+        Engine eng(assemble("end: j end\n"), kBytes);
+        GuestMemory& m = eng.memory();
+        uint32_t seed = 7;
+        for (uint32_t a = 0; a < kBytes; a += 4) m.store32(a, seed = seed * 1103515245u + 12345);
+        std::vector<uint8_t> before(kBytes), after(kBytes);
+        m.read(0, before.data(), before.size());
+        CheckpointWriter w;
+        w.start(eng, 1, path);
+        const uint32_t kRounds = 64;
+        for (uint32_t round = 0; round < kRounds; ++round)
+            for (uint32_t a = GuestMemory::kPageSize; a < kBytes; a += 64) m.store32(a, round);
+        bool ok = w.wait();
+        uint32_t last;
+        m.load32(kBytes - 64, last);
+        uint64_t instret;
+        std::string err;
+        std::unique_ptr<Engine> back = loadCheckpoint(path, instret, err);
+        if (back) back->memory().read(0, after.data(), after.size());
+        check(ok && back && after == before && last == kRounds - 1, "checkpoint unaffected by writes racing it");
+    }
+    {
+        // Alternating ALU and load-use phases: sampling finds both and matches the full timing run.
+        std::string src = "li x20, 8\nround: li x5, 5000\npa: addi x6, x6, 1\naddi x5, x5, -1\nbne x5, x0, pa\n"
+                          "li x5, 3000\nli x2, 0x1000\npb: lw x8, 0(x2)\nadd x9, x9, x8\nsw x9, 4(x2)\n"
+                          "addi x5, x5, -1\nbne x5, x0, pb\naddi x20, x20, -1\nbne x20, x0, round\nend: j end\n";
+        Engine full(assemble(src));
+        PipelineModel model(full.imageSize());
+        full.run(1000000, model);
+        Engine eng(assemble(src));
+        SampleConfig cfg;
+        cfg.interval = 3000;
+        cfg.warmup = 500;
+        SampleResult r = runSampled(eng, 1000000, cfg);
+        check(r.stop.reason == StopReason::Halted && r.stop.instrs == model.instrs() && r.clusters.size() >= 2
+              && r.cpiError >= 0 && std::abs(r.cpi - model.cpi()) < 0.01 * model.cpi()
+              && r.detailInstrs < model.instrs() / 2 && eng.hart().pc == 0,
+              "sampled CPI matches the full timing run");
+    }
+    {
+        // Fused pairs behave like the two instructions: every budget, the hooks, a fault in the pair.
+        struct Log : NullObserver {
+            std::vector<uint32_t> ev;
+            void memAccess(uint32_t pc, uint32_t addr, bool) { ev.insert(ev.end(), {1, pc, addr}); }
+            void control(uint32_t pc, const Op&, bool taken, uint32_t t) { ev.insert(ev.end(), {2, pc, taken, t}); }
+            void retire(uint32_t pc, const Op&) { ev.insert(ev.end(), {3, pc}); }
+        };
+        std::vector<uint8_t> image = assemble(
+            "li x5, 0x12345\nli x10, 3\nloop: auipc x6, 0\nlw x7, 0(x6)\nauipc x8, 0\njalr x1, x8, 12\n"
+            "addi x9, x9, 1\naddi x9, x9, 1\naddi x10, x10, -1\nbne x10, x0, loop\n"
+            "auipc x11, 0x80000000\nlw x12, 0(x11)\n");
+        bool same = true;
+        uint64_t pairs[kFusionKinds] = {};
+        for (uint64_t budget = 0; budget <= 40; ++budget) {
+            Engine a(image), b(image);
+            b.setFusion(false);
+            Log la, lb;
+            RunResult ra = a.run(budget, la), rb = b.run(budget, lb);
+            same = same && ra.reason == rb.reason && ra.instrs == rb.instrs && ra.pc == rb.pc && ra.addr == rb.addr
+                   && la.ev == lb.ev && std::equal(a.hart().x, a.hart().x + 32, b.hart().x) && b.fusions(Fusion::AuipcLw) == 0;
+            if (budget == 40) {
+                same = same && ra.reason == StopReason::MemFault && ra.pc == 48 && a.hart().x[11] == 0x8000002C;
+                for (unsigned k = 0; k < kFusionKinds; ++k) pairs[k] = a.fusions((Fusion)k);
+            }
+        }
+        check(same && pairs[(unsigned)Fusion::LuiAddi] == 1 && pairs[(unsigned)Fusion::AuipcLw] == 4
+              && pairs[(unsigned)Fusion::AuipcJalr] == 3 && pairs[(unsigned)Fusion::AddiBranch] == 3,
+              "macro-op fusion is invisible but counted");
+    }
+    {
+        // --layout-profile round trip: profile a run by source line, reassemble with it; the hot
+        // side of the BNE is placed to fall through and the cold block moves past the halt
+        namespace fs = std::filesystem;
+        fs::path dir = fs::temp_directory_path();
+        std::string src = (dir / "test_layout.s").string(), bin = (dir / "test_layout.bin").string(),
+                    laid = (dir / "test_layout2.bin").string(), map = (dir / "test_layout.map").string(),
+                    counts = (dir / "test_layout.prof").string();
+        std::ofstream(src) << "li x10, 200\nli x11, 0\n"
+                              "loop: addi x12, x11, -7\nbne x12, x0, hot\naddi x13, x13, 1\nj next\n"
+                              "hot: addi x14, x14, 1\nnext: addi x11, x11, 1\nbne x11, x10, loop\nend: j end\n";
+        Arena arena;
+        AsmOptions opts;
+        opts.mapPath = map;
+        bool built = assembleFile(src, bin, opts, arena) == 0;
+        Engine eng(readBinaryFile(bin));
+        ProfileModel prof(eng.imageSize());
+        prof.begin(eng.hart().pc);
+        prof.end(eng.run(100000, prof));
+        LineMap lm;
+        std::ofstream out(counts);
+        built = built && readLineMap(map, lm) && prof.writeLayoutProfile(out, eng, lm) && out.flush();
+        opts.mapPath.clear();
+        opts.layoutProfile = counts;
+        built = built && assembleFile(src, laid, opts, arena) == 0;
+
+        struct Taken : NullObserver {
+            uint64_t n = 0;
+            void control(uint32_t, const Op&, bool taken, uint32_t) { n += taken; }
+        } before, after;
+        Engine a(readBinaryFile(bin)), b(readBinaryFile(laid));
+        RunResult ra = a.run(100000, before), rb = b.run(100000, after);
+        check(built && ra.reason == StopReason::Halted && rb.reason == StopReason::Halted && ra.instrs == rb.instrs
+              && std::equal(a.hart().x, a.hart().x + 32, b.hart().x) && a.hart().x[14] == 199 && a.hart().x[13] == 1,
+              "profile-guided layout keeps the result");
+        check(before.n == 400 && after.n == 202, "profile-guided layout: taken transfers 400 -> 202");
+    }
+    {
+        // --rvc: 16-bit parcels with 32-bit words at 2-mod-4 addresses (ADDI x11, LUI); branches,
+        // calls and loads/stores between them must behave as in the all-32-bit image. Only the
+        // return address in x1 differs, the call having moved.
+        std::string src = "li x8, 0x400\nli x9, 10\nli x10, 0\n"
+                          "loop: add x10, x10, x9\nsw x10, 0(x8)\naddi x11, x10, 1000\naddi x9, x9, -1\n"
+                          "bne x9, x0, loop\ncall f\nlw x12, 0(x8)\nj end\n"
+                          "f: lui x13, 0x12345\nmv x14, x13\nret\nend: j end\n";
+        AsmOptions rvc;
+        rvc.compress = true;
+        std::vector<uint8_t> full = assemble(src), mixed = assemble(src, rvc);
+        Engine a(full, 4096), b(mixed, 4096);
+        RunResult ra = a.run(1000), rb = b.run(1000);
+        check(mixed.size() < full.size() && ra.reason == StopReason::Halted
+              && rb.reason == StopReason::Halted && ra.instrs == rb.instrs
+              && std::equal(a.hart().x + 2, a.hart().x + 32, b.hart().x + 2) && b.hart().x[12] == 55
+              && b.hart().x[14] == 0x12345000 && b.hart().pc == mixed.size() - 2,
+              "mixed 16/32-bit image runs like the 32-bit one");
+    }
+    std::cout << "\nEmulator test done (" << failed << " failed)\n";
+    return failed;
+}
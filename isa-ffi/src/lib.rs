@@ -54,6 +54,9 @@ pub enum InstrTag {
     
     //J-type
     TAG_JAL,
+
+    //B-type, appended so existing tag values stay stable
+    TAG_BNE,
 }
 
 //C-friendly  decoded instruction record
@@ -153,6 +156,15 @@ pub extern "C" fn isa_encode_beq(rs1: u8, rs2: u8, imm: i32, out_word: *mut u32)
     }
 }
 
+#[no_mangle]
+pub extern "C" fn isa_encode_bne(rs1: u8, rs2: u8, imm: i32, out_word: *mut u32) -> IsaStatus {
+    let out = match out_ptr(out_word) { Ok(p) => p, Err(e) => return e };
+    match rv::encode_bne(rs1, rs2, imm) {
+        Ok(w) => { *out = w; IsaStatus::ISA_OK }
+        Err(e) => map_err(e),
+    }
+}
+
 #[no_mangle]
 pub extern "C" fn isa_encode_jal(rd: u8, imm: i32, out_word: *mut u32) -> IsaStatus {
     let out = match out_ptr(out_word) { Ok(p) => p, Err(e) => return e };
@@ -204,6 +216,7 @@ pub extern "C" fn isa_decode(word: u32, out_decoded: *mut DecodedInstr) -> IsaSt
                 Instr::Lw   { rd, rs1, imm } => DecodedInstr { tag: InstrTag::TAG_LW,   rd, rs1, rs2: 0, imm },
                 Instr::Sw   { rs1, rs2, imm }=> DecodedInstr { tag: InstrTag::TAG_SW,   rd: 0, rs1, rs2, imm },
                 Instr::Beq  { rs1, rs2, imm }=> DecodedInstr { tag: InstrTag::TAG_BEQ,  rd: 0, rs1, rs2, imm },
+                Instr::Bne  { rs1, rs2, imm }=> DecodedInstr { tag: InstrTag::TAG_BNE,  rd: 0, rs1, rs2, imm },
                 Instr::Lui  { rd, imm }      => DecodedInstr { tag: InstrTag::TAG_LUI,  rd, rs1: 0, rs2: 0, imm },
                 Instr::Auipc{ rd, imm }      => DecodedInstr { tag: InstrTag::TAG_AUIPC,rd, rs1: 0, rs2: 0, imm },
                 Instr::Jal  { rd, imm }      => DecodedInstr { tag: InstrTag::TAG_JAL,  rd, rs1: 0, rs2: 0, imm },
@@ -230,4 +243,4 @@ pub extern "C" fn isa_decode(word: u32, out_decoded: *mut DecodedInstr) -> IsaSt
 
 // -- ABI Version --
 #[no_mangle]
-pub extern "C" fn isa_ffi_version() -> u32 { 1 }
\ No newline at end of file
+pub extern "C" fn isa_ffi_version() -> u32 { 2 }
\ No newline at end of file
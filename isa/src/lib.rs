@@ -33,6 +33,7 @@ pub enum Instr {
     
     // B - type conditional branches
     Beq   { rs1: Reg, rs2: Reg, imm: i32 },
+    Bne   { rs1: Reg, rs2: Reg, imm: i32 },
     
     // U - type upper immediate instructions
     Lui   { rd: Reg, imm: i32 }, //load upper immediate
@@ -58,6 +59,7 @@ const OP_AUIPC:     u32 = 0b0010111; // U
 const F3_ADD_SUB:   u32 = 0b000;
 const F3_ADDI:      u32 = 0b000;
 const F3_BEQ:       u32 = 0b000;
+const F3_BNE:       u32 = 0b001;
 const F3_LW:        u32 = 0b010;
 const F3_SW:        u32 = 0b010;
 const F3_JALR:      u32 = 0b000;
@@ -173,6 +175,13 @@ pub fn encode_beq( rs1: Reg, rs2: Reg, imm: i32 ) -> Result<u32, IsaError> {
     Ok(pack_b( rs1, rs2, imm, F3_BEQ, OP_BRANCH ))
 }
 
+pub fn encode_bne( rs1: Reg, rs2: Reg, imm: i32 ) -> Result<u32, IsaError> {
+    check_reg(rs1)?; check_reg(rs2)?;
+    if (imm & 0x1) != 0 { return Err(IsaError::ImmOutOfRange); }
+    check_imm_range(imm, 13)?;
+    Ok(pack_b( rs1, rs2, imm, F3_BNE, OP_BRANCH ))
+}
+
 pub fn encode_jal(rd: Reg, imm: i32) -> Result<u32, IsaError> {
     check_reg(rd)?;
     if (imm & 0x1) != 0 { return Err(IsaError::ImmOutOfRange); }
@@ -274,6 +283,7 @@ pub fn decode( word: u32 ) -> Result<Instr, IsaError> {
         OP_BRANCH => {
             match funct3(word) {
                 F3_BEQ => Ok(Instr::Beq { rs1: rs1(word), rs2: rs2(word), imm: imm_b(word) }),
+                F3_BNE => Ok(Instr::Bne { rs1: rs1(word), rs2: rs2(word), imm: imm_b(word) }),
                 _ => Err(IsaError::BadFunct),
             }
         }
@@ -323,6 +333,13 @@ mod tests {
         assert!(encode_beq(1, 2, 3).is_err());
     }
 
+    #[test]
+    fn bne_round_trip() {
+        let w = encode_bne(5, 6, -8).unwrap();
+        assert_eq!(w & 0x7000, 0x1000); // funct3 = 001
+        assert_eq!(decode(w).unwrap(), Instr::Bne { rs1:5, rs2:6, imm:-8 });
+    }
+
     #[test]
     fn jal_round_trip() {
         let w = encode_jal(1, -4).unwrap();